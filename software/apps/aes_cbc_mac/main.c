@@ -104,16 +104,13 @@ static uint8_t expected_mac[AES_MAC_SIZE] =
     0x25, 0x42, 0x89, 0xD6, 0x10, 0x9C, 0xC4, 0x3B, 0x8C, 0x0A, 0xCF, 0x52, 0xEB, 0xB9, 0x33, 0x24
 };
 
-static void text_print(char const* p_label, char const * p_text, size_t len)
+static void text_print(char const* p_label, char const * p_text)
 {
-    NRF_LOG_RAW_INFO("----%s (length: %u) ----\r\n", p_label, len);
-    NRF_LOG_FLUSH();
-    for(size_t i = 0; i < len; i++)
-    {
-        NRF_LOG_RAW_INFO("%c", p_text[i]);
-        NRF_LOG_FLUSH();
-    }
-    NRF_LOG_RAW_INFO("\r\n");
+    // One log entry for the whole text rather than one per character. The
+    // text must be NUL terminated; NRF_LOG_PUSH keeps it valid should
+    // NRF_LOG_DEFERRED be turned on (the board config leaves it off)
+    NRF_LOG_RAW_INFO("----%s (length: %u) ----\r\n", p_label, strlen(p_text));
+    NRF_LOG_RAW_INFO("%s\r\n", NRF_LOG_PUSH((char *)p_text));
     NRF_LOG_RAW_INFO("---- %s end ----\r\n\r\n", p_label);
     NRF_LOG_FLUSH();
 }
@@ -121,21 +118,7 @@ static void text_print(char const* p_label, char const * p_text, size_t len)
 static void hex_text_print(char const* p_label, char const * p_text, size_t len)
 {
     NRF_LOG_RAW_INFO("---- %s (length: %u) ----\r\n", p_label, len);
-    NRF_LOG_FLUSH();
-
-    // Handle partial line (left)
-    for (size_t i = 0; i < len; i++)
-    {
-        if (((i & 0xF) == 0) && (i > 0))
-        {
-            NRF_LOG_RAW_INFO("\r\n");
-            NRF_LOG_FLUSH();
-        }
-
-        NRF_LOG_RAW_INFO("%02x ", p_text[i]);
-        NRF_LOG_FLUSH();
-    }
-    NRF_LOG_RAW_INFO("\r\n");
+    NRF_LOG_RAW_HEXDUMP_INFO(p_text, len);
     NRF_LOG_RAW_INFO("---- %s end ----\r\n\r\n", p_label);
     NRF_LOG_FLUSH();
 }
@@ -145,7 +128,7 @@ static void plain_text_print(void)
 {
     size_t len = strlen(m_plain_text);
 
-    text_print("Plain text", m_plain_text, len);
+    text_print("Plain text", m_plain_text);
     hex_text_print("Plain text (hex)", m_plain_text, len);
 }
 
@@ -1,6 +1,7 @@
 // Analog read app
 //
-// Reads data from an analog input
+// Reads data from analog inputs, either one blocking sample at a time or
+// streamed continuously by the SAADC (see saadc_stream.h)
 
 #include <stdbool.h>
 #include <stdint.h>
@@ -11,10 +12,47 @@
 #include "nrfx_saadc.h"
 
 #include "nrf52840dk.h"
+#include "q15_filter.h"
+#include "saadc_stream.h"
+#include "telemetry.h"
+
+// Stream samples instead of reading one every 250 ms
+#ifndef STREAM_SAMPLING
+#define STREAM_SAMPLING 1
+#endif
 
 // ADC channels
 #define INPUT_CHANNEL 0
 
+// Streaming: P0.31 and P0.30 scanned together 1000 times a second
+#define STREAM_RATE_HZ 1000
+#define STREAM_CHANNELS 2
+
+// Summary of the last full buffer, per channel
+typedef struct {
+  int32_t min_mv;
+  int32_t mean_mv;
+  int32_t max_mv;
+} channel_summary_t;
+
+static channel_summary_t summaries[STREAM_CHANNELS];
+static volatile bool summary_ready = false;
+
+// Channel 0 is also low-passed: a 16 tap FIR with a 100 Hz cutoff decimates
+// it to 250 Hz, and a single pole IIR smooths that further
+#define FIR_TAPS 16
+#define FIR_DECIMATION 4
+#define IIR_ALPHA 3277 // 0.1
+
+static int16_t const fir_coeffs[FIR_TAPS] = {
+  -114, -159, -139, 291, 1450, 3284, 5246, 6525,
+  6525, 5246, 3284, 1450, 291, -139, -159, -114,
+};
+
+static q15_fir_decimate_t fir;
+static q15_iir_t iir;
+static int32_t filtered_mv;
+
 // callback for SAADC events
 void saadc_callback (nrfx_saadc_evt_t const * p_event) {
   // don't care about adc callbacks
@@ -28,10 +66,122 @@ nrf_saadc_value_t sample_value (uint8_t channel) {
   return val;
 }
 
+// called with every full buffer, in the SAADC interrupt
+void stream_callback (nrf_saadc_value_t const* samples, uint16_t scans) {
+  for (uint8_t channel = 0; channel < STREAM_CHANNELS; channel++) {
+    int32_t min = INT16_MAX;
+    int32_t max = INT16_MIN;
+    int32_t sum = 0;
+    for (uint16_t i = 0; i < scans; i++) {
+      nrf_saadc_value_t value = samples[i * STREAM_CHANNELS + channel];
+      TELEMETRY(TELEMETRY_ID_SAMPLE, channel, value);
+      min = value < min ? value : min;
+      max = value > max ? value : max;
+      sum += value;
+    }
+    summaries[channel].min_mv = saadc_stream_to_mv(min);
+    summaries[channel].mean_mv = saadc_stream_to_mv(sum / scans);
+    summaries[channel].max_mv = saadc_stream_to_mv(max);
+  }
+
+  int16_t block[SAADC_STREAM_BUFFER_SCANS];
+  int16_t decimated[SAADC_STREAM_BUFFER_SCANS / FIR_DECIMATION + 1];
+  for (uint16_t i = 0; i < scans; i++) {
+    block[i] = samples[i * STREAM_CHANNELS];
+  }
+  uint16_t outputs = q15_fir_decimate(&fir, block, decimated, scans);
+  q15_iir(&iir, decimated, decimated, outputs);
+  filtered_mv = saadc_stream_to_mv(decimated[outputs - 1]);
+
+  summary_ready = true;
+}
+
+// print the cycles per sample each filter takes on a 256 sample block
+void benchmark_filters (void) {
+  static int16_t in[Q15_FIR_MAX_BLOCK];
+  static int16_t out[Q15_FIR_MAX_BLOCK];
+  for (uint16_t i = 0; i < Q15_FIR_MAX_BLOCK; i++) {
+    in[i] = (i * 37) & 0xFFF;
+  }
+
+  q15_moving_average_t average;
+  q15_fir_decimate_t fir_bench;
+  q15_iir_t iir_bench;
+  q15_moving_average_init(&average, 16);
+  q15_fir_decimate_init(&fir_bench, fir_coeffs, FIR_TAPS, 1);
+  q15_iir_init(&iir_bench, IIR_ALPHA, 0);
+
+  // the DWT cycle counter
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+  uint32_t start = DWT->CYCCNT;
+  q15_moving_average(&average, in, out, Q15_FIR_MAX_BLOCK);
+  uint32_t average_cycles = DWT->CYCCNT - start;
+
+  start = DWT->CYCCNT;
+  q15_fir_decimate(&fir_bench, in, out, Q15_FIR_MAX_BLOCK);
+  uint32_t fir_cycles = DWT->CYCCNT - start;
+
+  start = DWT->CYCCNT;
+  q15_iir(&iir_bench, in, out, Q15_FIR_MAX_BLOCK);
+  uint32_t iir_cycles = DWT->CYCCNT - start;
+
+  printf("cycles/sample over %d samples: moving average %lu.%02lu, FIR %d taps %lu.%02lu, IIR %lu.%02lu\n",
+      Q15_FIR_MAX_BLOCK,
+      average_cycles / Q15_FIR_MAX_BLOCK, average_cycles * 100 / Q15_FIR_MAX_BLOCK % 100,
+      FIR_TAPS, fir_cycles / Q15_FIR_MAX_BLOCK, fir_cycles * 100 / Q15_FIR_MAX_BLOCK % 100,
+      iir_cycles / Q15_FIR_MAX_BLOCK, iir_cycles * 100 / Q15_FIR_MAX_BLOCK % 100);
+}
+
+// sleep until the next interrupt
+void power_manage (void) {
+  __WFE();
+  // clear the event register set by the wakeup so the next WFE sleeps
+  __SEV();
+  __WFE();
+}
+
+void stream_samples (void) {
+  saadc_stream_config_t config = {
+    .sample_rate_hz = STREAM_RATE_HZ,
+    // oversampling only works with a single channel
+    .oversample = NRF_SAADC_OVERSAMPLE_DISABLED,
+    .channel_count = STREAM_CHANNELS,
+    .inputs = {NRF_SAADC_INPUT_AIN7, NRF_SAADC_INPUT_AIN6}, // Pins P0.31, P0.30
+  };
+  q15_fir_decimate_init(&fir, fir_coeffs, FIR_TAPS, FIR_DECIMATION);
+  q15_iir_init(&iir, IIR_ALPHA, 0);
+
+  ret_code_t error_code = saadc_stream_init(&config, stream_callback);
+  APP_ERROR_CHECK(error_code);
+  saadc_stream_start();
+
+  // the CPU only wakes up for full buffers
+  while (1) {
+    power_manage();
+    if (summary_ready) {
+      summary_ready = false;
+      for (uint8_t channel = 0; channel < STREAM_CHANNELS; channel++) {
+        printf("ch%u: %ld/%ld/%ld mV (min/mean/max)  ", channel,
+            summaries[channel].min_mv, summaries[channel].mean_mv, summaries[channel].max_mv);
+      }
+      printf("ch0 filtered: %ld mV\n", filtered_mv);
+    }
+  }
+}
+
 int main (void) {
   ret_code_t error_code = NRF_SUCCESS;
 
   printf("Board started!\n");
+  telemetry_init();
+
+#if STREAM_SAMPLING
+  benchmark_filters();
+  stream_samples();
+#endif
 
   // initialize analog to digital converter
   nrfx_saadc_config_t saadc_config = NRFX_SAADC_DEFAULT_CONFIG;
@@ -0,0 +1,118 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "q15_filter.h"
+
+#if defined(__ARM_FEATURE_DSP) && __ARM_FEATURE_DSP
+#include "nrf.h"
+
+#define smlad(x, y, acc) ((int32_t)__SMLAD((x), (y), (uint32_t)(acc)))
+#define ssat16(x) __SSAT((x), 16)
+#else
+// Dual 16 bit multiply-accumulate: both halves of x times both halves of y
+static inline int32_t smlad(uint32_t x, uint32_t y, int32_t acc) {
+  return acc + (int16_t)x * (int16_t)y + (int16_t)(x >> 16) * (int16_t)(y >> 16);
+}
+
+static inline int32_t ssat16(int32_t x) {
+  return x > INT16_MAX ? INT16_MAX : (x < INT16_MIN ? INT16_MIN : x);
+}
+#endif
+
+// Two neighbouring samples as one word; the M4 handles the unaligned load
+static inline uint32_t read_q15x2(int16_t const* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+void q15_moving_average_init(q15_moving_average_t* filter, uint16_t length) {
+  memset(filter, 0, sizeof(*filter));
+  if (length == 0) {
+    length = 1;
+  }
+  filter->length = length < Q15_MOVING_AVERAGE_MAX ? length : Q15_MOVING_AVERAGE_MAX;
+}
+
+void q15_moving_average(q15_moving_average_t* filter, int16_t const* in, int16_t* out, uint16_t count) {
+  int32_t sum = filter->sum;
+  uint16_t index = filter->index;
+
+  for (uint16_t i = 0; i < count; i++) {
+    // the running sum only changes by what enters and leaves the window
+    sum += in[i] - filter->history[index];
+    filter->history[index] = in[i];
+    index = index + 1 == filter->length ? 0 : index + 1;
+    out[i] = sum / filter->length;
+  }
+
+  filter->sum = sum;
+  filter->index = index;
+}
+
+void q15_fir_decimate_init(q15_fir_decimate_t* filter, int16_t const* coeffs, uint16_t taps, uint8_t factor) {
+  memset(filter, 0, sizeof(*filter));
+  if (taps > Q15_FIR_MAX_TAPS) {
+    taps = Q15_FIR_MAX_TAPS;
+  }
+
+  // An odd filter gets a zero tap on the oldest end, then the taps are
+  // reversed so coefficients and samples both run oldest to newest
+  filter->taps = (taps + 1) & ~1;
+  for (uint16_t i = 0; i < taps; i++) {
+    filter->coeffs[filter->taps - 1 - i] = coeffs[i];
+  }
+
+  filter->factor = factor > 0 ? factor : 1;
+  filter->phase = filter->factor - 1;
+}
+
+uint16_t q15_fir_decimate(q15_fir_decimate_t* filter, int16_t const* in, int16_t* out, uint16_t count) {
+  uint16_t const taps = filter->taps;
+  uint16_t outputs = 0;
+  if (count > Q15_FIR_MAX_BLOCK) {
+    count = Q15_FIR_MAX_BLOCK;
+  }
+
+  // The last taps - 1 samples of the previous block stay in front of the
+  // new ones
+  int16_t* state = filter->state;
+  memcpy(&state[taps - 1], in, count * sizeof(int16_t));
+
+  uint8_t phase = filter->phase;
+  for (uint16_t i = 0; i < count; i++) {
+    if (phase > 0) {
+      phase--;
+      continue;
+    }
+    phase = filter->factor - 1;
+
+    int16_t const* window = &state[i];
+    int32_t acc = 0;
+    for (uint16_t j = 0; j < taps; j += 2) {
+      acc = smlad(read_q15x2(&filter->coeffs[j]), read_q15x2(&window[j]), acc);
+    }
+    out[outputs++] = ssat16(acc >> 15);
+  }
+  filter->phase = phase;
+
+  memmove(state, &state[count], (taps - 1) * sizeof(int16_t));
+  return outputs;
+}
+
+void q15_iir_init(q15_iir_t* filter, int16_t alpha, int16_t initial) {
+  filter->alpha = alpha;
+  filter->state = (int32_t)initial << 14;
+}
+
+void q15_iir(q15_iir_t* filter, int16_t const* in, int16_t* out, uint16_t count) {
+  int32_t state = filter->state;
+
+  for (uint16_t i = 0; i < count; i++) {
+    int32_t error = ((int32_t)in[i] << 14) - state;
+    state += (int32_t)(((int64_t)error * filter->alpha + (1 << 14)) >> 15);
+    out[i] = (state + (1 << 13)) >> 14;
+  }
+
+  filter->state = state;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+// Q15 block filters for sample streams
+//
+// Each filter keeps its own state between blocks, so a stream can be fed one
+// buffer at a time in any block size. Samples are Q15: raw SAADC results
+// can go in as they are, since a 12 bit value is a small Q15 number.
+//
+// The FIR inner loop uses the Cortex-M4 dual 16 bit multiply-accumulate
+// (SMLAD), two taps per instruction. Builds without the DSP extension, such
+// as on a host, use a plain C version of it that gives the same results.
+
+#define Q15_MOVING_AVERAGE_MAX 64
+#define Q15_FIR_MAX_TAPS 32
+#define Q15_FIR_MAX_BLOCK 256
+
+// Mean of the last `length` samples, starting out as if preceded by zeros
+typedef struct {
+  int16_t history[Q15_MOVING_AVERAGE_MAX];
+  uint16_t length;
+  uint16_t index;
+  int32_t sum;
+} q15_moving_average_t;
+
+void q15_moving_average_init(q15_moving_average_t* filter, uint16_t length);
+void q15_moving_average(q15_moving_average_t* filter, int16_t const* in, int16_t* out, uint16_t count);
+
+// FIR filter keeping every `factor`th output. The sum of the absolute
+// coefficients must stay below 2.0 so the 32 bit accumulator can't overflow,
+// which any low-pass with unity gain satisfies
+typedef struct {
+  int16_t coeffs[Q15_FIR_MAX_TAPS];  // reversed, padded to an even count
+  uint16_t taps;
+  uint8_t factor;
+  uint8_t phase;                     // input samples until the next output
+  int16_t state[Q15_FIR_MAX_TAPS - 1 + Q15_FIR_MAX_BLOCK];
+} q15_fir_decimate_t;
+
+// coeffs[0] applies to the newest sample. A factor of 1 doesn't decimate
+void q15_fir_decimate_init(q15_fir_decimate_t* filter, int16_t const* coeffs, uint16_t taps, uint8_t factor);
+
+// Filters up to Q15_FIR_MAX_BLOCK samples; returns the number of outputs
+uint16_t q15_fir_decimate(q15_fir_decimate_t* filter, int16_t const* in, int16_t* out, uint16_t count);
+
+// Single pole low-pass, y += alpha * (x - y). alpha is Q15; a smaller alpha
+// filters harder, with a time constant of about 32768 / alpha samples
+typedef struct {
+  int16_t alpha;
+  int32_t state;  // output with 14 more fraction bits, so small steps add up
+} q15_iir_t;
+
+void q15_iir_init(q15_iir_t* filter, int16_t alpha, int16_t initial);
+void q15_iir(q15_iir_t* filter, int16_t const* in, int16_t* out, uint16_t count);
@@ -0,0 +1,119 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_error.h"
+#include "nrfx_ppi.h"
+#include "nrfx_saadc.h"
+#include "nrfx_timer.h"
+
+#include "saadc_stream.h"
+
+// Acquisition plus conversion time of one result, for checking the rate
+#define CONVERSION_US (10 + 2)
+
+static nrfx_timer_t const timer = NRFX_TIMER_INSTANCE(1);
+static nrf_ppi_channel_t ppi_channel;
+
+static nrf_saadc_value_t buffers[2][SAADC_STREAM_BUFFER_SCANS * SAADC_STREAM_MAX_CHANNELS];
+static uint16_t buffer_size;
+static uint8_t channel_count;
+static saadc_stream_handler_t stream_handler;
+
+static void saadc_callback(nrfx_saadc_evt_t const* p_event) {
+  if (p_event->type != NRFX_SAADC_EVT_DONE) {
+    return;
+  }
+
+  stream_handler(p_event->data.done.p_buffer, p_event->data.done.size / channel_count);
+
+  // The SAADC is already filling the other buffer; this one goes in behind it
+  ret_code_t err_code = nrfx_saadc_buffer_convert(p_event->data.done.p_buffer, buffer_size);
+  APP_ERROR_CHECK(err_code);
+}
+
+static void timer_callback(nrf_timer_event_t event_type, void* p_context) {
+  // compare events only feed PPI
+}
+
+ret_code_t saadc_stream_init(saadc_stream_config_t const* config, saadc_stream_handler_t handler) {
+  ret_code_t err_code;
+
+  uint32_t period_us = 1000000 / config->sample_rate_hz;
+  uint32_t scan_us = config->channel_count * CONVERSION_US * (1 << config->oversample);
+  if (config->channel_count == 0 || config->channel_count > SAADC_STREAM_MAX_CHANNELS ||
+      (config->oversample != NRF_SAADC_OVERSAMPLE_DISABLED && config->channel_count > 1) ||
+      scan_us >= period_us) {
+    return NRFX_ERROR_INVALID_PARAM;
+  }
+
+  channel_count = config->channel_count;
+  buffer_size = SAADC_STREAM_BUFFER_SCANS * channel_count;
+  stream_handler = handler;
+
+  nrfx_saadc_config_t saadc_config = NRFX_SAADC_DEFAULT_CONFIG;
+  saadc_config.resolution = NRF_SAADC_RESOLUTION_12BIT;
+  saadc_config.oversample = config->oversample;
+  // Low power mode starts the SAADC from nrfx_saadc_sample(), which never
+  // gets called here
+  saadc_config.low_power_mode = false;
+  err_code = nrfx_saadc_init(&saadc_config, saadc_callback);
+  if (err_code != NRFX_SUCCESS) {
+    return err_code;
+  }
+
+  for (uint8_t i = 0; i < channel_count; i++) {
+    nrf_saadc_channel_config_t channel_config = NRFX_SAADC_DEFAULT_CHANNEL_CONFIG_SE(config->inputs[i]);
+    channel_config.gain = NRF_SAADC_GAIN1_6;
+    channel_config.reference = NRF_SAADC_REFERENCE_INTERNAL;
+    if (config->oversample != NRF_SAADC_OVERSAMPLE_DISABLED) {
+      channel_config.burst = NRF_SAADC_BURST_ENABLED;
+    }
+    err_code = nrfx_saadc_channel_init(i, &channel_config);
+    if (err_code != NRFX_SUCCESS) {
+      return err_code;
+    }
+  }
+
+  nrfx_timer_config_t timer_config = NRFX_TIMER_DEFAULT_CONFIG;
+  timer_config.frequency = NRF_TIMER_FREQ_1MHz;
+  timer_config.bit_width = NRF_TIMER_BIT_WIDTH_32;
+  err_code = nrfx_timer_init(&timer, &timer_config, timer_callback);
+  if (err_code != NRFX_SUCCESS) {
+    return err_code;
+  }
+  nrfx_timer_extended_compare(&timer, NRF_TIMER_CC_CHANNEL0, nrfx_timer_us_to_ticks(&timer, period_us),
+      NRF_TIMER_SHORT_COMPARE0_CLEAR_MASK, false);
+
+  err_code = nrfx_ppi_channel_alloc(&ppi_channel);
+  if (err_code != NRFX_SUCCESS) {
+    return err_code;
+  }
+  err_code = nrfx_ppi_channel_assign(ppi_channel,
+      nrfx_timer_compare_event_address_get(&timer, NRF_TIMER_CC_CHANNEL0),
+      nrfx_saadc_sample_task_get());
+  if (err_code != NRFX_SUCCESS) {
+    return err_code;
+  }
+  return nrfx_ppi_channel_enable(ppi_channel);
+}
+
+void saadc_stream_start(void) {
+  // The first buffer starts the SAADC, the second is taken up when it fills
+  ret_code_t err_code = nrfx_saadc_buffer_convert(buffers[0], buffer_size);
+  APP_ERROR_CHECK(err_code);
+  err_code = nrfx_saadc_buffer_convert(buffers[1], buffer_size);
+  APP_ERROR_CHECK(err_code);
+
+  nrfx_timer_enable(&timer);
+}
+
+void saadc_stream_stop(void) {
+  nrfx_timer_disable(&timer);
+  // drops both buffers, the partly filled one included
+  nrfx_saadc_abort();
+}
+
+int32_t saadc_stream_to_mv(nrf_saadc_value_t value) {
+  // 12 bits over 0.6 V / (1/6)
+  return (int32_t)value * 3600 / 4096;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "nrfx_saadc.h"
+
+// Continuous SAADC sampling
+//
+// A TIMER compare event triggers the SAADC SAMPLE task through a PPI channel,
+// so sampling runs at a fixed rate with no code involved. Every SAMPLE scans
+// all configured channels once, and EasyDMA writes the results into one of
+// two buffers. The handler is only called when a buffer is full, while the
+// SAADC carries on into the other one.
+//
+// Hardware oversampling averages 2^n conversions into each result. The
+// SAADC can only oversample a single channel; burst mode takes all of the
+// conversions on one SAMPLE, so the sample rate stays the same.
+//
+// Channels use 1/6 gain and the internal 0.6 V reference like analog_read,
+// for a 0 to 3.6 V input range.
+
+#define SAADC_STREAM_MAX_CHANNELS NRF_SAADC_CHANNEL_COUNT
+
+// Scans per buffer
+#define SAADC_STREAM_BUFFER_SCANS 128
+
+typedef struct {
+  uint32_t sample_rate_hz;  // scans per second
+  nrf_saadc_oversample_t oversample;
+  uint8_t channel_count;
+  nrf_saadc_input_t inputs[SAADC_STREAM_MAX_CHANNELS];
+} saadc_stream_config_t;
+
+// Called from the SAADC interrupt with a full buffer of `scans` scans, each
+// holding one result per channel in order. The buffer is left alone until
+// the next one fills
+typedef void (*saadc_stream_handler_t)(nrf_saadc_value_t const* samples, uint16_t scans);
+
+// Sets up the SAADC, TIMER1 and a PPI channel. Returns NRFX_ERROR_INVALID_PARAM
+// if the channels can't be scanned at the requested rate, or if oversampling
+// more than one channel
+ret_code_t saadc_stream_init(saadc_stream_config_t const* config, saadc_stream_handler_t handler);
+
+void saadc_stream_start(void);
+void saadc_stream_stop(void);
+
+// Converts a result to millivolts at the stream's gain and reference
+int32_t saadc_stream_to_mv(nrf_saadc_value_t value);
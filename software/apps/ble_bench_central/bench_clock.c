@@ -0,0 +1,21 @@
+#include <stdint.h>
+
+#include "nrf.h"
+
+#include "bench_clock.h"
+
+#define BENCH_TIMER NRF_TIMER2
+
+void bench_clock_init(void) {
+  BENCH_TIMER->MODE = TIMER_MODE_MODE_Timer;
+  BENCH_TIMER->BITMODE = TIMER_BITMODE_BITMODE_32Bit;
+  // 16 MHz / 2^4
+  BENCH_TIMER->PRESCALER = 4;
+  BENCH_TIMER->TASKS_CLEAR = 1;
+  BENCH_TIMER->TASKS_START = 1;
+}
+
+uint32_t bench_clock_us(void) {
+  BENCH_TIMER->TASKS_CAPTURE[0] = 1;
+  return BENCH_TIMER->CC[0];
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+// Free running 1 MHz, 32-bit clock on TIMER2 for latencies. Wraps every
+// 71 minutes, so differences between two readings are always right.
+void bench_clock_init(void);
+uint32_t bench_clock_us(void);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+// Benchmark service, shared by ble_bench_central and ble_bench_peripheral
+//
+// The data characteristic takes writes without response from the central
+// and sends notifications to it; the payloads are filler. The control
+// characteristic takes commands from the central (write) and answers with
+// results (notify).
+
+#define BENCH_DEVICE_NAME "Bench"
+
+#define BENCH_UUID_BASE {0x8E,0x1A,0x52,0x4C,0x07,0x3B,0x4B,0x9D, \
+                         0xA6,0x63,0x1F,0x2D,0x00,0xBE,0x70,0x5A}
+#define BENCH_UUID_SERVICE 0xBE00
+#define BENCH_UUID_DATA 0xBE01
+#define BENCH_UUID_CONTROL 0xBE02
+
+// Largest payload with the largest MTU
+#define BENCH_MAX_PAYLOAD 244
+
+// Packets each side can have queued in the SoftDevice
+#define BENCH_TX_QUEUE_SIZE 16
+
+typedef enum {
+  BENCH_OP_NOTIFY = 1, // central -> peripheral, bench_notify_cmd_t
+  BENCH_OP_RESULT = 2, // peripheral -> central, bench_result_msg_t
+} bench_op_t;
+
+// Send notifications of length bytes for duration_ms
+typedef struct {
+  uint8_t op;
+  uint8_t reserved;
+  uint16_t duration_ms;
+  uint16_t length;
+  uint16_t reserved2;
+} bench_notify_cmd_t;
+
+// How the notifications went, as seen by the peripheral
+typedef struct {
+  uint8_t op;
+  uint8_t reserved[3];
+  uint32_t packets;
+  uint32_t p50_us;
+  uint32_t p90_us;
+  uint32_t p99_us;
+} bench_result_msg_t;
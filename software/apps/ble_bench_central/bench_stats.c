@@ -0,0 +1,102 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "bench_stats.h"
+
+// Values below 8 get a bucket each; above, the top three bits after the
+// leading one pick one of eight buckets per power of two
+static uint32_t bucket_of(uint32_t value) {
+  if (value < BENCH_LATENCY_SUB_BUCKETS) {
+    return value;
+  }
+
+  uint32_t exponent = 31 - __builtin_clz(value);
+  uint32_t mantissa = (value >> (exponent - 3)) & (BENCH_LATENCY_SUB_BUCKETS - 1);
+  uint32_t bucket = (exponent - 2) * BENCH_LATENCY_SUB_BUCKETS + mantissa;
+  return bucket < BENCH_LATENCY_BUCKETS ? bucket : BENCH_LATENCY_BUCKETS - 1;
+}
+
+// Largest value that falls in the bucket
+static uint32_t bucket_upper(uint32_t bucket) {
+  if (bucket < BENCH_LATENCY_SUB_BUCKETS) {
+    return bucket;
+  }
+
+  uint32_t exponent = bucket / BENCH_LATENCY_SUB_BUCKETS + 2;
+  uint32_t mantissa = bucket % BENCH_LATENCY_SUB_BUCKETS;
+  return ((BENCH_LATENCY_SUB_BUCKETS + mantissa + 1) << (exponent - 3)) - 1;
+}
+
+void bench_stats_reset(bench_stats_t* stats) {
+  memset(stats, 0, sizeof(*stats));
+}
+
+void bench_stats_add_packet(bench_stats_t* stats, uint16_t bytes) {
+  stats->packets++;
+  stats->bytes += bytes;
+}
+
+void bench_stats_add_latency(bench_stats_t* stats, uint32_t latency_us) {
+  stats->latencies++;
+  stats->histogram[bucket_of(latency_us)]++;
+}
+
+bool bench_stats_queued(bench_stats_t* stats, uint32_t time_us) {
+  if ((uint16_t)(stats->inflight_head - stats->inflight_tail) == BENCH_INFLIGHT_SIZE) {
+    return false;
+  }
+
+  stats->inflight[stats->inflight_head % BENCH_INFLIGHT_SIZE] = time_us;
+  stats->inflight_head++;
+  return true;
+}
+
+void bench_stats_completed(bench_stats_t* stats, uint16_t bytes, uint32_t time_us) {
+  bench_stats_add_packet(stats, bytes);
+  if (stats->inflight_tail == stats->inflight_head) {
+    return;
+  }
+
+  uint32_t queued_us = stats->inflight[stats->inflight_tail % BENCH_INFLIGHT_SIZE];
+  stats->inflight_tail++;
+  bench_stats_add_latency(stats, time_us - queued_us);
+}
+
+uint16_t bench_stats_inflight(bench_stats_t const* stats) {
+  return stats->inflight_head - stats->inflight_tail;
+}
+
+uint32_t bench_stats_percentile_us(bench_stats_t const* stats, uint8_t percent) {
+  if (stats->latencies == 0) {
+    return 0;
+  }
+
+  // Smallest bucket with at least percent of the samples at or below it
+  uint64_t wanted = ((uint64_t)stats->latencies * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (uint32_t bucket = 0; bucket < BENCH_LATENCY_BUCKETS; bucket++) {
+    seen += stats->histogram[bucket];
+    if (seen >= wanted && seen > 0) {
+      return bucket_upper(bucket);
+    }
+  }
+  return bucket_upper(BENCH_LATENCY_BUCKETS - 1);
+}
+
+bench_result_t bench_stats_result(bench_stats_t const* stats, uint32_t duration_us, uint32_t interval_us) {
+  bench_result_t result = {
+    .packets = stats->packets,
+    .p50_us = bench_stats_percentile_us(stats, 50),
+    .p90_us = bench_stats_percentile_us(stats, 90),
+    .p99_us = bench_stats_percentile_us(stats, 99),
+  };
+
+  if (duration_us > 0) {
+    result.bytes_per_s = (uint64_t)stats->bytes * 1000000 / duration_us;
+  }
+  // Connection events in the transfer, at least one
+  uint32_t events = interval_us > 0 ? duration_us / interval_us : 0;
+  result.packets_per_event_x100 = (uint64_t)stats->packets * 100 / (events > 0 ? events : 1);
+  return result;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Benchmark statistics
+//
+// Counts the packets and bytes of one timed transfer and keeps a histogram of
+// their latencies for percentiles. Buckets are log-linear, eight per power of
+// two, so any percentile is within 12.5% of the true value from 1 us up to
+// seconds in a fixed, small table.
+//
+// Latency is measured on the sending side, from queueing a packet with the
+// SoftDevice to the TX complete event that reports it acknowledged. Packets
+// complete in the order they were queued, so the queue times wait in a FIFO.
+//
+// Only depends on the C library, so it builds and runs on the host as well.
+
+#define BENCH_LATENCY_SUB_BUCKETS 8
+#define BENCH_LATENCY_BUCKETS (30 * BENCH_LATENCY_SUB_BUCKETS)
+
+// Larger than any TX queue configured on either side
+#define BENCH_INFLIGHT_SIZE 64
+
+typedef struct {
+  uint32_t packets;
+  uint32_t bytes;
+  uint32_t latencies;
+  uint32_t histogram[BENCH_LATENCY_BUCKETS];
+
+  uint32_t inflight[BENCH_INFLIGHT_SIZE];
+  uint16_t inflight_head;
+  uint16_t inflight_tail;
+} bench_stats_t;
+
+typedef struct {
+  uint32_t bytes_per_s;
+  uint32_t packets;
+  uint32_t packets_per_event_x100; // average packets per connection event, times 100
+  uint32_t p50_us;
+  uint32_t p90_us;
+  uint32_t p99_us;
+} bench_result_t;
+
+void bench_stats_reset(bench_stats_t* stats);
+
+// Counts a received or acknowledged packet
+void bench_stats_add_packet(bench_stats_t* stats, uint16_t bytes);
+
+void bench_stats_add_latency(bench_stats_t* stats, uint32_t latency_us);
+
+// A packet was queued at time_us. Returns false if the FIFO is full
+bool bench_stats_queued(bench_stats_t* stats, uint32_t time_us);
+
+// The oldest queued packet completed at time_us: counts it and its latency
+void bench_stats_completed(bench_stats_t* stats, uint16_t bytes, uint32_t time_us);
+
+// Packets queued and not completed yet
+uint16_t bench_stats_inflight(bench_stats_t const* stats);
+
+// Upper edge of the bucket holding the given percentile, 0 with no samples
+uint32_t bench_stats_percentile_us(bench_stats_t const* stats, uint8_t percent);
+
+bench_result_t bench_stats_result(bench_stats_t const* stats, uint32_t duration_us, uint32_t interval_us);
@@ -0,0 +1,71 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bench_sweep.h"
+
+#define COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+static const uint16_t MTUS[] = {23, 131, 247};
+static const uint16_t DATA_LENGTHS[] = {27, 251};
+static const uint8_t PHYS[] = {BENCH_PHY_1M, BENCH_PHY_2M, BENCH_PHY_CODED};
+// 7.5, 15, 30 and 50 ms
+static const uint16_t INTERVALS[] = {6, 12, 24, 40};
+
+void bench_sweep_start(bench_sweep_t* sweep) {
+  *sweep = (bench_sweep_t){0};
+}
+
+bool bench_sweep_next(bench_sweep_t* sweep) {
+  if (sweep->done) {
+    return false;
+  }
+
+  // Innermost first, carrying into the next loop out
+  if (++sweep->interval < COUNT(INTERVALS)) {
+    return true;
+  }
+  sweep->interval = 0;
+  if (++sweep->phy < COUNT(PHYS)) {
+    return true;
+  }
+  sweep->phy = 0;
+  if (++sweep->data_length < COUNT(DATA_LENGTHS)) {
+    return true;
+  }
+  sweep->data_length = 0;
+  if (++sweep->mtu < COUNT(MTUS)) {
+    return true;
+  }
+
+  sweep->mtu = 0;
+  sweep->done = true;
+  return false;
+}
+
+bench_config_t bench_sweep_config(bench_sweep_t const* sweep) {
+  bench_config_t config = {
+    .att_mtu = MTUS[sweep->mtu],
+    .data_length = DATA_LENGTHS[sweep->data_length],
+    .phy = PHYS[sweep->phy],
+    .interval_units = INTERVALS[sweep->interval],
+  };
+  return config;
+}
+
+bool bench_sweep_needs_reconnect(bench_sweep_t const* sweep) {
+  // every inner index wraps to 0 exactly when the MTU moves on
+  return !sweep->done && sweep->mtu > 0 && sweep->data_length == 0 && sweep->phy == 0 && sweep->interval == 0;
+}
+
+uint16_t bench_sweep_index(bench_sweep_t const* sweep) {
+  return ((sweep->mtu * COUNT(DATA_LENGTHS) + sweep->data_length) * COUNT(PHYS) + sweep->phy) * COUNT(INTERVALS) +
+         sweep->interval;
+}
+
+uint16_t bench_sweep_count(void) {
+  return COUNT(MTUS) * COUNT(DATA_LENGTHS) * COUNT(PHYS) * COUNT(INTERVALS);
+}
+
+uint32_t bench_interval_ms_x100(uint16_t interval_units) {
+  return interval_units * 125;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Benchmark sweep
+//
+// Steps through every combination of ATT MTU, data length, PHY and
+// connection interval. The MTU is the outermost loop since it can only be
+// exchanged once per connection, so changing it means reconnecting; the
+// rest can be updated on a live link.
+//
+// Like bench_stats, this only depends on the C library so it builds on the
+// host as well.
+
+// Same values as BLE_GAP_PHY_*
+#define BENCH_PHY_1M 1
+#define BENCH_PHY_2M 2
+#define BENCH_PHY_CODED 4
+
+typedef struct {
+  uint16_t att_mtu;
+  uint16_t data_length;     // link layer payload octets
+  uint8_t phy;
+  uint16_t interval_units;  // 1.25 ms
+} bench_config_t;
+
+typedef struct {
+  uint8_t mtu;
+  uint8_t data_length;
+  uint8_t phy;
+  uint8_t interval;
+  bool done;
+} bench_sweep_t;
+
+void bench_sweep_start(bench_sweep_t* sweep);
+
+// Moves to the next configuration. Returns false once the sweep is done
+bool bench_sweep_next(bench_sweep_t* sweep);
+
+bench_config_t bench_sweep_config(bench_sweep_t const* sweep);
+
+// True if the step that led to this configuration changed the MTU
+bool bench_sweep_needs_reconnect(bench_sweep_t const* sweep);
+
+// Index of the configuration and the total, for progress
+uint16_t bench_sweep_index(bench_sweep_t const* sweep);
+uint16_t bench_sweep_count(void);
+
+// Connection interval in 1.25 ms units as milliseconds times 100, for
+// printing without floats
+uint32_t bench_interval_ms_x100(uint16_t interval_units);
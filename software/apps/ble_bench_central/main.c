@@ -0,0 +1,558 @@
+// BLE Benchmark central
+//
+// Connects to ble_bench_peripheral and sweeps ATT MTU, data length, PHY and
+// connection interval (see bench_sweep.h). Every configuration gets a timed
+// transfer of writes without response to the peripheral and then one of
+// notifications from it, and prints the throughput, packets per connection
+// event and latency percentiles of both.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "app_timer.h"
+#include "app_util.h"
+#include "ble_db_discovery.h"
+#include "nrf_ble_gatt.h"
+#include "nrf_ble_scan.h"
+#include "nrf_pwr_mgmt.h"
+#include "nrf_sdh.h"
+#include "nrf_sdh_ble.h"
+
+#include "nrf52840dk.h"
+
+#include "bench_clock.h"
+#include "bench_protocol.h"
+#include "bench_stats.h"
+#include "bench_sweep.h"
+
+#define APP_BLE_CONN_CFG_TAG  1 // Softdevice BLE configuration
+#define APP_BLE_OBSERVER_PRIO 3 // BLE observer priority
+
+// Length of each timed transfer
+#define BENCH_TEST_MS 2000
+// How long to wait for a parameter update the peer may turn down, and for
+// the peripheral's result after its transfer
+#define BENCH_UPDATE_TIMEOUT_MS 1000
+#define BENCH_SUPERVISION_TIMEOUT_MS 4000
+
+NRF_BLE_GATT_DEF(m_gatt); // GATT module instance
+NRF_BLE_SCAN_DEF(m_scan); // Scanning module instance
+BLE_DB_DISCOVERY_DEF(m_db_disc); // DB discovery module instance
+
+APP_TIMER_DEF(step_timer);
+
+typedef enum {
+  PHASE_CONNECTING,  // until discovered, subscribed and the MTU is exchanged
+  PHASE_DATA_LENGTH,
+  PHASE_PHY,
+  PHASE_INTERVAL,
+  PHASE_WRITE,
+  PHASE_NOTIFY,
+  PHASE_DONE,
+} phase_t;
+
+static phase_t phase = PHASE_CONNECTING;
+static bench_sweep_t sweep;
+static bench_config_t config;
+
+static uint16_t conn_handle = BLE_CONN_HANDLE_INVALID;
+static uint8_t bench_uuid_type;
+static uint16_t data_handle;
+static uint16_t data_cccd_handle;
+static uint16_t control_handle;
+static uint16_t control_cccd_handle;
+static bool subscribed = false;
+static bool mtu_exchanged = false;
+
+// What the link actually runs with, which the peer may have limited
+static uint16_t link_mtu;
+static uint16_t link_data_length;
+static uint8_t link_phy;
+static uint16_t link_interval_units;
+
+static bench_stats_t stats;
+static bench_result_t write_result;
+static uint8_t payload[BENCH_MAX_PAYLOAD];
+
+static uint8_t const cccd_notify[] = {BLE_GATT_HVX_NOTIFICATION, 0};
+
+static void run(phase_t next);
+
+static char const* phy_name(uint8_t phy) {
+  switch (phy) {
+    case BENCH_PHY_1M: return "1M";
+    case BENCH_PHY_2M: return "2M";
+    case BENCH_PHY_CODED: return "Coded";
+    default: return "?";
+  }
+}
+
+static void scan_start(void) {
+  ret_code_t err_code = nrf_ble_scan_start(&m_scan);
+  APP_ERROR_CHECK(err_code);
+}
+
+static void wait(uint32_t timeout_ms) {
+  ret_code_t err_code = app_timer_start(step_timer, APP_TIMER_TICKS(timeout_ms), NULL);
+  APP_ERROR_CHECK(err_code);
+}
+
+static void write_cccd(uint16_t handle) {
+  ble_gattc_write_params_t const params = {
+    .write_op = BLE_GATT_OP_WRITE_REQ,
+    .handle   = handle,
+    .offset   = 0,
+    .len      = sizeof(cccd_notify),
+    .p_value  = cccd_notify,
+  };
+  ret_code_t err_code = sd_ble_gattc_write(conn_handle, &params);
+  APP_ERROR_CHECK(err_code);
+}
+
+static void check_connected(void) {
+  if (phase == PHASE_CONNECTING && subscribed && mtu_exchanged) {
+    run(PHASE_DATA_LENGTH);
+  }
+}
+
+// Keeps the write queue full until the transfer ends
+static void send_writes(void) {
+  while (phase == PHASE_WRITE) {
+    ble_gattc_write_params_t const params = {
+      .write_op = BLE_GATT_OP_WRITE_CMD,
+      .handle   = data_handle,
+      .offset   = 0,
+      .len      = link_mtu - 3,
+      .p_value  = payload,
+    };
+    if (sd_ble_gattc_write(conn_handle, &params) != NRF_SUCCESS ||
+        !bench_stats_queued(&stats, bench_clock_us())) {
+      return;
+    }
+  }
+}
+
+static void print_result(char const* name, bench_result_t const* result) {
+  printf(" | %s %lu B/s, %lu.%02lu pkt/evt, p50/90/99 %lu/%lu/%lu us", name,
+      result->bytes_per_s, result->packets_per_event_x100 / 100, result->packets_per_event_x100 % 100,
+      result->p50_us, result->p90_us, result->p99_us);
+}
+
+// Prints the configuration's results and moves on to the next one
+static void finish(bench_result_msg_t const* peer_result) {
+  uint32_t interval_us = bench_interval_ms_x100(link_interval_units) * 10;
+  uint32_t interval_x100 = bench_interval_ms_x100(link_interval_units);
+
+  printf("[%u/%u] MTU %u, DL %u, %s, %lu.%02lu ms", bench_sweep_index(&sweep) + 1, bench_sweep_count(),
+      link_mtu, link_data_length, phy_name(link_phy), interval_x100 / 100, interval_x100 % 100);
+  print_result("write", &write_result);
+  if (peer_result != NULL) {
+    // Latency is the peripheral's, from queueing to acknowledgement
+    bench_result_t notify_result = bench_stats_result(&stats, BENCH_TEST_MS * 1000, interval_us);
+    notify_result.p50_us = peer_result->p50_us;
+    notify_result.p90_us = peer_result->p90_us;
+    notify_result.p99_us = peer_result->p99_us;
+    print_result("notify", &notify_result);
+  } else {
+    printf(" | notify: no result");
+  }
+  printf("\n");
+
+  if (!bench_sweep_next(&sweep)) {
+    printf("Sweep done\n");
+    phase = PHASE_DONE;
+    sd_ble_gap_disconnect(conn_handle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+    return;
+  }
+
+  config = bench_sweep_config(&sweep);
+  if (bench_sweep_needs_reconnect(&sweep)) {
+    // The MTU can only be exchanged once per connection
+    phase = PHASE_CONNECTING;
+    sd_ble_gap_disconnect(conn_handle, BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+    return;
+  }
+  run(PHASE_DATA_LENGTH);
+}
+
+// Enters a phase, falling through the parameter updates the link already
+// matches
+static void run(phase_t next) {
+  ret_code_t err_code;
+  app_timer_stop(step_timer);
+  phase = next;
+
+  switch (phase) {
+    case PHASE_DATA_LENGTH:
+      if (link_data_length != config.data_length) {
+        err_code = nrf_ble_gatt_data_length_set(&m_gatt, conn_handle, config.data_length);
+        APP_ERROR_CHECK(err_code);
+        wait(BENCH_UPDATE_TIMEOUT_MS);
+        return;
+      }
+      phase = PHASE_PHY;
+      // fall through
+
+    case PHASE_PHY:
+      if (link_phy != config.phy) {
+        ble_gap_phys_t const phys = {
+          .tx_phys = config.phy,
+          .rx_phys = config.phy,
+        };
+        err_code = sd_ble_gap_phy_update(conn_handle, &phys);
+        APP_ERROR_CHECK(err_code);
+        wait(BENCH_UPDATE_TIMEOUT_MS);
+        return;
+      }
+      phase = PHASE_INTERVAL;
+      // fall through
+
+    case PHASE_INTERVAL:
+      if (link_interval_units != config.interval_units) {
+        ble_gap_conn_params_t const conn_params = {
+          .min_conn_interval = config.interval_units,
+          .max_conn_interval = config.interval_units,
+          .slave_latency     = 0,
+          .conn_sup_timeout  = MSEC_TO_UNITS(BENCH_SUPERVISION_TIMEOUT_MS, UNIT_10_MS),
+        };
+        err_code = sd_ble_gap_conn_param_update(conn_handle, &conn_params);
+        APP_ERROR_CHECK(err_code);
+        wait(BENCH_UPDATE_TIMEOUT_MS);
+        return;
+      }
+      phase = PHASE_WRITE;
+      // fall through
+
+    case PHASE_WRITE:
+      bench_stats_reset(&stats);
+      wait(BENCH_TEST_MS);
+      send_writes();
+      return;
+
+    case PHASE_NOTIFY: {
+      write_result = bench_stats_result(&stats, BENCH_TEST_MS * 1000,
+          bench_interval_ms_x100(link_interval_units) * 10);
+
+      // Writes still in the queue complete into nothing
+      bench_stats_reset(&stats);
+      bench_notify_cmd_t const cmd = {
+        .op = BENCH_OP_NOTIFY,
+        .duration_ms = BENCH_TEST_MS,
+        .length = link_mtu - 3,
+      };
+      ble_gattc_write_params_t const params = {
+        .write_op = BLE_GATT_OP_WRITE_REQ,
+        .handle   = control_handle,
+        .offset   = 0,
+        .len      = sizeof(cmd),
+        .p_value  = (uint8_t const*)&cmd,
+      };
+      err_code = sd_ble_gattc_write(conn_handle, &params);
+      APP_ERROR_CHECK(err_code);
+      wait(BENCH_TEST_MS + BENCH_UPDATE_TIMEOUT_MS);
+      return;
+    }
+
+    default:
+      return;
+  }
+}
+
+// An awaited update arrived, or the wait for it ran out
+static void advance(void) {
+  switch (phase) {
+    case PHASE_DATA_LENGTH:
+      run(PHASE_PHY);
+      break;
+    case PHASE_PHY:
+      run(PHASE_INTERVAL);
+      break;
+    case PHASE_INTERVAL:
+      run(PHASE_WRITE);
+      break;
+    case PHASE_WRITE:
+      run(PHASE_NOTIFY);
+      break;
+    case PHASE_NOTIFY:
+      finish(NULL);
+      break;
+    default:
+      break;
+  }
+}
+
+static void step_timeout(void* context) {
+  advance();
+}
+
+static void gatt_evt_handler(nrf_ble_gatt_t* p_gatt, nrf_ble_gatt_evt_t const* p_evt) {
+  switch (p_evt->evt_id) {
+    case NRF_BLE_GATT_EVT_ATT_MTU_UPDATED:
+      link_mtu = p_evt->params.att_mtu_effective;
+      mtu_exchanged = true;
+      check_connected();
+      break;
+
+    case NRF_BLE_GATT_EVT_DATA_LENGTH_UPDATED:
+      link_data_length = p_evt->params.data_length;
+      if (phase == PHASE_DATA_LENGTH) {
+        advance();
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+static void db_disc_handler(ble_db_discovery_evt_t* p_evt) {
+  switch (p_evt->evt_type) {
+    case BLE_DB_DISCOVERY_COMPLETE:
+      for (uint8_t i = 0; i < p_evt->params.discovered_db.char_count; i++) {
+        ble_gatt_db_char_t const* db_char = &p_evt->params.discovered_db.charateristics[i];
+        if (db_char->characteristic.uuid.uuid == BENCH_UUID_DATA) {
+          data_handle = db_char->characteristic.handle_value;
+          data_cccd_handle = db_char->cccd_handle;
+        } else if (db_char->characteristic.uuid.uuid == BENCH_UUID_CONTROL) {
+          control_handle = db_char->characteristic.handle_value;
+          control_cccd_handle = db_char->cccd_handle;
+        }
+      }
+      break;
+
+    case BLE_DB_DISCOVERY_AVAILABLE:
+      // Subscribe to data, then to control once that is acknowledged
+      if (data_cccd_handle != BLE_GATT_HANDLE_INVALID && control_cccd_handle != BLE_GATT_HANDLE_INVALID) {
+        write_cccd(data_cccd_handle);
+      } else {
+        printf("Benchmark service not found\n");
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+  ret_code_t err_code;
+  ble_gap_evt_t const* p_gap_evt = &p_ble_evt->evt.gap_evt;
+
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      printf("Connected\n");
+      conn_handle = p_gap_evt->conn_handle;
+      link_mtu = BLE_GATT_ATT_MTU_DEFAULT;
+      link_data_length = 27;
+      link_phy = BENCH_PHY_1M;
+      link_interval_units = p_gap_evt->params.connected.conn_params.max_conn_interval;
+      data_cccd_handle = control_cccd_handle = BLE_GATT_HANDLE_INVALID;
+      subscribed = false;
+      // There is no exchange to wait for at the default MTU
+      mtu_exchanged = config.att_mtu == BLE_GATT_ATT_MTU_DEFAULT;
+
+      err_code = ble_db_discovery_start(&m_db_disc, conn_handle);
+      APP_ERROR_CHECK(err_code);
+      break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+      conn_handle = BLE_CONN_HANDLE_INVALID;
+      app_timer_stop(step_timer);
+      if (phase == PHASE_DONE) {
+        break;
+      }
+
+      // Lost in the middle of a configuration: skip it
+      if (phase != PHASE_CONNECTING) {
+        printf("Disconnected during a test (0x%x)\n", p_gap_evt->params.disconnected.reason);
+        if (!bench_sweep_next(&sweep)) {
+          phase = PHASE_DONE;
+          break;
+        }
+        config = bench_sweep_config(&sweep);
+        phase = PHASE_CONNECTING;
+      }
+
+      err_code = nrf_ble_gatt_att_mtu_central_set(&m_gatt, config.att_mtu);
+      APP_ERROR_CHECK(err_code);
+      scan_start();
+      break;
+
+    case BLE_GAP_EVT_PHY_UPDATE:
+      link_phy = p_gap_evt->params.phy_update.tx_phy;
+      if (phase == PHASE_PHY) {
+        advance();
+      }
+      break;
+
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+      link_interval_units = p_gap_evt->params.conn_param_update.conn_params.max_conn_interval;
+      if (phase == PHASE_INTERVAL) {
+        advance();
+      }
+      break;
+
+    case BLE_GAP_EVT_PHY_UPDATE_REQUEST: {
+      ble_gap_phys_t const phys = {
+        .rx_phys = BLE_GAP_PHY_AUTO,
+        .tx_phys = BLE_GAP_PHY_AUTO,
+      };
+      err_code = sd_ble_gap_phy_update(p_gap_evt->conn_handle, &phys);
+      APP_ERROR_CHECK(err_code);
+      break;
+    }
+
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE_REQUEST: {
+      // The sweep decides the interval
+      ble_gap_conn_params_t const conn_params = {
+        .min_conn_interval = link_interval_units,
+        .max_conn_interval = link_interval_units,
+        .slave_latency     = 0,
+        .conn_sup_timeout  = MSEC_TO_UNITS(BENCH_SUPERVISION_TIMEOUT_MS, UNIT_10_MS),
+      };
+      err_code = sd_ble_gap_conn_param_update(p_gap_evt->conn_handle, &conn_params);
+      APP_ERROR_CHECK(err_code);
+      break;
+    }
+
+    case BLE_GATTC_EVT_WRITE_RSP:
+      if (phase == PHASE_CONNECTING && p_ble_evt->evt.gattc_evt.params.write_rsp.handle == data_cccd_handle) {
+        write_cccd(control_cccd_handle);
+      } else if (phase == PHASE_CONNECTING &&
+                 p_ble_evt->evt.gattc_evt.params.write_rsp.handle == control_cccd_handle) {
+        subscribed = true;
+        check_connected();
+      }
+      break;
+
+    case BLE_GATTC_EVT_WRITE_CMD_TX_COMPLETE: {
+      uint32_t now = bench_clock_us();
+      for (uint8_t i = 0; i < p_ble_evt->evt.gattc_evt.params.write_cmd_tx_complete.count; i++) {
+        if (phase == PHASE_WRITE && bench_stats_inflight(&stats) > 0) {
+          bench_stats_completed(&stats, link_mtu - 3, now);
+        }
+      }
+      send_writes();
+      break;
+    }
+
+    case BLE_GATTC_EVT_HVX: {
+      ble_gattc_evt_hvx_t const* hvx = &p_ble_evt->evt.gattc_evt.params.hvx;
+      if (phase != PHASE_NOTIFY) {
+        break;
+      }
+
+      if (hvx->handle == data_handle) {
+        bench_stats_add_packet(&stats, hvx->len);
+      } else if (hvx->handle == control_handle && hvx->len >= sizeof(bench_result_msg_t) &&
+                 hvx->data[0] == BENCH_OP_RESULT) {
+        bench_result_msg_t result;
+        memcpy(&result, hvx->data, sizeof(result));
+        app_timer_stop(step_timer);
+        finish(&result);
+      }
+      break;
+    }
+
+    case BLE_GATTC_EVT_TIMEOUT:
+      err_code = sd_ble_gap_disconnect(p_ble_evt->evt.gattc_evt.conn_handle,
+          BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+      APP_ERROR_CHECK(err_code);
+      break;
+
+    default:
+      break;
+  }
+}
+
+// Note: this overrides the "weak" ble_stack_init() defined in simple_ble
+void ble_stack_init(void) {
+  ret_code_t err_code = nrf_sdh_enable_request();
+  APP_ERROR_CHECK(err_code);
+
+  uint32_t ram_start = 0;
+  err_code = nrf_sdh_ble_default_cfg_set(APP_BLE_CONN_CFG_TAG, &ram_start);
+  APP_ERROR_CHECK(err_code);
+
+  // More than the default of one write without response in flight
+  ble_cfg_t ble_cfg;
+  memset(&ble_cfg, 0, sizeof(ble_cfg));
+  ble_cfg.conn_cfg.conn_cfg_tag = APP_BLE_CONN_CFG_TAG;
+  ble_cfg.conn_cfg.params.gattc_conn_cfg.write_cmd_tx_queue_size = BENCH_TX_QUEUE_SIZE;
+  err_code = sd_ble_cfg_set(BLE_CONN_CFG_GATTC, &ble_cfg, ram_start);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = nrf_sdh_ble_enable(&ram_start);
+  APP_ERROR_CHECK(err_code);
+
+  // Connection events run on while there is data, past the configured
+  // event length
+  ble_opt_t opt;
+  memset(&opt, 0, sizeof(opt));
+  opt.common_opt.conn_evt_ext.enable = 1;
+  err_code = sd_ble_opt_set(BLE_COMMON_OPT_CONN_EVT_EXT, &opt);
+  APP_ERROR_CHECK(err_code);
+
+  NRF_SDH_BLE_OBSERVER(m_ble_observer, APP_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
+}
+
+static void discovery_init(void) {
+  ret_code_t err_code = ble_db_discovery_init(db_disc_handler);
+  APP_ERROR_CHECK(err_code);
+
+  ble_uuid128_t const base = {BENCH_UUID_BASE};
+  err_code = sd_ble_uuid_vs_add(&base, &bench_uuid_type);
+  APP_ERROR_CHECK(err_code);
+
+  ble_uuid_t const service = {
+    .uuid = BENCH_UUID_SERVICE,
+    .type = bench_uuid_type,
+  };
+  err_code = ble_db_discovery_evt_register(&service);
+  APP_ERROR_CHECK(err_code);
+}
+
+static void scan_init(void) {
+  nrf_ble_scan_init_t init_scan;
+  memset(&init_scan, 0, sizeof(init_scan));
+  init_scan.connect_if_match = true;
+  init_scan.conn_cfg_tag     = APP_BLE_CONN_CFG_TAG;
+
+  ret_code_t err_code = nrf_ble_scan_init(&m_scan, &init_scan, NULL);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = nrf_ble_scan_filters_enable(&m_scan, NRF_BLE_SCAN_NAME_FILTER, false);
+  APP_ERROR_CHECK(err_code);
+  err_code = nrf_ble_scan_filter_set(&m_scan, SCAN_NAME_FILTER, BENCH_DEVICE_NAME);
+  APP_ERROR_CHECK(err_code);
+}
+
+int main(void) {
+  ret_code_t err_code = nrf_pwr_mgmt_init();
+  APP_ERROR_CHECK(err_code);
+  err_code = app_timer_init();
+  APP_ERROR_CHECK(err_code);
+  err_code = app_timer_create(&step_timer, APP_TIMER_MODE_SINGLE_SHOT, step_timeout);
+  APP_ERROR_CHECK(err_code);
+  bench_clock_init();
+
+  ble_stack_init();
+  err_code = nrf_ble_gatt_init(&m_gatt, gatt_evt_handler);
+  APP_ERROR_CHECK(err_code);
+  discovery_init();
+  scan_init();
+
+  bench_sweep_start(&sweep);
+  config = bench_sweep_config(&sweep);
+  err_code = nrf_ble_gatt_att_mtu_central_set(&m_gatt, config.att_mtu);
+  APP_ERROR_CHECK(err_code);
+
+  printf("Sweeping %u configurations, looking for \"%s\"\n", bench_sweep_count(), BENCH_DEVICE_NAME);
+  scan_start();
+
+  while (1) {
+    nrf_pwr_mgmt_run();
+  }
+}
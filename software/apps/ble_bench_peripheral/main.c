@@ -0,0 +1,251 @@
+// BLE Benchmark peripheral
+//
+// Counterpart of ble_bench_central: takes its writes and sends notifications
+// when asked, see bench_protocol.h. The central runs the sweep and prints
+// the results; this side only prints what it receives.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "nrf_sdh.h"
+#include "nrf_sdh_ble.h"
+#include "simple_ble.h"
+
+#include "nrf52840dk.h"
+
+#include "bench_clock.h"
+#include "bench_protocol.h"
+#include "bench_stats.h"
+
+#define APP_BLE_CONN_CFG_TAG  1 // Softdevice BLE configuration, as in simple_ble
+#define APP_BLE_OBSERVER_PRIO 3 // BLE observer priority
+
+// The interval range covers the central's sweep, so the connection
+// parameters module accepts whatever the central picks
+static simple_ble_config_t ble_config = {
+  // c0:98:e5:4e:xx:xx
+  .platform_id       = 0x4E,    // used as 4th octect in device BLE address
+  .device_id         = 0xBE00,
+  .adv_name          = BENCH_DEVICE_NAME,
+  .adv_interval      = MSEC_TO_UNITS(100, UNIT_0_625_MS),
+  .min_conn_interval = MSEC_TO_UNITS(7.5, UNIT_1_25_MS),
+  .max_conn_interval = MSEC_TO_UNITS(100, UNIT_1_25_MS),
+};
+
+/*******************************************************************************
+ *   State for this application
+ ******************************************************************************/
+// Main application state
+simple_ble_app_t* simple_ble_app;
+
+static simple_ble_service_t bench_service = {{
+  .uuid128 = BENCH_UUID_BASE
+}};
+
+static simple_ble_char_t data_char = {.uuid16 = BENCH_UUID_DATA};
+static simple_ble_char_t control_char = {.uuid16 = BENCH_UUID_CONTROL};
+static uint8_t data_value[BENCH_MAX_PAYLOAD];
+static uint8_t control_value[sizeof(bench_result_msg_t)];
+
+static uint16_t conn_handle = BLE_CONN_HANDLE_INVALID;
+
+// Notification test in progress
+static bench_stats_t notify_stats;
+static bool notifying = false;
+static bool result_pending = false;
+static uint16_t notify_length;
+
+// Writes from the central's write test
+static uint32_t writes = 0;
+static uint32_t write_bytes = 0;
+
+APP_TIMER_DEF(notify_timer);
+APP_TIMER_DEF(print_timer);
+
+static void send_notifications(void) {
+  while (notifying) {
+    uint16_t length = notify_length;
+    ble_gatts_hvx_params_t const hvx = {
+      .handle = data_char.char_handle.value_handle,
+      .type   = BLE_GATT_HVX_NOTIFICATION,
+      .offset = 0,
+      .p_len  = &length,
+      .p_data = data_value,
+    };
+
+    // Stops at a full queue; TX complete events refill it
+    if (sd_ble_gatts_hvx(conn_handle, &hvx) != NRF_SUCCESS ||
+        !bench_stats_queued(&notify_stats, bench_clock_us())) {
+      return;
+    }
+  }
+}
+
+// The result goes out once every notification is accounted for
+static void send_result(void) {
+  if (!result_pending || bench_stats_inflight(&notify_stats) > 0) {
+    return;
+  }
+
+  bench_result_msg_t result = {
+    .op = BENCH_OP_RESULT,
+    .packets = notify_stats.packets,
+    .p50_us = bench_stats_percentile_us(&notify_stats, 50),
+    .p90_us = bench_stats_percentile_us(&notify_stats, 90),
+    .p99_us = bench_stats_percentile_us(&notify_stats, 99),
+  };
+  memcpy(control_value, &result, sizeof(result));
+
+  uint16_t length = sizeof(result);
+  ble_gatts_hvx_params_t const hvx = {
+    .handle = control_char.char_handle.value_handle,
+    .type   = BLE_GATT_HVX_NOTIFICATION,
+    .offset = 0,
+    .p_len  = &length,
+    .p_data = control_value,
+  };
+  if (sd_ble_gatts_hvx(conn_handle, &hvx) == NRF_SUCCESS) {
+    result_pending = false;
+  }
+}
+
+static void notify_done(void* context) {
+  notifying = false;
+  result_pending = true;
+  send_result();
+}
+
+static void start_notifications(bench_notify_cmd_t const* cmd) {
+  bench_stats_reset(&notify_stats);
+  notify_length = cmd->length < BENCH_MAX_PAYLOAD ? cmd->length : BENCH_MAX_PAYLOAD;
+  notifying = true;
+  result_pending = false;
+
+  ret_code_t err_code = app_timer_start(notify_timer, APP_TIMER_TICKS(cmd->duration_ms), NULL);
+  APP_ERROR_CHECK(err_code);
+  send_notifications();
+}
+
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED:
+      conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+      break;
+
+    case BLE_GAP_EVT_DISCONNECTED:
+      conn_handle = BLE_CONN_HANDLE_INVALID;
+      notifying = false;
+      result_pending = false;
+      app_timer_stop(notify_timer);
+      break;
+
+    case BLE_GATTS_EVT_WRITE: {
+      ble_gatts_evt_write_t const* write = &p_ble_evt->evt.gatts_evt.params.write;
+      if (write->handle == data_char.char_handle.value_handle) {
+        writes++;
+        write_bytes += write->len;
+      } else if (write->handle == control_char.char_handle.value_handle &&
+                 write->len >= sizeof(bench_notify_cmd_t) && write->data[0] == BENCH_OP_NOTIFY) {
+        bench_notify_cmd_t cmd;
+        memcpy(&cmd, write->data, sizeof(cmd));
+        start_notifications(&cmd);
+      }
+      break;
+    }
+
+    case BLE_GATTS_EVT_HVN_TX_COMPLETE: {
+      uint32_t now = bench_clock_us();
+      for (uint8_t i = 0; i < p_ble_evt->evt.gatts_evt.params.hvn_tx_complete.count; i++) {
+        // the result notification isn't part of the test
+        if (bench_stats_inflight(&notify_stats) > 0) {
+          bench_stats_completed(&notify_stats, notify_length, now);
+        }
+      }
+      send_notifications();
+      send_result();
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+NRF_SDH_BLE_OBSERVER(bench_observer, APP_BLE_OBSERVER_PRIO, ble_evt_handler, NULL);
+
+// Note: this overrides the "weak" ble_stack_init() defined in simple_ble, to
+// let more notifications queue than the default of one
+void ble_stack_init(void) {
+  ret_code_t err_code = nrf_sdh_enable_request();
+  APP_ERROR_CHECK(err_code);
+
+  uint32_t ram_start = 0;
+  err_code = nrf_sdh_ble_default_cfg_set(APP_BLE_CONN_CFG_TAG, &ram_start);
+  APP_ERROR_CHECK(err_code);
+
+  ble_cfg_t ble_cfg;
+  memset(&ble_cfg, 0, sizeof(ble_cfg));
+  ble_cfg.conn_cfg.conn_cfg_tag = APP_BLE_CONN_CFG_TAG;
+  ble_cfg.conn_cfg.params.gatts_conn_cfg.hvn_tx_queue_size = BENCH_TX_QUEUE_SIZE;
+  err_code = sd_ble_cfg_set(BLE_CONN_CFG_GATTS, &ble_cfg, ram_start);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = nrf_sdh_ble_enable(&ram_start);
+  APP_ERROR_CHECK(err_code);
+
+  // Connection events run on while there is data to send
+  ble_opt_t opt;
+  memset(&opt, 0, sizeof(opt));
+  opt.common_opt.conn_evt_ext.enable = 1;
+  err_code = sd_ble_opt_set(BLE_COMMON_OPT_CONN_EVT_EXT, &opt);
+  APP_ERROR_CHECK(err_code);
+}
+
+static void print_writes(void* context) {
+  static uint32_t last_writes = 0;
+  static uint32_t last_bytes = 0;
+
+  if (writes != last_writes) {
+    printf("Received %lu writes/s, %lu B/s\n", writes - last_writes, write_bytes - last_bytes);
+  }
+  last_writes = writes;
+  last_bytes = write_bytes;
+}
+
+int main(void) {
+
+  printf("Board started. Initializing BLE: \n");
+
+  bench_clock_init();
+  for (uint16_t i = 0; i < sizeof(data_value); i++) {
+    data_value[i] = i;
+  }
+
+  // Setup BLE
+  simple_ble_app = simple_ble_init(&ble_config);
+
+  simple_ble_add_service(&bench_service);
+  // write without response and notify, variable length
+  simple_ble_add_characteristic(0, 1, 1, 1,
+      sizeof(data_value), data_value,
+      &bench_service, &data_char);
+  simple_ble_add_characteristic(0, 1, 1, 1,
+      sizeof(control_value), control_value,
+      &bench_service, &control_char);
+
+  app_timer_init();
+  app_timer_create(&notify_timer, APP_TIMER_MODE_SINGLE_SHOT, notify_done);
+  app_timer_create(&print_timer, APP_TIMER_MODE_REPEATED, print_writes);
+  app_timer_start(print_timer, APP_TIMER_TICKS(1000), NULL);
+
+  // Start Advertising
+  simple_ble_adv_only_name();
+
+  while(1) {
+    power_manage();
+  }
+}
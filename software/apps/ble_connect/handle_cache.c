@@ -0,0 +1,174 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "app_error.h"
+#include "crc16.h"
+#include "nrf_fstorage.h"
+#include "nrf_fstorage_sd.h"
+
+#include "handle_cache.h"
+
+// Changes whenever the layout of the saved table does
+#define HANDLE_CACHE_MAGIC 0x48433032 // "HC02"
+#define PAGE_SIZE 4096
+
+typedef struct {
+  uint8_t addr[BLE_GAP_ADDR_LEN];
+  uint8_t addr_type;
+  uint8_t in_use;
+  uint16_t last_used;       // least recently used entry makes room
+  peer_handles_t handles;
+} handle_cache_entry_t;
+
+typedef struct {
+  uint32_t magic;
+  uint16_t crc; // of the entries, so a page torn by a reset mid-save is dropped
+  uint16_t reserved;
+  handle_cache_entry_t entries[HANDLE_CACHE_SIZE];
+} handle_cache_table_t;
+
+static handle_cache_table_t table;
+static uint16_t use_count = 0;
+static handle_cache_stats_t stats;
+
+// fstorage writes from this copy while the table keeps changing
+static handle_cache_table_t image;
+static bool saving = false;
+static bool dirty = false;
+
+static void fstorage_evt_handler(nrf_fstorage_evt_t* evt);
+
+NRF_FSTORAGE_DEF(nrf_fstorage_t fstorage) = {
+  .evt_handler = fstorage_evt_handler,
+  .start_addr  = HANDLE_CACHE_FLASH_ADDR,
+  .end_addr    = HANDLE_CACHE_FLASH_ADDR + PAGE_SIZE - 1,
+};
+
+static uint16_t entries_crc(handle_cache_table_t const* saved) {
+  return crc16_compute((uint8_t const*)saved->entries, sizeof(saved->entries), NULL);
+}
+
+static void save(void) {
+  if (saving) {
+    // saved again once the current save finishes
+    dirty = true;
+    return;
+  }
+
+  saving = true;
+  dirty = false;
+  memcpy(&image, &table, sizeof(image));
+  image.crc = entries_crc(&image);
+  ret_code_t err_code = nrf_fstorage_erase(&fstorage, HANDLE_CACHE_FLASH_ADDR, 1, NULL);
+  APP_ERROR_CHECK(err_code);
+}
+
+static void fstorage_evt_handler(nrf_fstorage_evt_t* evt) {
+  if (evt->result != NRF_SUCCESS) {
+    // The cache still works from RAM, it just won't survive a reset
+    saving = false;
+    return;
+  }
+
+  if (evt->id == NRF_FSTORAGE_EVT_ERASE_RESULT) {
+    ret_code_t err_code = nrf_fstorage_write(&fstorage, HANDLE_CACHE_FLASH_ADDR, &image, sizeof(image), NULL);
+    APP_ERROR_CHECK(err_code);
+    return;
+  }
+
+  saving = false;
+  stats.saves++;
+  if (dirty) {
+    save();
+  }
+}
+
+static handle_cache_entry_t* find_entry(ble_gap_addr_t const* addr) {
+  for (uint8_t i = 0; i < HANDLE_CACHE_SIZE; i++) {
+    handle_cache_entry_t* entry = &table.entries[i];
+    if (entry->in_use && entry->addr_type == addr->addr_type &&
+        memcmp(entry->addr, addr->addr, BLE_GAP_ADDR_LEN) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+void handle_cache_init(void) {
+  ret_code_t err_code = nrf_fstorage_init(&fstorage, &nrf_fstorage_sd, NULL);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = nrf_fstorage_read(&fstorage, HANDLE_CACHE_FLASH_ADDR, &table, sizeof(table));
+  APP_ERROR_CHECK(err_code);
+
+  // Blank flash, an older layout, or a save cut short
+  if (table.magic != HANDLE_CACHE_MAGIC || table.crc != entries_crc(&table)) {
+    memset(&table, 0, sizeof(table));
+    table.magic = HANDLE_CACHE_MAGIC;
+  }
+
+  for (uint8_t i = 0; i < HANDLE_CACHE_SIZE; i++) {
+    if (table.entries[i].in_use && table.entries[i].last_used > use_count) {
+      use_count = table.entries[i].last_used;
+    }
+  }
+}
+
+bool handle_cache_find(ble_gap_addr_t const* addr, peer_handles_t* handles) {
+  handle_cache_entry_t* entry = find_entry(addr);
+  if (entry == NULL) {
+    stats.misses++;
+    return false;
+  }
+
+  // Use order only matters while running, so it isn't saved on its own
+  entry->last_used = ++use_count;
+  *handles = entry->handles;
+  stats.hits++;
+  return true;
+}
+
+void handle_cache_store(ble_gap_addr_t const* addr, peer_handles_t const* handles) {
+  handle_cache_entry_t* entry = find_entry(addr);
+  if (entry != NULL && memcmp(&entry->handles, handles, sizeof(*handles)) == 0) {
+    return;
+  }
+
+  if (entry == NULL) {
+    // New peer replaces a free or the least recently used entry
+    entry = &table.entries[0];
+    for (uint8_t i = 0; i < HANDLE_CACHE_SIZE; i++) {
+      if (!table.entries[i].in_use) {
+        entry = &table.entries[i];
+        break;
+      }
+      if ((uint16_t)(use_count - table.entries[i].last_used) > (uint16_t)(use_count - entry->last_used)) {
+        entry = &table.entries[i];
+      }
+    }
+
+    memcpy(entry->addr, addr->addr, BLE_GAP_ADDR_LEN);
+    entry->addr_type = addr->addr_type;
+    entry->in_use = true;
+  }
+
+  entry->last_used = ++use_count;
+  entry->handles = *handles;
+  save();
+}
+
+void handle_cache_invalidate(ble_gap_addr_t const* addr) {
+  handle_cache_entry_t* entry = find_entry(addr);
+  if (entry == NULL) {
+    return;
+  }
+
+  entry->in_use = false;
+  stats.invalidations++;
+  save();
+}
+
+handle_cache_stats_t handle_cache_stats(void) {
+  return stats;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ble_gap.h"
+#include "ble_lbs_c.h"
+
+// GATT handle cache
+//
+// Remembers the attribute handles discovered on each peer, keyed by its
+// address, so a reconnecting peer can be used right away instead of running
+// service discovery again. The table lives in RAM and is saved to one flash
+// page through fstorage whenever an entry is added or dropped, and loaded
+// back at boot.
+//
+// Handles are only trusted until the peer shows they are stale (a Service
+// Changed indication or a failed write); the entry is then dropped and the
+// link falls back to discovery.
+
+#define HANDLE_CACHE_SIZE 16
+// One page just below the ten pages FDS uses at the end of flash
+#define HANDLE_CACHE_FLASH_ADDR 0xF5000
+
+typedef struct {
+  lbs_db_t lbs;
+  uint16_t sc_value_handle; // Service Changed, 0 if the peer has none
+  uint16_t sc_cccd_handle;
+} peer_handles_t;
+
+typedef struct {
+  uint32_t hits;
+  uint32_t misses;
+  uint32_t invalidations;
+  uint32_t saves;
+} handle_cache_stats_t;
+
+// Loads the table from flash
+void handle_cache_init(void);
+
+// Returns true and fills in the handles if the peer is cached
+bool handle_cache_find(ble_gap_addr_t const* addr, peer_handles_t* handles);
+
+void handle_cache_store(ble_gap_addr_t const* addr, peer_handles_t const* handles);
+void handle_cache_invalidate(ble_gap_addr_t const* addr);
+
+handle_cache_stats_t handle_cache_stats(void);
@@ -0,0 +1,126 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "app_timer.h"
+#include "app_util.h"
+
+#include "links.h"
+
+static link_t links[LINK_COUNT];
+
+static ble_gap_conn_params_t const conn_params = {
+  .min_conn_interval = LINK_CONN_INTERVAL_UNITS,
+  .max_conn_interval = LINK_CONN_INTERVAL_UNITS,
+  .slave_latency     = NRF_BLE_SCAN_SLAVE_LATENCY,
+  .conn_sup_timeout  = MSEC_TO_UNITS(NRF_BLE_SCAN_SUPERVISION_TIMEOUT, UNIT_10_MS),
+};
+
+// Totals of links that have since disconnected
+static uint32_t closed_notifications = 0;
+static uint32_t closed_writes = 0;
+
+static uint32_t cached_first_writes = 0;
+static uint64_t cached_first_write_ms_total = 0;
+static uint32_t discovered_first_writes = 0;
+static uint64_t discovered_first_write_ms_total = 0;
+
+ble_gap_conn_params_t const* links_conn_params(void) {
+  return &conn_params;
+}
+
+link_t* links_get(uint16_t conn_handle) {
+  if (conn_handle >= LINK_COUNT) {
+    return NULL;
+  }
+  return &links[conn_handle];
+}
+
+void links_connected(uint16_t conn_handle, ble_gap_evt_connected_t const* connected) {
+  link_t* link = links_get(conn_handle);
+  if (link == NULL) {
+    return;
+  }
+
+  memset(link, 0, sizeof(*link));
+  link->connected = true;
+  link->peer_addr = connected->peer_addr;
+  link->interval_units = connected->conn_params.max_conn_interval;
+  link->connected_ticks = app_timer_cnt_get();
+  // unknown until the first write
+  link->led_written = 0xFF;
+}
+
+void links_disconnected(uint16_t conn_handle) {
+  link_t* link = links_get(conn_handle);
+  if (link == NULL) {
+    return;
+  }
+
+  closed_notifications += link->notifications;
+  closed_writes += link->writes;
+  memset(link, 0, sizeof(*link));
+}
+
+void links_interval_updated(uint16_t conn_handle, uint16_t interval_units) {
+  link_t* link = links_get(conn_handle);
+  if (link != NULL) {
+    link->interval_units = interval_units;
+  }
+}
+
+void links_write_done(uint16_t conn_handle) {
+  link_t* link = links_get(conn_handle);
+  if (link == NULL) {
+    return;
+  }
+
+  link->writes++;
+  if (link->written) {
+    return;
+  }
+
+  link->written = true;
+  uint32_t ticks = app_timer_cnt_diff_compute(app_timer_cnt_get(), link->connected_ticks);
+  uint32_t ms = (uint64_t)ticks * 1000 / APP_TIMER_CLOCK_FREQ;
+  if (link->handles_cached) {
+    cached_first_writes++;
+    cached_first_write_ms_total += ms;
+  } else {
+    discovered_first_writes++;
+    discovered_first_write_ms_total += ms;
+  }
+}
+
+uint8_t links_connected_count(void) {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < LINK_COUNT; i++) {
+    count += links[i].connected;
+  }
+  return count;
+}
+
+links_stats_t links_stats(void) {
+  links_stats_t stats = {
+    .notifications = closed_notifications,
+    .writes = closed_writes,
+    .cached_first_writes = cached_first_writes,
+    .cached_first_write_ms = cached_first_writes ? cached_first_write_ms_total / cached_first_writes : 0,
+    .discovered_first_writes = discovered_first_writes,
+    .discovered_first_write_ms = discovered_first_writes ? discovered_first_write_ms_total / discovered_first_writes : 0,
+  };
+
+  for (uint8_t i = 0; i < LINK_COUNT; i++) {
+    link_t const* link = &links[i];
+    if (!link->connected) {
+      continue;
+    }
+
+    stats.connected++;
+    stats.ready += link->ready;
+    stats.off_plan += link->interval_units != LINK_CONN_INTERVAL_UNITS;
+    stats.notifications += link->notifications;
+    stats.writes += link->writes;
+  }
+  return stats;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ble_gap.h"
+#include "sdk_config.h"
+
+#include "handle_cache.h"
+
+// Per-link state for the central
+//
+// Central links are indexed by connection handle, which the SoftDevice hands
+// out from 0 to NRF_SDH_BLE_CENTRAL_LINK_COUNT - 1 when there are no
+// peripheral links.
+//
+// Connection plan: every link runs at the same interval, long enough to hold
+// one event of NRF_SDH_BLE_GAP_EVENT_LENGTH for each link. The SoftDevice then
+// places the central links back to back in each interval instead of letting
+// their events collide and get skipped. Parameter updates requested by
+// peripherals are answered with the plan rather than accepted.
+
+#define LINK_COUNT NRF_SDH_BLE_CENTRAL_LINK_COUNT
+
+// in 1.25 ms units, at least the 7.5 ms the spec allows
+#define LINK_CONN_INTERVAL_MIN_UNITS 6
+#define LINK_CONN_INTERVAL_UNITS                                               \
+  (LINK_COUNT * NRF_SDH_BLE_GAP_EVENT_LENGTH > LINK_CONN_INTERVAL_MIN_UNITS    \
+       ? LINK_COUNT * NRF_SDH_BLE_GAP_EVENT_LENGTH                             \
+       : LINK_CONN_INTERVAL_MIN_UNITS)
+#define LINK_CONN_INTERVAL_MS (LINK_CONN_INTERVAL_UNITS * 5 / 4)
+
+typedef struct {
+  bool connected;
+  bool ready;          // LED Button handles known and notifications on
+  bool handles_cached; // handles came from the cache instead of discovery
+  bool sc_enabled;     // Service Changed indications turned on
+  bool stale;          // handles need discovering again
+  bool write_pending;  // a write is waiting for its response
+  bool written;        // an LED write has completed on this connection
+  uint8_t led_target;  // LED state the link should be at
+  uint8_t led_written; // LED state last written to the peer
+  ble_gap_addr_t peer_addr;
+  peer_handles_t handles;
+  uint16_t interval_units;
+  uint32_t connected_ticks;
+  uint32_t notifications;
+  uint32_t writes;
+} link_t;
+
+typedef struct {
+  uint8_t connected;
+  uint8_t ready;
+  uint8_t off_plan;    // links running at an interval other than the plan
+  uint32_t notifications;
+  uint32_t writes;
+
+  // Connect to first completed LED write, split by where the handles came from
+  uint32_t cached_first_writes;
+  uint32_t cached_first_write_ms;     // average
+  uint32_t discovered_first_writes;
+  uint32_t discovered_first_write_ms; // average
+} links_stats_t;
+
+ble_gap_conn_params_t const* links_conn_params(void);
+
+// Returns NULL for a handle that isn't a central link
+link_t* links_get(uint16_t conn_handle);
+
+void links_connected(uint16_t conn_handle, ble_gap_evt_connected_t const* connected);
+void links_disconnected(uint16_t conn_handle);
+void links_interval_updated(uint16_t conn_handle, uint16_t interval_units);
+
+// Counts a completed LED write
+void links_write_done(uint16_t conn_handle);
+
+uint8_t links_connected_count(void);
+
+// Totals over all links since boot
+links_stats_t links_stats(void);
@@ -1,6 +1,7 @@
-// BLE Scanning app
+// BLE Connecting app
 //
-// Receives BLE advertisements
+// Connects to up to LINK_COUNT LED Button peripherals at once and drives
+// their LEDs
 
 #include <stdbool.h>
 #include <stdint.h>
@@ -17,14 +18,36 @@
 
 #include "nrf52840dk.h"
 
+#include "handle_cache.h"
+#include "links.h"
+#include "deferred_log.h"
+#include "telemetry.h"
+
+// Toggle every LED once per connection interval to measure write throughput.
+// Off by default: it keeps the radio and the peripherals busy all the time
+#ifndef LINK_STRESS_WRITES
+#define LINK_STRESS_WRITES 0
+#endif
+
 // Scanning/Connecting state
 #define APP_BLE_CONN_CFG_TAG  1 // Softdevice BLE configuration
 #define APP_BLE_OBSERVER_PRIO 3 // BLE observer priority
 NRF_BLE_GATT_DEF(m_gatt); // GATT module instance
 NRF_BLE_SCAN_DEF(m_scan); // Scanning module instance
-BLE_DB_DISCOVERY_DEF(m_db_disc); // DB discovery module instance
+BLE_DB_DISCOVERY_ARRAY_DEF(m_db_disc, LINK_COUNT); // DB discovery module instances, one per link
 static char const m_target_periph_name[] = "Nordic_Blinky"; // Name of the device we try to connect to
-BLE_LBS_C_DEF(m_ble_lbs_c); // Structure used by LBS client module
+BLE_LBS_C_ARRAY_DEF(m_lbs_c, LINK_COUNT); // LBS client instances, one per link
+
+APP_TIMER_DEF(stats_timer);
+#if LINK_STRESS_WRITES
+APP_TIMER_DEF(stress_timer);
+#endif
+
+// LED state every peripheral should show
+static uint8_t m_led_state = 0;
+
+// Written to a peer's Service Changed CCCD to turn on indications
+static uint8_t const m_sc_cccd_value[] = {BLE_GATT_HVX_INDICATION, 0};
 
 // Function signatures
 static void scan_start(void);
@@ -57,9 +80,154 @@ static void scan_evt_handler(scan_evt_t const * p_scan_evt)
     }
 }
 
-// handler for GATT discovery
+// Hands the link's handles to its LBS client and turns on button
+// notifications. The CCCD write holds the link until its response
+static void link_start(uint16_t conn_handle) {
+  link_t* link = links_get(conn_handle);
+
+  ret_code_t err_code = ble_lbs_c_handles_assign(&m_lbs_c[conn_handle], conn_handle, &link->handles.lbs);
+  APP_ERROR_CHECK(err_code);
+  err_code = ble_lbs_c_button_notif_enable(&m_lbs_c[conn_handle]);
+  APP_ERROR_CHECK(err_code);
+
+  link->led_target    = m_led_state;
+  link->write_pending = true;
+  link->ready         = true;
+}
+
+// Drops the link's handles, cached or not, and discovers them again
+static void link_rediscover(uint16_t conn_handle) {
+  link_t* link = links_get(conn_handle);
+
+  handle_cache_invalidate(&link->peer_addr);
+  memset(&link->handles, 0, sizeof(link->handles));
+  link->ready          = false;
+  link->stale          = false;
+  link->handles_cached = false;
+  link->sc_enabled     = false;
+  link->led_written    = 0xFF;
+
+  ret_code_t err_code = ble_db_discovery_start(&m_db_disc[conn_handle], conn_handle);
+  APP_ERROR_CHECK(err_code);
+}
+
+// handler for GATT discovery, which runs on all links at once
 static void db_disc_handler(ble_db_discovery_evt_t * p_evt) {
-  //ble_lbs_on_db_disc_evt(&m_ble_lbs_c, p_evt);
+  link_t* link = links_get(p_evt->conn_handle);
+  if (link == NULL) {
+    return;
+  }
+
+  ble_lbs_on_db_disc_evt(&m_lbs_c[p_evt->conn_handle], p_evt);
+
+  switch (p_evt->evt_type) {
+    case BLE_DB_DISCOVERY_COMPLETE:
+      // The LBS client picks up its own service
+      if (p_evt->params.discovered_db.srv_uuid.uuid == BLE_UUID_GATT) {
+        for (uint8_t i = 0; i < p_evt->params.discovered_db.char_count; i++) {
+          ble_gatt_db_char_t const* db_char = &p_evt->params.discovered_db.charateristics[i];
+          if (db_char->characteristic.uuid.uuid == BLE_UUID_GATT_CHARACTERISTIC_SERVICE_CHANGED) {
+            link->handles.sc_value_handle = db_char->characteristic.handle_value;
+            link->handles.sc_cccd_handle = db_char->cccd_handle;
+          }
+        }
+      }
+      break;
+
+    case BLE_DB_DISCOVERY_AVAILABLE:
+      // Every service has reported by now
+      if (link->handles.lbs.led_handle != BLE_GATT_HANDLE_INVALID) {
+        handle_cache_store(&link->peer_addr, &link->handles);
+        link_start(p_evt->conn_handle);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+// Brings the link's writes up to date: Service Changed indications first,
+// then the LED if it is behind its target. The SoftDevice runs one GATT
+// client procedure per link at a time, so a busy link catches up when its
+// write response arrives
+static void link_service(uint16_t conn_handle) {
+  link_t* link = links_get(conn_handle);
+  if (link == NULL || !link->ready || link->write_pending) {
+    return;
+  }
+
+  ret_code_t err_code;
+  if (!link->sc_enabled && link->handles.sc_cccd_handle != BLE_GATT_HANDLE_INVALID) {
+    ble_gattc_write_params_t const cccd_params = {
+      .write_op = BLE_GATT_OP_WRITE_REQ,
+      .handle   = link->handles.sc_cccd_handle,
+      .offset   = 0,
+      .len      = sizeof(m_sc_cccd_value),
+      .p_value  = m_sc_cccd_value,
+    };
+    err_code = sd_ble_gattc_write(conn_handle, &cccd_params);
+    if (err_code == NRF_ERROR_BUSY) {
+      return;
+    }
+    APP_ERROR_CHECK(err_code);
+    link->sc_enabled = true;
+    link->write_pending = true;
+    return;
+  }
+
+  if (link->led_written == link->led_target) {
+    return;
+  }
+
+  // The write goes straight to the SoftDevice: the LBS client's write queue
+  // is shared by all instances and too short for every link to have a write
+  // outstanding
+  uint8_t previous = link->led_written;
+  link->led_written = link->led_target;
+  ble_gattc_write_params_t const write_params = {
+    .write_op = BLE_GATT_OP_WRITE_REQ,
+    .handle   = link->handles.lbs.led_handle,
+    .offset   = 0,
+    .len      = sizeof(link->led_written),
+    .p_value  = &link->led_written,
+  };
+  err_code = sd_ble_gattc_write(conn_handle, &write_params);
+  if (err_code == NRF_ERROR_BUSY) {
+    link->led_written = previous;
+    return;
+  }
+  APP_ERROR_CHECK(err_code);
+  link->write_pending = true;
+}
+
+static void links_set_led(uint8_t led_state) {
+  m_led_state = led_state;
+  for (uint16_t conn_handle = 0; conn_handle < LINK_COUNT; conn_handle++) {
+    link_t* link = links_get(conn_handle);
+    link->led_target = led_state;
+    link_service(conn_handle);
+  }
+}
+
+#if LINK_STRESS_WRITES
+static void stress_toggle(void* context) {
+  links_set_led(!m_led_state);
+}
+#endif
+
+static void print_stats(void* context) {
+  static links_stats_t last = {0};
+  links_stats_t stats = links_stats();
+  handle_cache_stats_t cache = handle_cache_stats();
+
+  printf("Links: %u/%u connected, %u ready, %u off the %u ms plan | notifications %lu/s, writes %lu/s\n",
+      stats.connected, LINK_COUNT, stats.ready, stats.off_plan, LINK_CONN_INTERVAL_MS,
+      stats.notifications - last.notifications, stats.writes - last.writes);
+  printf("Handles: %lu cached, %lu discovered, %lu stale | first write %lu ms cached, %lu ms discovered\n",
+      cache.hits, cache.misses, cache.invalidations,
+      stats.cached_first_write_ms, stats.discovered_first_write_ms);
+  last = stats;
 }
 
 static void lbs_c_evt_handler(ble_lbs_c_t * p_lbs_c, ble_lbs_c_evt_t * p_lbs_c_evt)
@@ -68,32 +236,19 @@ static void lbs_c_evt_handler(ble_lbs_c_t * p_lbs_c, ble_lbs_c_evt_t * p_lbs_c_e
     {
         case BLE_LBS_C_EVT_DISCOVERY_COMPLETE:
         {
-            ret_code_t err_code;
-
-            err_code = ble_lbs_c_handles_assign(&m_ble_lbs_c,
-                                                p_lbs_c_evt->conn_handle,
-                                                &p_lbs_c_evt->params.peer_db);
-            printf("LED Button service discovered on conn_handle 0x%x.\n", p_lbs_c_evt->conn_handle);
-
-            //err_code = app_button_enable();
-            //APP_ERROR_CHECK(err_code);
-
-            // LED Button service discovered. Enable notification of Button.
-            err_code = ble_lbs_c_button_notif_enable(p_lbs_c);
-            APP_ERROR_CHECK(err_code);
+            // Started once the rest of the discovery is in
+            links_get(p_lbs_c_evt->conn_handle)->handles.lbs = p_lbs_c_evt->params.peer_db;
+            LOG("LED Button service discovered on conn_handle 0x%x.\n", p_lbs_c_evt->conn_handle);
         } break; // BLE_LBS_C_EVT_DISCOVERY_COMPLETE
 
         case BLE_LBS_C_EVT_BUTTON_NOTIFICATION:
         {
-            printf("Button state changed on peer to 0x%x.\n", p_lbs_c_evt->params.button.button_state);
-            if (p_lbs_c_evt->params.button.button_state)
-            {
-                //bsp_board_led_on(LEDBUTTON_LED);
-            }
-            else
-            {
-                //bsp_board_led_off(LEDBUTTON_LED);
-            }
+            links_get(p_lbs_c_evt->conn_handle)->notifications++;
+
+            // A button on any peer drives the LEDs on all of them
+            LOG("Button state changed on peer 0x%x to 0x%x.\n",
+                p_lbs_c_evt->conn_handle, p_lbs_c_evt->params.button.button_state);
+            links_set_led(p_lbs_c_evt->params.button.button_state);
         } break; // BLE_LBS_C_EVT_BUTTON_NOTIFICATION
 
         default:
@@ -107,36 +262,56 @@ static void lbs_c_evt_handler(ble_lbs_c_t * p_lbs_c, ble_lbs_c_evt_t * p_lbs_c_e
 static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
 {
   ret_code_t err_code;
-  printf("BLE event handler called\n");
 
   // For readability.
   ble_gap_evt_t const * p_gap_evt = &p_ble_evt->evt.gap_evt;
 
+  // Every event structure starts with the connection handle
+  TELEMETRY(TELEMETRY_ID_BLE_EVENT, p_ble_evt->header.evt_id, p_gap_evt->conn_handle);
+
   switch (p_ble_evt->header.evt_id)
   {
     // Upon connection, check which peripheral has connected (HR or RSC), initiate DB
     // discovery, update LEDs status and resume scanning if necessary. */
     case BLE_GAP_EVT_CONNECTED:
       {
-        printf("Connected!\n");
-
-        //err_code = ble_lbs_c_handles_assign(&m_ble_lbs_c, p_gap_evt->conn_handle, NULL);
-        //APP_ERROR_CHECK(err_code);
+        // The discovery and LBS instances are indexed by handle, so a handle
+        // past LINK_COUNT has none to use
+        link_t* link = links_get(p_gap_evt->conn_handle);
+        if (link == NULL) {
+          LOG("No link for conn_handle 0x%x, disconnecting.\n", p_gap_evt->conn_handle);
+          err_code = sd_ble_gap_disconnect(p_gap_evt->conn_handle,
+              BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+          APP_ERROR_CHECK(err_code);
+          break;
+        }
 
-        err_code = ble_db_discovery_start(&m_db_disc, p_gap_evt->conn_handle);
-        APP_ERROR_CHECK(err_code);
+        links_connected(p_gap_evt->conn_handle, &p_gap_evt->params.connected);
+        LOG("Connected on conn_handle 0x%x, %u/%u links.\n",
+            p_gap_evt->conn_handle, links_connected_count(), LINK_COUNT);
+
+        // A known peer is used right away. Otherwise discovery runs on the
+        // link's own instance, so links discover in parallel
+        if (handle_cache_find(&link->peer_addr, &link->handles)) {
+          link->handles_cached = true;
+          link_start(p_gap_evt->conn_handle);
+        } else {
+          err_code = ble_db_discovery_start(&m_db_disc[p_gap_evt->conn_handle], p_gap_evt->conn_handle);
+          APP_ERROR_CHECK(err_code);
+        }
 
-        // Update LEDs status, and check if we should be looking for more
-        // peripherals to connect to.
-        //bsp_board_led_on(CENTRAL_CONNECTED_LED);
-        //bsp_board_led_off(CENTRAL_SCANNING_LED);
+        // Connecting stopped the scanner; keep looking while links are free
+        if (links_connected_count() < LINK_COUNT) {
+          scan_start();
+        }
       } break;
 
       // Upon disconnection, reset the connection handle of the peer which disconnected, update
       // the LEDs status and start scanning again.
     case BLE_GAP_EVT_DISCONNECTED:
       {
-        printf("Disconnected!\n");
+        LOG("Disconnected conn_handle 0x%x.\n", p_gap_evt->conn_handle);
+        links_disconnected(p_gap_evt->conn_handle);
         scan_start();
       } break;
 
@@ -145,21 +320,76 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
         // We have not specified a timeout for scanning, so only connection attemps can timeout.
         if (p_gap_evt->params.timeout.src == BLE_GAP_TIMEOUT_SRC_CONN)
         {
-          printf("Connection request timed out.\n");
+          LOG("Connection request timed out.\n");
         }
       } break;
 
     case BLE_GAP_EVT_CONN_PARAM_UPDATE_REQUEST:
       {
-        // Accept parameters requested by peer.
-        err_code = sd_ble_gap_conn_param_update(p_gap_evt->conn_handle,
-            &p_gap_evt->params.conn_param_update_request.conn_params);
+        // Answer with the plan: a link at another interval would collide
+        // with the others.
+        err_code = sd_ble_gap_conn_param_update(p_gap_evt->conn_handle, links_conn_params());
+        APP_ERROR_CHECK(err_code);
+      } break;
+
+    case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+      {
+        links_interval_updated(p_gap_evt->conn_handle,
+            p_gap_evt->params.conn_param_update.conn_params.max_conn_interval);
+      } break;
+
+    case BLE_GATTC_EVT_WRITE_RSP:
+      {
+        uint16_t conn_handle = p_ble_evt->evt.gattc_evt.conn_handle;
+        link_t* link = links_get(conn_handle);
+        if (link == NULL) {
+          break;
+        }
+
+        link->write_pending = false;
+        if (p_ble_evt->evt.gattc_evt.gatt_status != BLE_GATT_STATUS_SUCCESS) {
+          // Cached handles that fail were probably moved. Freshly discovered
+          // ones would just fail again
+          LOG("Write failed on conn_handle 0x%x (0x%x).\n",
+              conn_handle, p_ble_evt->evt.gattc_evt.gatt_status);
+          link->stale |= link->handles_cached;
+        } else if (p_ble_evt->evt.gattc_evt.params.write_rsp.handle == link->handles.lbs.led_handle) {
+          links_write_done(conn_handle);
+        }
+
+        if (link->stale) {
+          link_rediscover(conn_handle);
+        } else {
+          link_service(conn_handle);
+        }
+      } break;
+
+    case BLE_GATTC_EVT_HVX:
+      {
+        uint16_t conn_handle = p_ble_evt->evt.gattc_evt.conn_handle;
+        ble_gattc_evt_hvx_t const* hvx = &p_ble_evt->evt.gattc_evt.params.hvx;
+        link_t* link = links_get(conn_handle);
+        if (link == NULL || hvx->type != BLE_GATT_HVX_INDICATION) {
+          break;
+        }
+
+        err_code = sd_ble_gattc_hv_confirm(conn_handle, hvx->handle);
         APP_ERROR_CHECK(err_code);
+
+        // Service Changed: rediscover now, or once the write in flight is
+        // answered
+        if (link->ready && hvx->handle == link->handles.sc_value_handle) {
+          LOG("Service changed on conn_handle 0x%x.\n", conn_handle);
+          link->stale = true;
+          if (!link->write_pending) {
+            link_rediscover(conn_handle);
+          }
+        }
       } break;
 
     case BLE_GAP_EVT_PHY_UPDATE_REQUEST:
       {
-        printf("PHY update request.\n");
+        LOG("PHY update request.\n");
         ble_gap_phys_t const phys =
         {
           .rx_phys = BLE_GAP_PHY_AUTO,
@@ -172,7 +402,7 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
     case BLE_GATTC_EVT_TIMEOUT:
       {
         // Disconnect on GATT Client timeout event.
-        printf("GATT Client Timeout.\n");
+        LOG("GATT Client Timeout.\n");
         err_code = sd_ble_gap_disconnect(p_ble_evt->evt.gattc_evt.conn_handle,
             BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
         APP_ERROR_CHECK(err_code);
@@ -181,7 +411,7 @@ static void ble_evt_handler(ble_evt_t const * p_ble_evt, void * p_context)
     case BLE_GATTS_EVT_TIMEOUT:
       {
         // Disconnect on GATT Server timeout event.
-        printf("GATT Server Timeout.\n");
+        LOG("GATT Server Timeout.\n");
         err_code = sd_ble_gap_disconnect(p_ble_evt->evt.gatts_evt.conn_handle,
             BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
         APP_ERROR_CHECK(err_code);
@@ -231,6 +461,7 @@ static void scan_init(void)
 
   init_scan.connect_if_match = true;
   init_scan.conn_cfg_tag     = APP_BLE_CONN_CFG_TAG;
+  init_scan.p_conn_param     = links_conn_params();
 
   err_code = nrf_ble_scan_init(&m_scan, &init_scan, scan_evt_handler);
   APP_ERROR_CHECK(err_code);
@@ -247,6 +478,14 @@ static void db_discovery_init(void)
 {
   ret_code_t err_code = ble_db_discovery_init(db_disc_handler);
   APP_ERROR_CHECK(err_code);
+
+  // The Generic Attribute service has the Service Changed characteristic
+  ble_uuid_t const gatt_uuid = {
+    .uuid = BLE_UUID_GATT,
+    .type = BLE_UUID_TYPE_BLE,
+  };
+  err_code = ble_db_discovery_evt_register(&gatt_uuid);
+  APP_ERROR_CHECK(err_code);
 }
 
 static void scan_start(void)
@@ -273,28 +512,47 @@ int main(void) {
   err_code = app_timer_init();
   APP_ERROR_CHECK(err_code);
 
+  telemetry_init();
+
   // Setup BLE and services
   ble_stack_init();
   printf("ble stack setup\n");
   gatt_init();
   printf("gatt setup\n");
+  handle_cache_init();
 
   // Initialize scanning and discovery
   scan_init();
   db_discovery_init();
 
-  // Initialize LED button client
+  // Initialize LED button clients
   ble_lbs_c_init_t lbs_c_init_obj;
   lbs_c_init_obj.evt_handler = lbs_c_evt_handler;
-  err_code = ble_lbs_c_init(&m_ble_lbs_c, &lbs_c_init_obj);
+  for (uint8_t i = 0; i < LINK_COUNT; i++) {
+    err_code = ble_lbs_c_init(&m_lbs_c[i], &lbs_c_init_obj);
+    APP_ERROR_CHECK(err_code);
+  }
+
+  // Report throughput every second
+  err_code = app_timer_create(&stats_timer, APP_TIMER_MODE_REPEATED, print_stats);
+  APP_ERROR_CHECK(err_code);
+  err_code = app_timer_start(stats_timer, APP_TIMER_TICKS(1000), NULL);
+  APP_ERROR_CHECK(err_code);
+
+#if LINK_STRESS_WRITES
+  err_code = app_timer_create(&stress_timer, APP_TIMER_MODE_REPEATED, stress_toggle);
+  APP_ERROR_CHECK(err_code);
+  err_code = app_timer_start(stress_timer, APP_TIMER_TICKS(LINK_CONN_INTERVAL_MS), NULL);
   APP_ERROR_CHECK(err_code);
+#endif
 
   // Start scanning
-  printf("Starting scanning\n");
+  printf("Starting scanning, %u links at %u ms\n", LINK_COUNT, LINK_CONN_INTERVAL_MS);
   scan_start();
 
-  // go into low power mode
+  // go into low power mode, printing what the handlers logged on the way
   while(1) {
+    deferred_log_process();
     power_manage();
   }
 }
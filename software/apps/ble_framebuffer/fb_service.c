@@ -0,0 +1,205 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "nrf.h"
+#include "nrf_sdh_ble.h"
+#include "simple_ble.h"
+
+#include "fb_service.h"
+#include "pwm_driver.h"
+
+#define FB_OBSERVER_PRIO 3
+#define STATS_INTERVAL_MS 1000
+
+static simple_ble_service_t fb_service = {{
+  .uuid128 = {0x3D,0x5B,0x7A,0x2E,0x9C,0x41,0x4F,0x86,
+              0xA1,0x27,0x5E,0x19,0x00,0xFB,0xB2,0x61}
+}};
+
+static simple_ble_char_t frame_char = {.uuid16 = 0xFB01};
+static simple_ble_char_t stats_char = {.uuid16 = 0xFB02};
+
+// Values the SoftDevice reads and writes in place
+static uint8_t frame_value[FB_CHUNK_MAX_LENGTH];
+static fb_service_stats_t stats_value;
+
+// Filled from the SoftDevice event handler, drained by the main loop
+typedef struct {
+  uint8_t length;
+  uint8_t data[FB_CHUNK_MAX_LENGTH];
+} fb_chunk_t;
+
+static fb_chunk_t ring[FB_RING_SLOTS];
+static volatile uint32_t ring_head = 0;
+static volatile uint32_t ring_tail = 0;
+
+// Totals since boot
+static volatile uint32_t bytes = 0;
+static volatile uint32_t chunks = 0;
+static volatile uint32_t dropped = 0;
+static uint32_t frames = 0;
+static uint32_t skipped = 0;
+
+static bool shown_any = false;
+static uint8_t last_frame;
+
+APP_TIMER_DEF(stats_timer);
+
+static void queue_chunk(uint8_t const* data, uint16_t length) {
+  if (ring_head - ring_tail == FB_RING_SLOTS) {
+    dropped++;
+    return;
+  }
+
+  fb_chunk_t* chunk = &ring[ring_head % FB_RING_SLOTS];
+  memcpy(chunk->data, data, length);
+  chunk->length = length;
+  // the chunk has to be complete before the main loop can see it
+  __DMB();
+  ring_head++;
+
+  bytes += length;
+  chunks++;
+}
+
+static void ble_evt_handler(ble_evt_t const* p_ble_evt, void* p_context) {
+  switch (p_ble_evt->header.evt_id) {
+    case BLE_GAP_EVT_CONNECTED: {
+      // 2M halves the air time of every chunk. MTU and data length are
+      // negotiated by nrf_ble_gatt from the board configuration
+      ble_gap_phys_t const phys = {
+        .tx_phys = BLE_GAP_PHY_2MBPS,
+        .rx_phys = BLE_GAP_PHY_2MBPS,
+      };
+      ret_code_t err_code = sd_ble_gap_phy_update(p_ble_evt->evt.gap_evt.conn_handle, &phys);
+      if (err_code != NRF_ERROR_BUSY) {
+        APP_ERROR_CHECK(err_code);
+      }
+      break;
+    }
+
+    case BLE_GAP_EVT_PHY_UPDATE:
+      printf("PHY: tx %u, rx %u\n", p_ble_evt->evt.gap_evt.params.phy_update.tx_phy,
+          p_ble_evt->evt.gap_evt.params.phy_update.rx_phy);
+      break;
+
+    case BLE_GAP_EVT_DATA_LENGTH_UPDATE:
+      printf("Data length: tx %u, rx %u bytes\n",
+          p_ble_evt->evt.gap_evt.params.data_length_update.effective_params.max_tx_octets,
+          p_ble_evt->evt.gap_evt.params.data_length_update.effective_params.max_rx_octets);
+      break;
+
+    case BLE_GATTS_EVT_WRITE: {
+      ble_gatts_evt_write_t const* write = &p_ble_evt->evt.gatts_evt.params.write;
+      if (write->handle == frame_char.char_handle.value_handle) {
+        queue_chunk(write->data, write->len);
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+NRF_SDH_BLE_OBSERVER(fb_observer, FB_OBSERVER_PRIO, ble_evt_handler, NULL);
+
+static void update_stats(void* context) {
+  static uint32_t last_bytes = 0;
+  static uint32_t last_chunks = 0;
+  static uint32_t last_frames = 0;
+
+  uint32_t now_bytes = bytes;
+  uint32_t now_chunks = chunks;
+  uint32_t now_frames = frames;
+
+  stats_value.bytes_per_s = now_bytes - last_bytes;
+  stats_value.chunks_per_s = now_chunks - last_chunks;
+  stats_value.frames_per_s = now_frames - last_frames;
+  stats_value.dropped = dropped;
+  stats_value.skipped = skipped;
+
+  last_bytes = now_bytes;
+  last_chunks = now_chunks;
+  last_frames = now_frames;
+
+  // fails harmlessly while nobody is subscribed
+  simple_ble_notify_char(&stats_char);
+}
+
+void fb_service_init(void) {
+  simple_ble_add_service(&fb_service);
+
+  // write without response, variable length
+  simple_ble_add_characteristic(0, 1, 0, 1,
+      sizeof(frame_value), frame_value,
+      &fb_service, &frame_char);
+  simple_ble_add_characteristic(1, 0, 1, 0,
+      sizeof(stats_value), (uint8_t*)&stats_value,
+      &fb_service, &stats_char);
+
+  // Lets a connection event run on while there is data, instead of ending
+  // after a few packets
+  ble_opt_t opt = {0};
+  opt.common_opt.conn_evt_ext.enable = 1;
+  ret_code_t err_code = sd_ble_opt_set(BLE_COMMON_OPT_CONN_EVT_EXT, &opt);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = app_timer_create(&stats_timer, APP_TIMER_MODE_REPEATED, update_stats);
+  APP_ERROR_CHECK(err_code);
+  err_code = app_timer_start(stats_timer, APP_TIMER_TICKS(STATS_INTERVAL_MS), NULL);
+  APP_ERROR_CHECK(err_code);
+}
+
+// Copies a chunk's pixels into the back buffer
+static bool apply_chunk(fb_chunk_t const* chunk) {
+  if (chunk->length < FB_CHUNK_HEADER_LENGTH) {
+    return false;
+  }
+
+  uint8_t frame = chunk->data[0];
+  uint8_t flags = chunk->data[1];
+  uint32_t offset = chunk->data[2] | (chunk->data[3] << 8);
+  uint8_t const* pixels = &chunk->data[FB_CHUNK_HEADER_LENGTH];
+  uint32_t count = (chunk->length - FB_CHUNK_HEADER_LENGTH) / 3;
+
+  for (uint32_t i = 0; i < count && offset + i < LED_COUNT; i++) {
+    color_t color = {
+      .red = pixels[3 * i],
+      .green = pixels[3 * i + 1],
+      .blue = pixels[3 * i + 2],
+    };
+    set_pixel(offset + i, color);
+  }
+
+  if (!(flags & FB_CHUNK_FLAG_SHOW)) {
+    return false;
+  }
+
+  if (shown_any && frame != last_frame) {
+    skipped += (uint8_t)(frame - last_frame - 1);
+  }
+  shown_any = true;
+  last_frame = frame;
+
+  render_frame();
+  frames++;
+  return true;
+}
+
+bool fb_service_process(void) {
+  bool shown = false;
+  while (ring_tail != ring_head) {
+    shown |= apply_chunk(&ring[ring_tail % FB_RING_SLOTS]);
+    ring_tail++;
+  }
+  return shown;
+}
+
+fb_service_stats_t fb_service_stats(void) {
+  return stats_value;
+}
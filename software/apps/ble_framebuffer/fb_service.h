@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ble.h"
+
+// Framebuffer GATT service
+//
+// A client streams frames to the strip by writing chunks without response to
+// the frame characteristic. Each chunk is a header followed by pixels:
+//
+//   frame   (1)  frame number, wraps
+//   flags   (1)  FB_CHUNK_FLAG_SHOW on the last chunk of a frame
+//   offset  (2)  index of the first pixel in the chunk, little endian
+//   pixels  (3n) red, green, blue
+//
+// Chunks are queued from the SoftDevice event handler into a ring buffer and
+// copied into the strip driver's back buffer by fb_service_process() from the
+// main loop, which renders the strip whenever a chunk with the show flag
+// is applied.
+//
+// The stats characteristic is read and notified once a second with
+// fb_service_stats_t.
+
+// Largest ATT payload with the 247 byte MTU
+#define FB_CHUNK_MAX_LENGTH 244
+#define FB_CHUNK_HEADER_LENGTH 4
+#define FB_CHUNK_MAX_PIXELS ((FB_CHUNK_MAX_LENGTH - FB_CHUNK_HEADER_LENGTH) / 3)
+#define FB_CHUNK_FLAG_SHOW (1 << 0)
+
+// Chunks waiting for the main loop, a power of two
+#define FB_RING_SLOTS 16
+
+typedef struct {
+  uint32_t bytes_per_s;   // chunk bytes received
+  uint16_t chunks_per_s;
+  uint16_t frames_per_s;  // frames shown
+  uint32_t dropped;       // chunks lost to a full ring since boot
+  uint32_t skipped;       // frame numbers never shown since boot
+} fb_service_stats_t;
+
+void fb_service_init(void);
+
+// Applies queued chunks, returns true if a frame was shown
+bool fb_service_process(void);
+
+fb_service_stats_t fb_service_stats(void);
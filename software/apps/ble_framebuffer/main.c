@@ -0,0 +1,70 @@
+// BLE Framebuffer app
+//
+// Streams frames to the LED strip over a GATT service, see fb_service.h
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_timer.h"
+#include "simple_ble.h"
+
+#include "nrf52840dk.h"
+
+#include "fb_service.h"
+#include "profile.h"
+#include "pwm_driver.h"
+
+// Short intervals so a frame of chunks goes out within a few events
+static simple_ble_config_t ble_config = {
+  // c0:98:e5:4e:xx:xx
+  .platform_id       = 0x4E,    // used as 4th octect in device BLE address
+  .device_id         = 0xAABB,
+  .adv_name          = "CS397/497", // used in advertisements if there is room
+  .adv_interval      = MSEC_TO_UNITS(100, UNIT_0_625_MS),
+  .min_conn_interval = MSEC_TO_UNITS(7.5, UNIT_1_25_MS),
+  .max_conn_interval = MSEC_TO_UNITS(15, UNIT_1_25_MS),
+};
+
+/*******************************************************************************
+ *   State for this application
+ ******************************************************************************/
+// Main application state
+simple_ble_app_t* simple_ble_app;
+
+APP_TIMER_DEF(print_timer);
+
+static void print_stats(void* context) {
+  fb_service_stats_t stats = fb_service_stats();
+  printf("%u fps, %u chunks/s, %lu B/s | %lu chunks dropped, %lu frames skipped\n",
+      stats.frames_per_s, stats.chunks_per_s, stats.bytes_per_s, stats.dropped, stats.skipped);
+}
+
+int main(void) {
+
+  printf("Board started. Initializing BLE: \n");
+  profile_init();
+
+  // Strip starts dark
+  pwm_init();
+  display_color((color_t){.val = 0});
+
+  // Setup BLE
+  simple_ble_app = simple_ble_init(&ble_config);
+
+  app_timer_init();
+  fb_service_init();
+
+  app_timer_create(&print_timer, APP_TIMER_MODE_REPEATED, print_stats);
+  app_timer_start(print_timer, APP_TIMER_TICKS(1000), NULL);
+
+  // Start Advertising
+  simple_ble_adv_only_name();
+
+  // Chunks are applied between sleeps
+  while(1) {
+    fb_service_process();
+    profile_poll();
+    power_manage();
+  }
+}
@@ -4,54 +4,88 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include "nrf.h"
-#include "nrf_delay.h"
+#include "nrf_drv_clock.h"
 #include "nrf_gpio.h"
+#include "nrfx_gpiote.h"
+#include "app_error.h"
+#include "app_timer.h"
+
+#include "input_router.h"
 
 // Pin definitions
 #include "nrf52840dk.h"
 
-int main(void) {
+// Sleep statistics
+APP_TIMER_DEF(report_timer);
+#define REPORT_INTERVAL_MS 5000
+static volatile uint32_t asleep_ticks = 0;
+static volatile bool report_due = false;
 
-  // Initialize.
-  nrf_gpio_cfg_output(LED1);
-  nrf_gpio_cfg_output(LED2);
-  nrf_gpio_cfg_output(LED3);
-  nrf_gpio_cfg_output(LED4);
-  nrf_gpio_pin_set(LED1);
-  nrf_gpio_pin_set(LED2);
-  nrf_gpio_pin_set(LED3);
-  nrf_gpio_pin_set(LED4);
-  nrf_gpio_cfg_input(BUTTON1, NRF_GPIO_PIN_PULLUP);
-  nrf_gpio_cfg_input(BUTTON2, NRF_GPIO_PIN_PULLUP);
-  nrf_gpio_cfg_input(BUTTON3, NRF_GPIO_PIN_PULLUP);
-  nrf_gpio_cfg_input(BUTTON4, NRF_GPIO_PIN_PULLUP);
+static const uint32_t buttons[] = {BUTTON1, BUTTON2, BUTTON3, BUTTON4};
+static const uint32_t leds[] = {LED1, LED2, LED3, LED4};
+#define BUTTON_COUNT (sizeof(buttons) / sizeof(buttons[0]))
 
-  // Enter main loop.
-  while (1) {
-    if (nrf_gpio_pin_read(BUTTON1)) {
-      nrf_gpio_pin_set(LED1);
-    } else {
-      nrf_gpio_pin_clear(LED1);
+// Each LED follows its button's level. Reading the level on every edge,
+// rather than toggling, can't drift out of step when a bounce is missed:
+// the last edge always leaves the LED matching the button
+static void mirror_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    if (buttons[i] == pin) {
+      nrf_gpio_pin_write(leds[i], nrf_gpio_pin_read(pin));
     }
+  }
+}
 
-    if (nrf_gpio_pin_read(BUTTON2)) {
-      nrf_gpio_pin_set(LED2);
-    } else {
-      nrf_gpio_pin_clear(LED2);
-    }
+// Runs in the app_timer interrupt, the report is printed from the main loop
+static void report_callback(void* context) {
+  report_due = true;
+}
 
-    if (nrf_gpio_pin_read(BUTTON3)) {
-      nrf_gpio_pin_set(LED3);
-    } else {
-      nrf_gpio_pin_clear(LED3);
-    }
+// Reports the share of time spent asleep
+static void report(void) {
+  uint32_t asleep_ms = (uint64_t)asleep_ticks * 1000 / APP_TIMER_CLOCK_FREQ;
+  asleep_ticks = 0;
+  printf("asleep %lu of %d ms\n", asleep_ms, REPORT_INTERVAL_MS);
+}
 
-    if (nrf_gpio_pin_read(BUTTON4)) {
-      nrf_gpio_pin_set(LED4);
-    } else {
-      nrf_gpio_pin_clear(LED4);
+// Sleep until an event, counting how long the CPU was stopped
+static void power_manage(void) {
+  uint32_t start = app_timer_cnt_get();
+  __WFE();
+  // clear the event register set by the wakeup so the next WFE sleeps
+  __SEV();
+  __WFE();
+  asleep_ticks += app_timer_cnt_diff_compute(app_timer_cnt_get(), start);
+}
+
+int main(void) {
+
+  // Start the low-frequency clock for app_timer
+  ret_code_t err_code = nrf_drv_clock_init();
+  APP_ERROR_CHECK(err_code);
+  nrf_drv_clock_lfclk_request(NULL);
+  app_timer_init();
+
+  // Each LED mirrors its button. Both are active low, so the LED takes the
+  // button's level, on every edge through a GPIOTE PORT event
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+    nrf_gpio_cfg_output(leds[i]);
+    err_code = input_route_handler(buttons[i], NRF_GPIOTE_POLARITY_TOGGLE, NRF_GPIO_PIN_PULLUP, mirror_handler);
+    APP_ERROR_CHECK(err_code);
+    nrf_gpio_pin_write(leds[i], nrf_gpio_pin_read(buttons[i]));
+  }
+
+  app_timer_create(&report_timer, APP_TIMER_MODE_REPEATED, report_callback);
+  app_timer_start(report_timer, APP_TIMER_TICKS(REPORT_INTERVAL_MS), NULL);
+
+  // Enter main loop.
+  while (1) {
+    if (report_due) {
+      report_due = false;
+      report();
     }
+    power_manage();
   }
 }
-
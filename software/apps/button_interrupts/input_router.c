@@ -0,0 +1,166 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_error.h"
+#include "nrf_gpio.h"
+#include "nrfx_gpiote.h"
+#include "nrfx_ppi.h"
+
+#include "input_router.h"
+
+typedef struct input_route {
+  uint32_t in_pin;
+  uint32_t out_pin; // unused for handler routes
+  nrf_gpiote_polarity_t sense;
+  nrf_gpiote_polarity_t action;
+  bool in_hardware;
+} input_route_t;
+
+static input_route_t routes[INPUT_ROUTE_MAX];
+static uint8_t route_count = 0;
+
+static ret_code_t ensure_gpiote_init(void) {
+  if (nrfx_gpiote_is_init()) {
+    return NRFX_SUCCESS;
+  }
+  return nrfx_gpiote_init();
+}
+
+static input_route_t *find_route(uint32_t in_pin) {
+  for (uint8_t i = 0; i < route_count; i++) {
+    if (routes[i].in_pin == in_pin) {
+      return &routes[i];
+    }
+  }
+  return NULL;
+}
+
+// Software version of a pass-through route, used when it could not be wired in hardware
+static void passthrough_fallback_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t polarity) {
+  input_route_t const *route = find_route(pin);
+  if (route == NULL) {
+    return;
+  }
+
+  switch (route->action) {
+    case NRF_GPIOTE_POLARITY_LOTOHI:
+      nrf_gpio_pin_set(route->out_pin);
+      break;
+    case NRF_GPIOTE_POLARITY_HITOLO:
+      nrf_gpio_pin_clear(route->out_pin);
+      break;
+    case NRF_GPIOTE_POLARITY_TOGGLE:
+      nrf_gpio_pin_toggle(route->out_pin);
+      break;
+  }
+}
+
+static ret_code_t route_in_hardware(input_route_t *route, nrf_gpio_pin_pull_t pull, bool out_initial_high) {
+  ret_code_t err_code;
+  nrf_ppi_channel_t channel;
+
+  err_code = nrfx_ppi_channel_alloc(&channel);
+  if (err_code != NRFX_SUCCESS) {
+    return err_code;
+  }
+
+  // hi_accuracy: the input needs its own GPIOTE channel to produce an IN event
+  nrfx_gpiote_in_config_t in_config = NRFX_GPIOTE_CONFIG_IN_SENSE_TOGGLE(true);
+  in_config.sense = route->sense;
+  in_config.pull = pull;
+  err_code = nrfx_gpiote_in_init(route->in_pin, &in_config, NULL);
+  if (err_code != NRFX_SUCCESS) {
+    nrfx_ppi_channel_free(channel);
+    return err_code;
+  }
+
+  nrfx_gpiote_out_config_t out_config = NRFX_GPIOTE_CONFIG_OUT_TASK_TOGGLE(out_initial_high);
+  out_config.action = route->action;
+  err_code = nrfx_gpiote_out_init(route->out_pin, &out_config);
+  if (err_code != NRFX_SUCCESS) {
+    nrfx_gpiote_in_uninit(route->in_pin);
+    nrfx_ppi_channel_free(channel);
+    return err_code;
+  }
+
+  err_code = nrfx_ppi_channel_assign(channel,
+                                     nrfx_gpiote_in_event_addr_get(route->in_pin),
+                                     nrfx_gpiote_out_task_addr_get(route->out_pin));
+  APP_ERROR_CHECK(err_code);
+  err_code = nrfx_ppi_channel_enable(channel);
+  APP_ERROR_CHECK(err_code);
+
+  nrfx_gpiote_out_task_enable(route->out_pin);
+  // event only feeds PPI, no interrupt
+  nrfx_gpiote_in_event_enable(route->in_pin, false);
+  return NRFX_SUCCESS;
+}
+
+static ret_code_t route_to_handler(uint32_t in_pin, nrf_gpiote_polarity_t sense, nrf_gpio_pin_pull_t pull,
+                                   nrfx_gpiote_evt_handler_t handler) {
+  // PORT event, leaves the GPIOTE channels for hardware routes
+  nrfx_gpiote_in_config_t in_config = NRFX_GPIOTE_CONFIG_IN_SENSE_TOGGLE(false);
+  in_config.sense = sense;
+  in_config.pull = pull;
+  ret_code_t err_code = nrfx_gpiote_in_init(in_pin, &in_config, handler);
+  if (err_code != NRFX_SUCCESS) {
+    return err_code;
+  }
+
+  nrfx_gpiote_in_event_enable(in_pin, true);
+  return NRFX_SUCCESS;
+}
+
+ret_code_t input_route_passthrough(uint32_t in_pin, nrf_gpiote_polarity_t sense, nrf_gpio_pin_pull_t pull,
+                                   uint32_t out_pin, nrf_gpiote_polarity_t action, bool out_initial_high) {
+  ret_code_t err_code = ensure_gpiote_init();
+  if (err_code != NRFX_SUCCESS) {
+    return err_code;
+  }
+  if (route_count == INPUT_ROUTE_MAX) {
+    return NRFX_ERROR_NO_MEM;
+  }
+
+  input_route_t *route = &routes[route_count];
+  route->in_pin = in_pin;
+  route->out_pin = out_pin;
+  route->sense = sense;
+  route->action = action;
+
+  route->in_hardware = route_in_hardware(route, pull, out_initial_high) == NRFX_SUCCESS;
+  if (!route->in_hardware) {
+    nrf_gpio_cfg(out_pin, NRF_GPIO_PIN_DIR_OUTPUT, NRF_GPIO_PIN_INPUT_CONNECT, NRF_GPIO_PIN_NOPULL,
+                 NRF_GPIO_PIN_S0S1, NRF_GPIO_PIN_NOSENSE);
+    if (out_initial_high) {
+      nrf_gpio_pin_set(out_pin);
+    } else {
+      nrf_gpio_pin_clear(out_pin);
+    }
+
+    err_code = route_to_handler(in_pin, sense, pull, passthrough_fallback_handler);
+    if (err_code != NRFX_SUCCESS) {
+      return err_code;
+    }
+  }
+
+  route_count++;
+  return NRFX_SUCCESS;
+}
+
+ret_code_t input_route_handler(uint32_t in_pin, nrf_gpiote_polarity_t sense, nrf_gpio_pin_pull_t pull,
+                               nrfx_gpiote_evt_handler_t handler) {
+  ret_code_t err_code = ensure_gpiote_init();
+  if (err_code != NRFX_SUCCESS) {
+    return err_code;
+  }
+
+  return route_to_handler(in_pin, sense, pull, handler);
+}
+
+uint8_t input_route_hardware_count(void) {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < route_count; i++) {
+    count += routes[i].in_hardware;
+  }
+  return count;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrfx_gpiote.h"
+
+// Input routing
+//
+// Connects button pins to outputs or handlers. Pure pass-through routes are
+// wired in hardware: the GPIOTE IN event of the input triggers the GPIOTE OUT
+// task of the output through a PPI channel, so no code runs on an edge.
+// Routes that need logic get an interrupt handler instead. If the GPIOTE or
+// PPI channels run out, pass-through routes fall back to a handler that does
+// the same thing in software.
+
+#define INPUT_ROUTE_MAX 8
+
+// Route edges on in_pin to `action` on out_pin with no CPU involvement.
+// out_pin starts high if out_initial_high is set
+ret_code_t input_route_passthrough(uint32_t in_pin, nrf_gpiote_polarity_t sense, nrf_gpio_pin_pull_t pull,
+                                   uint32_t out_pin, nrf_gpiote_polarity_t action, bool out_initial_high);
+
+// Route edges on in_pin to an interrupt handler
+ret_code_t input_route_handler(uint32_t in_pin, nrf_gpiote_polarity_t sense, nrf_gpio_pin_pull_t pull,
+                               nrfx_gpiote_evt_handler_t handler);
+
+// Number of routes running in hardware
+uint8_t input_route_hardware_count(void);
+
@@ -4,72 +4,100 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include "nrf.h"
-#include "nrf_delay.h"
+#include "nrf_drv_clock.h"
 #include "nrf_gpio.h"
 #include "nrfx_gpiote.h"
+#include "app_error.h"
+#include "app_timer.h"
+
+#include "input_router.h"
 
 // Pin definitions
 #include "nrf52840dk.h"
 
+// Sleep statistics
+APP_TIMER_DEF(report_timer);
+#define REPORT_INTERVAL_MS 5000
+static volatile uint32_t asleep_ticks = 0;
+static volatile bool report_due = false;
+
+static volatile uint32_t button4_presses = 0;
+
+// Routes that need logic still get an interrupt
 void button_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action) {
   switch(pin) {
-    case BUTTON1: {
-      nrf_gpio_pin_toggle(LED1);
-      break;
-    }
-    case BUTTON2: {
-      nrf_gpio_pin_toggle(LED2);
-      break;
-    }
-    case BUTTON3: {
-      nrf_gpio_pin_toggle(LED3);
-      break;
-    }
     case BUTTON4: {
       nrf_gpio_pin_toggle(LED4);
+      button4_presses++;
       break;
     }
   }
 }
 
-static void gpio_in_with_interrupt(nrfx_gpiote_pin_t pin, nrf_gpio_pin_pull_t pull, nrfx_gpiote_evt_handler_t handler) {
-  // Configure I/O pin
-  // HITOLO: Sense high-to-low transition
-  // Alternatives: LOTOHI or TOGGLE (for either)
-  nrfx_gpiote_in_config_t in_config = NRFX_GPIOTE_CONFIG_IN_SENSE_HITOLO(true);
-  in_config.pull = pull;
-  ret_code_t err_code = nrfx_gpiote_in_init(pin, &in_config, handler);
-  APP_ERROR_CHECK(err_code);
+// Runs in the app_timer interrupt, the report is printed from the main loop
+static void report_callback(void* context) {
+  report_due = true;
+}
+
+// Reports the share of time spent asleep
+static void report(void) {
+  uint32_t asleep_ms = (uint64_t)asleep_ticks * 1000 / APP_TIMER_CLOCK_FREQ;
+  asleep_ticks = 0;
+  printf("asleep %lu of %d ms (%u routes in hardware, button 4 pressed %lu times)\n",
+      asleep_ms, REPORT_INTERVAL_MS, input_route_hardware_count(), button4_presses);
+}
 
-  // Enable the interrupts
-  nrfx_gpiote_in_event_enable(pin, true);
+// Sleep until an event, counting how long the CPU was stopped
+static void power_manage(void) {
+  uint32_t start = app_timer_cnt_get();
+  __WFE();
+  // clear the event register set by the wakeup so the next WFE sleeps
+  __SEV();
+  __WFE();
+  asleep_ticks += app_timer_cnt_diff_compute(app_timer_cnt_get(), start);
 }
 
 int main(void) {
 
   // Initialize LEDs
-  nrf_gpio_cfg_output(LED1);
-  nrf_gpio_cfg_output(LED2);
-  nrf_gpio_cfg_output(LED3);
   nrf_gpio_cfg_output(LED4);
-  nrf_gpio_pin_set(LED1);
-  nrf_gpio_pin_set(LED2);
-  nrf_gpio_pin_set(LED3);
   nrf_gpio_pin_set(LED4);
 
-  // Initialize GPIO task/event (interrupts)
-  ret_code_t err_code = nrfx_gpiote_init();
+  // Start the low-frequency clock for app_timer
+  ret_code_t err_code = nrf_drv_clock_init();
+  APP_ERROR_CHECK(err_code);
+  nrf_drv_clock_lfclk_request(NULL);
+  app_timer_init();
+
+  // Presses on buttons 1-3 toggle their LED through PPI with no interrupt
+  // HITOLO: Sense high-to-low transition
+  // Alternatives: LOTOHI or TOGGLE (for either)
+  err_code = input_route_passthrough(BUTTON1, NRF_GPIOTE_POLARITY_HITOLO, NRF_GPIO_PIN_PULLUP,
+      LED1, NRF_GPIOTE_POLARITY_TOGGLE, true);
+  APP_ERROR_CHECK(err_code);
+  err_code = input_route_passthrough(BUTTON2, NRF_GPIOTE_POLARITY_HITOLO, NRF_GPIO_PIN_PULLUP,
+      LED2, NRF_GPIOTE_POLARITY_TOGGLE, true);
+  APP_ERROR_CHECK(err_code);
+  err_code = input_route_passthrough(BUTTON3, NRF_GPIOTE_POLARITY_HITOLO, NRF_GPIO_PIN_PULLUP,
+      LED3, NRF_GPIOTE_POLARITY_TOGGLE, true);
+  APP_ERROR_CHECK(err_code);
+
+  // Button 4 also counts presses, so it goes through the interrupt handler
+  err_code = input_route_handler(BUTTON4, NRF_GPIOTE_POLARITY_HITOLO, NRF_GPIO_PIN_PULLUP, button_handler);
   APP_ERROR_CHECK(err_code);
 
-  gpio_in_with_interrupt(BUTTON1, NRF_GPIO_PIN_PULLUP, button_handler);
-  gpio_in_with_interrupt(BUTTON2, NRF_GPIO_PIN_PULLUP, button_handler);
-  gpio_in_with_interrupt(BUTTON3, NRF_GPIO_PIN_PULLUP, button_handler);
-  gpio_in_with_interrupt(BUTTON4, NRF_GPIO_PIN_PULLUP, button_handler);
+  app_timer_create(&report_timer, APP_TIMER_MODE_REPEATED, report_callback);
+  app_timer_start(report_timer, APP_TIMER_TICKS(REPORT_INTERVAL_MS), NULL);
 
   // Enter main loop
   while (true) {
-    // do nothing
+    if (report_due) {
+      report_due = false;
+      report();
+    }
+    power_manage();
   }
 }
 
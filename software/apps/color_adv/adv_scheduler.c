@@ -0,0 +1,227 @@
+#include <stdint.h>
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "ble_gap.h"
+#include "nrf_nvic.h"
+#include "nrf_soc.h"
+
+#include "adv_scheduler.h"
+#include "kv_store.h"
+#include "tag_adv.h"
+#include "tag_auth.h"
+#include "timebase.h"
+
+// Upper bound on the air time of one advertising event on all three channels
+#define ADV_EVENT_MAX_MS 3
+
+// A reset within KV_STORE_DELAY_MS of a change loses the newest counters, and
+// scanners reject payloads older than the last they accepted, so a restored
+// counter skips well past anything that could have been signed since
+#define COUNTER_RESTORE_SKIP 256
+
+APP_TIMER_DEF(backoff_timer);
+
+static uint8_t payload[TAG_PAYLOAD_MAX_LENGTH];
+static uint8_t payload_length = 0;
+static uint8_t sequence = 0;
+static ble_gap_addr_t own_addr; // signed along with the payload
+static uint8_t auth_key_slot;
+
+// TAG_PAYLOAD_FLAG_TIME: the time the payload carries, never later than the
+// advert it goes out in
+static bool timed = false;
+static uint32_t stamped_ms;
+
+static uint32_t interval_ms;
+static uint32_t interval_start_ticks;
+static uint32_t bursts = 0;
+
+// Time and estimated adverts (in thousandths) spent at finished intervals, for the average
+static uint64_t elapsed_ms = 0;
+static uint64_t advert_thousandths = 0;
+
+static uint32_t ticks_to_ms(uint32_t ticks)
+{
+  return (uint64_t)ticks * 1000 / APP_TIMER_CLOCK_FREQ;
+}
+
+static void account_interval(void)
+{
+  uint32_t now = app_timer_cnt_get();
+  uint32_t ms = ticks_to_ms(app_timer_cnt_diff_compute(now, interval_start_ticks));
+
+  elapsed_ms += ms;
+  advert_thousandths += (uint64_t)ms * 1000 / interval_ms;
+  interval_start_ticks = now;
+}
+
+static void stamp_time(uint32_t time_ms)
+{
+  stamped_ms = time_ms;
+  tag_payload_stamp_time(payload, stamped_ms);
+
+  // The time is signed along with the rest
+  if (payload[1] & TAG_PAYLOAD_FLAG_AUTH)
+  {
+    tag_auth_sign(auth_key_slot, own_addr.addr, payload, payload_length);
+  }
+}
+
+// Runs at the end of every radio event. On a peer those include scan
+// windows, so the stamp only moves on once the advert it was for has surely
+// gone out
+void RADIO_NOTIFICATION_IRQHandler(void)
+{
+  uint32_t now = timebase_local_ms();
+  if (!timed || (int32_t)(now - stamped_ms) < ADV_RANDOM_DELAY_MS + ADV_EVENT_MAX_MS)
+  {
+    return;
+  }
+
+  // The next event starts an interval after this one started plus a random
+  // delay, so stamp the earliest it can be
+  stamp_time(now + interval_ms - ADV_EVENT_MAX_MS);
+  tag_adv_restamp(payload, payload_length);
+}
+
+static void start_time_stamping(void)
+{
+#if !TAG_ADV_RESTART_ON_UPDATE
+  ret_code_t err_code = sd_nvic_ClearPendingIRQ(RADIO_NOTIFICATION_IRQn);
+  APP_ERROR_CHECK(err_code);
+  err_code = sd_nvic_SetPriority(RADIO_NOTIFICATION_IRQn, APP_IRQ_PRIORITY_LOW);
+  APP_ERROR_CHECK(err_code);
+  err_code = sd_nvic_EnableIRQ(RADIO_NOTIFICATION_IRQn);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = sd_radio_notification_cfg_set(NRF_RADIO_NOTIFICATION_TYPE_INT_ON_INACTIVE,
+                                           NRF_RADIO_NOTIFICATION_DISTANCE_NONE);
+  APP_ERROR_CHECK(err_code);
+#else
+  // restarting on every restamp would advertise back to back, so the time
+  // stays at when the state last changed
+#endif
+}
+
+static void set_interval(uint32_t new_interval_ms)
+{
+  // The radio notification reads the interval and swaps the payload, so it
+  // waits until the advertiser runs again at the new interval
+  CRITICAL_REGION_ENTER();
+  account_interval();
+  interval_ms = new_interval_ms;
+
+  // Restarting sends an advert right away, possibly before the stamp
+  if (timed)
+  {
+    stamp_time(timebase_local_ms());
+    tag_adv_restamp(payload, payload_length);
+  }
+  tag_adv_set_interval(interval_ms);
+  CRITICAL_REGION_EXIT();
+
+  if (interval_ms < ADV_IDLE_INTERVAL_MS)
+  {
+    app_timer_start(backoff_timer, APP_TIMER_TICKS(interval_ms * ADV_ADVERTS_PER_STEP), NULL);
+  }
+}
+
+static void backoff(void *context)
+{
+  uint32_t next_interval_ms = interval_ms * 2;
+  set_interval(next_interval_ms < ADV_IDLE_INTERVAL_MS ? next_interval_ms : ADV_IDLE_INTERVAL_MS);
+}
+
+static uint8_t build_payload(tag_state_t *state)
+{
+  state->sequence = sequence;
+  // the next advert can't go out before now
+  state->time_ms = timebase_local_ms();
+  stamped_ms = state->time_ms;
+
+  if (!(state->flags & TAG_PAYLOAD_FLAG_AUTH))
+  {
+    payload_length = tag_payload_encode(state, payload);
+    return payload_length;
+  }
+
+  // Every signed payload gets a fresh counter so scanners can reject old ones
+  state->counter++;
+  payload_length = tag_payload_encode(state, payload);
+  tag_auth_sign(auth_key_slot, own_addr.addr, payload, payload_length);
+  return payload_length;
+}
+
+static void store_counter(tag_state_t const *state)
+{
+  if (state->flags & TAG_PAYLOAD_FLAG_AUTH)
+  {
+    kv_store_set(KV_KEY_TAG_COUNTER, &state->counter, sizeof(state->counter));
+  }
+}
+
+void adv_scheduler_start(tag_state_t *state, uint8_t key_slot)
+{
+  auth_key_slot = key_slot;
+
+  ret_code_t err_code = app_timer_create(&backoff_timer, APP_TIMER_MODE_SINGLE_SHOT, backoff);
+  APP_ERROR_CHECK(err_code);
+  err_code = sd_ble_gap_addr_get(&own_addr);
+  APP_ERROR_CHECK(err_code);
+
+  uint32_t counter;
+  if (kv_store_get(KV_KEY_TAG_COUNTER, &counter, sizeof(counter)))
+  {
+    state->counter = counter + COUNTER_RESTORE_SKIP;
+  }
+
+  timed = state->flags & TAG_PAYLOAD_FLAG_TIME;
+  if (timed)
+  {
+    start_time_stamping();
+  }
+
+  // Boot counts as a state change
+  bursts++;
+  interval_ms = ADV_BURST_INTERVAL_MS;
+  interval_start_ticks = app_timer_cnt_get();
+  tag_adv_start(payload, build_payload(state), interval_ms);
+  store_counter(state);
+  app_timer_start(backoff_timer, APP_TIMER_TICKS(interval_ms * ADV_ADVERTS_PER_STEP), NULL);
+}
+
+void adv_scheduler_notify_change(tag_state_t *state)
+{
+  // The radio notification restamps the same payload
+  CRITICAL_REGION_ENTER();
+  sequence++;
+  tag_adv_update(payload, build_payload(state));
+  CRITICAL_REGION_EXIT();
+  store_counter(state);
+
+  // Already bursting: the new payload goes out on the next event anyway,
+  // just extend the burst
+  app_timer_stop(backoff_timer);
+  if (interval_ms == ADV_BURST_INTERVAL_MS)
+  {
+    app_timer_start(backoff_timer, APP_TIMER_TICKS(interval_ms * ADV_ADVERTS_PER_STEP), NULL);
+    return;
+  }
+
+  bursts++;
+  set_interval(ADV_BURST_INTERVAL_MS);
+}
+
+adv_scheduler_stats_t adv_scheduler_stats(void)
+{
+  account_interval();
+
+  adv_scheduler_stats_t stats = {
+      .bursts = bursts,
+      .adverts = advert_thousandths / 1000,
+      .average_interval_ms = advert_thousandths ? elapsed_ms * 1000 / advert_thousandths : interval_ms,
+  };
+  return stats;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "tag_payload.h"
+
+// Adaptive advertising interval
+//
+// Advertises quickly right after the tag's state changes, so scanners hear
+// the change within a few tens of ms, then backs off step by step to a long
+// idle interval while nothing changes. Every state change also bumps the
+// payload's sequence number, which lets scanners drop repeated adverts of the
+// same state without decoding them.
+//
+// States with TAG_PAYLOAD_FLAG_AUTH are signed with the tag_auth key slot
+// passed to adv_scheduler_start(). Their counter is kept in flash, so
+// scanners that heard the tag before a reset still take its adverts. States
+// with TAG_PAYLOAD_FLAG_TIME carry timebase_local_ms(), restamped and signed
+// again after every radio event through the SoftDevice's radio notification,
+// for scanners to estimate this tag's clock.
+
+#define ADV_BURST_INTERVAL_MS 30
+// ADV_IDLE_INTERVAL_MS is in tag_payload.h, scanners size their cache by it
+// Adverts sent at each interval before doubling it
+#define ADV_ADVERTS_PER_STEP 8
+
+typedef struct
+{
+  uint32_t bursts;
+  uint32_t adverts;             // estimated from the time spent at each interval
+  uint32_t average_interval_ms; // over all adverts sent since start
+} adv_scheduler_stats_t;
+
+// Starts advertising `state`, signing it with key_slot if it has
+// TAG_PAYLOAD_FLAG_AUTH. app_timer_init(), timebase_init() and
+// kv_store_init() must be called first
+void adv_scheduler_start(tag_state_t *state, uint8_t key_slot);
+
+// Advertises a new state and starts a burst. Sets state->sequence,
+// and advances state->counter for signed states
+void adv_scheduler_notify_change(tag_state_t *state);
+
+adv_scheduler_stats_t adv_scheduler_stats(void);
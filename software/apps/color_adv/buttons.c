@@ -0,0 +1,146 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "nrf_gpio.h"
+#include "nrfx_gpiote.h"
+
+#include "buttons.h"
+
+#define DEBOUNCE_TICKS (BUTTON_DEBOUNCE_MS / BUTTON_SCAN_MS)
+#define LONG_PRESS_TICKS (BUTTON_LONG_PRESS_MS / BUTTON_SCAN_MS)
+#define REPEAT_TICKS (BUTTON_REPEAT_MS / BUTTON_SCAN_MS)
+
+APP_TIMER_DEF(button_scan_timer);
+
+typedef struct button_state
+{
+  uint32_t pin;
+  bool pressed;        // debounced state
+  uint8_t unstable;    // scans the raw level has disagreed with the debounced state
+  uint32_t held_ticks; // scans since the debounced press, wraps after 497 days at 10 ms
+} button_state_t;
+
+static button_state_t buttons[BUTTON_COUNT];
+static volatile bool scan_running = false;
+
+// Single producer (timer) / single consumer (main loop) queue
+static button_event_t queue[BUTTON_QUEUE_LENGTH];
+static volatile uint32_t queue_head = 0;
+static volatile uint32_t queue_tail = 0;
+
+static void queue_push(uint8_t button, button_event_type_t type)
+{
+  if (queue_head - queue_tail == BUTTON_QUEUE_LENGTH)
+  {
+    // full, drop the newest event
+    return;
+  }
+
+  queue[queue_head % BUTTON_QUEUE_LENGTH] = (button_event_t){.button = button, .type = type};
+  queue_head++;
+}
+
+bool button_event_get(button_event_t *event)
+{
+  if (queue_tail == queue_head)
+  {
+    return false;
+  }
+
+  *event = queue[queue_tail % BUTTON_QUEUE_LENGTH];
+  queue_tail++;
+  return true;
+}
+
+static void scan_buttons(void *context)
+{
+  bool active = false;
+
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++)
+  {
+    button_state_t *state = &buttons[i];
+    bool level_pressed = !nrf_gpio_pin_read(state->pin);
+
+    if (level_pressed != state->pressed)
+    {
+      state->unstable++;
+      if (state->unstable >= DEBOUNCE_TICKS)
+      {
+        state->pressed = level_pressed;
+        state->unstable = 0;
+        state->held_ticks = 0;
+        queue_push(i, level_pressed ? BUTTON_PRESSED : BUTTON_RELEASED);
+      }
+    }
+    else
+    {
+      state->unstable = 0;
+    }
+
+    if (state->pressed)
+    {
+      state->held_ticks++;
+      if (state->held_ticks == LONG_PRESS_TICKS)
+      {
+        queue_push(i, BUTTON_LONG_PRESSED);
+      }
+      else if (state->held_ticks > LONG_PRESS_TICKS && (state->held_ticks - LONG_PRESS_TICKS) % REPEAT_TICKS == 0)
+      {
+        queue_push(i, BUTTON_REPEAT);
+      }
+    }
+
+    active |= state->pressed || state->unstable;
+  }
+
+  // The edge handler runs at a different priority: stopping and clearing
+  // the flag together means an edge can't land between them and be lost
+  if (!active)
+  {
+    CRITICAL_REGION_ENTER();
+    app_timer_stop(button_scan_timer);
+    scan_running = false;
+    CRITICAL_REGION_EXIT();
+  }
+}
+
+static void button_edge_handler(nrfx_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
+{
+  CRITICAL_REGION_ENTER();
+  if (!scan_running)
+  {
+    scan_running = true;
+    app_timer_start(button_scan_timer, APP_TIMER_TICKS(BUTTON_SCAN_MS), NULL);
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+void buttons_init(uint32_t const *pins)
+{
+  ret_code_t err_code;
+
+  if (!nrfx_gpiote_is_init())
+  {
+    err_code = nrfx_gpiote_init();
+    APP_ERROR_CHECK(err_code);
+  }
+
+  err_code = app_timer_create(&button_scan_timer, APP_TIMER_MODE_REPEATED, scan_buttons);
+  APP_ERROR_CHECK(err_code);
+
+  for (uint8_t i = 0; i < BUTTON_COUNT; i++)
+  {
+    buttons[i].pin = pins[i];
+
+    // false: low-power PORT event instead of a dedicated GPIOTE channel
+    nrfx_gpiote_in_config_t in_config = NRFX_GPIOTE_CONFIG_IN_SENSE_TOGGLE(false);
+    in_config.pull = NRF_GPIO_PIN_PULLUP;
+    err_code = nrfx_gpiote_in_init(pins[i], &in_config, button_edge_handler);
+    APP_ERROR_CHECK(err_code);
+
+    nrfx_gpiote_in_event_enable(pins[i], true);
+  }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Debounced button input
+//
+// Edges on the buttons arrive as GPIOTE PORT events, which only wake a
+// periodic app_timer scan. The scan debounces the buttons and produces
+// events into a small queue, then stops once every button is released, so
+// nothing runs while the buttons are idle.
+
+#define BUTTON_COUNT 3
+
+#define BUTTON_SCAN_MS 10
+#define BUTTON_DEBOUNCE_MS 30
+#define BUTTON_LONG_PRESS_MS 400
+#define BUTTON_REPEAT_MS 100
+
+#define BUTTON_QUEUE_LENGTH 8 // must be a power of two
+
+typedef enum
+{
+  BUTTON_PRESSED,
+  BUTTON_LONG_PRESSED, // held for BUTTON_LONG_PRESS_MS
+  BUTTON_REPEAT,       // every BUTTON_REPEAT_MS after a long press
+  BUTTON_RELEASED,
+} button_event_type_t;
+
+typedef struct
+{
+  uint8_t button; // index into the pins passed to buttons_init()
+  button_event_type_t type;
+} button_event_t;
+
+// Buttons are active low with pull-ups. app_timer_init() must be called first
+void buttons_init(uint32_t const *pins);
+
+// Pops the oldest queued event. Returns false if the queue is empty
+bool button_event_get(button_event_t *event);
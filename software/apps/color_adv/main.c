@@ -6,10 +6,19 @@
 #include <stdint.h>
 #include <stdio.h>
 
-#include "nrf_gpio.h"
 #include "pwm_driver.h"
+#include "buttons.h"
+#include "tag_adv.h"
+#include "tag_payload.h"
+#include "tag_auth.h"
+#include "tag_keys.h"
+#include "adv_scheduler.h"
+#include "timebase.h"
+#include "ambient.h"
+#include "kv_store.h"
+#include "telemetry.h"
+#include "profile.h"
 #include "simple_ble.h"
-#include "nrf_delay.h"
 #include "app_timer.h"
 
 #include "nrf52840dk.h"
@@ -20,7 +29,7 @@ static simple_ble_config_t ble_config = {
     .platform_id = 0x4E,     // used as 4th octect in device BLE address
     .device_id = 0xCCDD,     // must be unique on each device you program!
     .adv_name = "CS397/497", // used in advertisements if there is room
-    .adv_interval = MSEC_TO_UNITS(1000, UNIT_0_625_MS),
+    .adv_interval = MSEC_TO_UNITS(ADV_IDLE_INTERVAL_MS, UNIT_0_625_MS), // see adv_scheduler.h
     .min_conn_interval = MSEC_TO_UNITS(500, UNIT_1_25_MS),
     .max_conn_interval = MSEC_TO_UNITS(1000, UNIT_1_25_MS),
 };
@@ -29,12 +38,29 @@ static simple_ble_config_t ble_config = {
 simple_ble_app_t *simple_ble_app;
 
 APP_TIMER_DEF(blinking_timer);
+APP_TIMER_DEF(transition_timer);
+const uint32_t TRANSITION_MS = 750; // strip stays dark for this long when switching modes
+
+static const uint32_t button_pins[BUTTON_COUNT] = {BUTTON1, BUTTON2, BUTTON3};
 
 static color_t DARKNESS, RED, ORANGE, YELLOW, GREEN, CYAN, BLUE, PURPLE, PINK;
 color_t color_options[8];
 color_t displayed_colors[8];
 int8_t color_index = 0;
 uint8_t is_in_select_mode = 0; // 0 means not in select mode
+bool button3_held = false;
+static volatile bool brightness_changed = false;
+
+// The eight options on the first LEDs, the rest dark
+void display_color_options(color_t *options)
+{
+  TELEMETRY(TELEMETRY_ID_COLOR_OPTIONS, 8, options[0].val);
+  for (uint32_t i = 0; i < LED_COUNT; i++)
+  {
+    set_pixel(i, i < 8 ? options[i] : (color_t){.val = 0});
+  }
+  render_frame();
+}
 
 int8_t increment_color_index(int8_t index)
 {
@@ -46,13 +72,72 @@ int8_t decrement_color_index(int8_t index)
   return index - 1 < 0 ? 7 : index - 1;
 }
 
+// State advertised to scanners
+tag_state_t tag_state = {
+    .flags = TAG_PAYLOAD_FLAG_TX_POWER | TAG_PAYLOAD_FLAG_AUTH | TAG_PAYLOAD_FLAG_TIME,
+    .brightness = 255,
+    .effect = TAG_EFFECT_SOLID,
+    .tx_power = 0, // SoftDevice default
+};
+
+// What the store keeps of the tag, restored at boot. The signing counter is
+// kept by adv_scheduler
+typedef struct
+{
+  int8_t color_index;
+  uint8_t effect;
+  uint8_t reserved[2];
+} stored_tag_state_t;
+
+void store_tag_state()
+{
+  stored_tag_state_t stored = {
+      .color_index = color_index,
+      .effect = tag_state.effect,
+  };
+  kv_store_set(KV_KEY_TAG_STATE, &stored, sizeof(stored));
+}
+
+void restore_tag_state()
+{
+  stored_tag_state_t stored;
+  if (!kv_store_get(KV_KEY_TAG_STATE, &stored, sizeof(stored)) || stored.color_index < 0 ||
+      stored.color_index > 7 || stored.effect > TAG_EFFECT_BREATHE)
+  {
+    return;
+  }
+  color_index = stored.color_index;
+  tag_state.effect = stored.effect;
+}
+
+void set_tag_color(color_t color)
+{
+  tag_state.green = color.green;
+  tag_state.red = color.red;
+  tag_state.blue = color.blue;
+}
+
 void update_color()
 {
-  advertising_stop();
-  uint8_t new_color[3] = {color_options[color_index].green,
-                          color_options[color_index].red,
-                          color_options[color_index].blue};
-  simple_ble_adv_manuf_data(new_color, 3);
+  set_tag_color(color_options[color_index]);
+  adv_scheduler_notify_change(&tag_state);
+  store_tag_state();
+
+  tag_adv_stats_t const *stats = tag_adv_stats();
+  adv_scheduler_stats_t schedule = adv_scheduler_stats();
+  printf("Advertised color %d (%lu updates, %lu restamps, %lu restarts, longest update %lu us)\n",
+         color_index, stats->updates, stats->restamps, stats->restarts, stats->longest_update_us);
+  printf("%lu bursts, average interval %lu ms, %lu interval changes, longest stop %lu us\n", schedule.bursts,
+         schedule.average_interval_ms, stats->interval_changes, stats->longest_interval_change_us);
+}
+
+// Scanners play the effect in step with each other, see timebase.h
+void cycle_effect()
+{
+  tag_state.effect = tag_state.effect == TAG_EFFECT_BREATHE ? TAG_EFFECT_SOLID : tag_state.effect + 1;
+  adv_scheduler_notify_change(&tag_state);
+  store_tag_state();
+  printf("Advertised effect %d\n", tag_state.effect);
 }
 
 void blink_animation()
@@ -121,71 +206,120 @@ void set_color_options()
   color_options[7] = PINK;
 }
 
+// Shows either the options or the selected color once the dark pause between modes ends
+void finish_transition()
+{
+  if (is_in_select_mode)
+  {
+    display_color_options(displayed_colors);
+    app_timer_start(blinking_timer, APP_TIMER_TICKS(750), NULL);
+  }
+  else
+  {
+    display_color(color_options[color_index]);
+  }
+}
+
+// Set from the ambient timer, the frame is redrawn from the main loop
+void ambient_changed()
+{
+  brightness_changed = true;
+}
+
+void toggle_select_mode()
+{
+  app_timer_stop(blinking_timer);
+  app_timer_stop(transition_timer);
+
+  // set selection and leave select mode, or enter it and display color options
+  is_in_select_mode = !is_in_select_mode;
+  reset_displayed_colors();
+
+  display_color(DARKNESS);
+  app_timer_start(transition_timer, APP_TIMER_TICKS(TRANSITION_MS), NULL);
+}
+
+void handle_button_event(button_event_t event)
+{
+  // holding BUTTON1 or BUTTON2 keeps scrolling through the colors
+  bool is_step = event.type == BUTTON_PRESSED || event.type == BUTTON_REPEAT;
+
+  if (event.button == 0 && is_step && is_in_select_mode)
+  {
+    color_index = decrement_color_index(color_index);
+    update_color();
+    reset_displayed_colors();
+  }
+  if (event.button == 1 && is_step && is_in_select_mode)
+  {
+    color_index = increment_color_index(color_index);
+    update_color();
+    reset_displayed_colors();
+  }
+  // a short press of BUTTON3 toggles select mode, holding it changes the effect
+  if (event.button == 2 && event.type == BUTTON_LONG_PRESSED)
+  {
+    button3_held = true;
+    cycle_effect();
+  }
+  if (event.button == 2 && event.type == BUTTON_RELEASED)
+  {
+    if (!button3_held)
+    {
+      toggle_select_mode();
+    }
+    button3_held = false;
+  }
+}
+
 int main(void)
 {
+  telemetry_init();
+  profile_init();
   set_color_options();
   reset_displayed_colors();
 
-  nrf_gpio_cfg_input(BUTTON1, NRF_GPIO_PIN_PULLUP);
-  nrf_gpio_cfg_input(BUTTON2, NRF_GPIO_PIN_PULLUP);
-  nrf_gpio_cfg_input(BUTTON3, NRF_GPIO_PIN_PULLUP);
-
   printf("Board started. Initializing BLE: \n\n");
   simple_ble_app = simple_ble_init(&ble_config);
+  app_timer_init();
+
+  // The color and effect from before a reset, and the brightness the room
+  // had, are back before the first frame
+  kv_store_init();
+  restore_tag_state();
+  ambient_init(ambient_changed);
   pwm_init();
 
   // display user's current color
   display_color(color_options[color_index]);
 
-  app_timer_init();
   app_timer_create(&blinking_timer, APP_TIMER_MODE_REPEATED, blink_animation);
+  app_timer_create(&transition_timer, APP_TIMER_MODE_SINGLE_SHOT, finish_transition);
+  buttons_init(button_pins);
+
+  tag_auth_init();
+  tag_auth_set_key(TAG_KEY_SLOT, TAG_KEY);
+  timebase_init(ble_config.device_id);
 
-  uint8_t first_color[3] = {color_options[color_index].green,
-                            color_options[color_index].red,
-                            color_options[color_index].blue};
-  simple_ble_adv_manuf_data(first_color, 3);
+  set_tag_color(color_options[color_index]);
+  adv_scheduler_start(&tag_state, TAG_KEY_SLOT);
+  store_tag_state();
   printf("Started BLE advertisements\n\n");
 
   while (1)
   {
-    if (!nrf_gpio_pin_read(BUTTON1) && is_in_select_mode)
+    button_event_t event;
+    while (button_event_get(&event))
     {
-      color_index = decrement_color_index(color_index);
-      update_color();
-      reset_displayed_colors();
-      nrf_delay_ms(500);
+      handle_button_event(event);
     }
-    if (!nrf_gpio_pin_read(BUTTON2) && is_in_select_mode)
+    if (brightness_changed)
     {
-      color_index = increment_color_index(color_index);
-      update_color();
-      reset_displayed_colors();
-      nrf_delay_ms(500);
-    }
-    if (!nrf_gpio_pin_read(BUTTON3))
-    {
-      if (is_in_select_mode)
-      {
-        // set selection and leave select mode
-        app_timer_stop(blinking_timer);
-        is_in_select_mode = 0;
-
-        display_color(DARKNESS);
-        nrf_delay_ms(750);
-        display_color(color_options[color_index]);
-      }
-      else
-      {
-        // enter select mode, display color options
-        is_in_select_mode = 1;
-
-        display_color(DARKNESS);
-        nrf_delay_ms(750);
-        display_color_options(displayed_colors);
-
-        app_timer_start(blinking_timer, APP_TIMER_TICKS(750), NULL);
-      }
-      nrf_delay_ms(500);
+      brightness_changed = false;
+      render_frame();
     }
+
+    profile_poll();
+    power_manage();
   }
 }
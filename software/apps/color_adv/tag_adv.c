@@ -0,0 +1,128 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "ble_advdata.h"
+#include "ble_gap.h"
+
+#include "tag_adv.h"
+
+static uint8_t adv_handle = BLE_GAP_ADV_SET_HANDLE_NOT_SET;
+static ble_gap_adv_params_t adv_params;
+
+// The SoftDevice may still be reading one buffer while the other is rewritten
+static uint8_t adv_buffers[2][BLE_GAP_ADV_SET_DATA_SIZE_MAX];
+static uint8_t current_buffer = 0;
+static ble_gap_adv_data_t current_adv_data;
+
+static tag_adv_stats_t stats;
+
+// Encodes the payload into the buffer not in use and returns its advertising data
+static ble_gap_adv_data_t encode_next(uint8_t const *payload, uint8_t length)
+{
+  ble_advdata_manuf_data_t manuf_data = {
+      .company_identifier = TAG_COMPANY_ID,
+      .data = {.p_data = (uint8_t *)payload, .size = length},
+  };
+  ble_advdata_t advdata = {
+      .name_type = BLE_ADVDATA_NO_NAME,
+      .flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE,
+      .p_manuf_specific_data = &manuf_data,
+  };
+
+  current_buffer ^= 1;
+  uint16_t encoded_length = BLE_GAP_ADV_SET_DATA_SIZE_MAX;
+  ret_code_t err_code = ble_advdata_encode(&advdata, adv_buffers[current_buffer], &encoded_length);
+  APP_ERROR_CHECK(err_code);
+
+  current_adv_data = (ble_gap_adv_data_t){
+      .adv_data = {.p_data = adv_buffers[current_buffer], .len = encoded_length},
+      .scan_rsp_data = {.p_data = NULL, .len = 0},
+  };
+  return current_adv_data;
+}
+
+static uint32_t elapsed_since_us(uint32_t start)
+{
+  return (uint64_t)app_timer_cnt_diff_compute(app_timer_cnt_get(), start) * 1000000 / APP_TIMER_CLOCK_FREQ;
+}
+
+void tag_adv_start(uint8_t const *payload, uint8_t length, uint32_t interval_ms)
+{
+  memset(&adv_params, 0, sizeof(adv_params));
+  adv_params.properties.type = BLE_GAP_ADV_TYPE_NONCONNECTABLE_NONSCANNABLE_UNDIRECTED;
+  adv_params.filter_policy = BLE_GAP_ADV_FP_ANY;
+  adv_params.interval = MSEC_TO_UNITS(interval_ms, UNIT_0_625_MS);
+  adv_params.duration = BLE_GAP_ADV_TIMEOUT_GENERAL_UNLIMITED;
+  adv_params.primary_phy = BLE_GAP_PHY_1MBPS;
+
+  ble_gap_adv_data_t adv_data = encode_next(payload, length);
+  ret_code_t err_code = sd_ble_gap_adv_set_configure(&adv_handle, &adv_data, &adv_params);
+  APP_ERROR_CHECK(err_code);
+
+  err_code = sd_ble_gap_adv_start(adv_handle, BLE_CONN_CFG_TAG_DEFAULT);
+  APP_ERROR_CHECK(err_code);
+}
+
+void tag_adv_update(uint8_t const *payload, uint8_t length)
+{
+  uint32_t start = app_timer_cnt_get();
+  ble_gap_adv_data_t adv_data = encode_next(payload, length);
+  ret_code_t err_code;
+
+#if TAG_ADV_RESTART_ON_UPDATE
+  err_code = sd_ble_gap_adv_stop(adv_handle);
+  APP_ERROR_CHECK(err_code);
+  err_code = sd_ble_gap_adv_set_configure(&adv_handle, &adv_data, &adv_params);
+  APP_ERROR_CHECK(err_code);
+  err_code = sd_ble_gap_adv_start(adv_handle, BLE_CONN_CFG_TAG_DEFAULT);
+  APP_ERROR_CHECK(err_code);
+  stats.restarts++;
+#else
+  // New data only: the advertiser keeps running and picks it up on its next event
+  err_code = sd_ble_gap_adv_set_configure(&adv_handle, &adv_data, NULL);
+  APP_ERROR_CHECK(err_code);
+#endif
+
+  uint32_t elapsed_us = elapsed_since_us(start);
+  if (elapsed_us > stats.longest_update_us)
+  {
+    stats.longest_update_us = elapsed_us;
+  }
+  stats.updates++;
+}
+
+void tag_adv_restamp(uint8_t const *payload, uint8_t length)
+{
+  ble_gap_adv_data_t adv_data = encode_next(payload, length);
+  ret_code_t err_code = sd_ble_gap_adv_set_configure(&adv_handle, &adv_data, NULL);
+  APP_ERROR_CHECK(err_code);
+  stats.restamps++;
+}
+
+void tag_adv_set_interval(uint32_t interval_ms)
+{
+  adv_params.interval = MSEC_TO_UNITS(interval_ms, UNIT_0_625_MS);
+
+  uint32_t start = app_timer_cnt_get();
+  ret_code_t err_code = sd_ble_gap_adv_stop(adv_handle);
+  APP_ERROR_CHECK(err_code);
+  err_code = sd_ble_gap_adv_set_configure(&adv_handle, &current_adv_data, &adv_params);
+  APP_ERROR_CHECK(err_code);
+  err_code = sd_ble_gap_adv_start(adv_handle, BLE_CONN_CFG_TAG_DEFAULT);
+  APP_ERROR_CHECK(err_code);
+
+  uint32_t elapsed_us = elapsed_since_us(start);
+  if (elapsed_us > stats.longest_interval_change_us)
+  {
+    stats.longest_interval_change_us = elapsed_us;
+  }
+  stats.interval_changes++;
+}
+
+tag_adv_stats_t const *tag_adv_stats(void)
+{
+  return &stats;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "tag_payload.h"
+
+// Tag advertising
+//
+// Advertises a manufacturer-specific payload and swaps it in place. The
+// SoftDevice keeps using the old advertising data until the next advertising
+// event, so alternating between two encoded buffers lets a new payload go out
+// without stopping the advertiser.
+
+// 31 bytes less the flags (3) and the manufacturer data header (4)
+#define TAG_ADV_PAYLOAD_MAX 24
+
+// Build with TAG_ADV_RESTART_ON_UPDATE=1 to stop and restart advertising on
+// every update instead, to compare the silent gap this leaves
+#ifndef TAG_ADV_RESTART_ON_UPDATE
+#define TAG_ADV_RESTART_ON_UPDATE 0
+#endif
+
+typedef struct
+{
+  uint32_t updates;  // new states
+  uint32_t restamps; // the same state with a new time, see tag_adv_restamp()
+  uint32_t restarts;
+  uint32_t longest_update_us; // longest time spent applying an update
+  uint32_t interval_changes;
+  uint32_t longest_interval_change_us; // longest the advertiser was stopped
+} tag_adv_stats_t;
+
+// Configures the advertising set and starts advertising
+void tag_adv_start(uint8_t const *payload, uint8_t length, uint32_t interval_ms);
+
+// Replaces the payload from the next advertising event on
+void tag_adv_update(uint8_t const *payload, uint8_t length);
+
+// As tag_adv_update(), for a payload that only differs in its time and MAC.
+// Always swapped in place, and counted apart from updates
+void tag_adv_restamp(uint8_t const *payload, uint8_t length);
+
+// The SoftDevice only takes new advertising parameters while the set is
+// stopped, so this stops the advertiser and starts it again straight away.
+// The restart sends its first advert at once rather than waiting out the old
+// interval, so nothing is skipped; the cost is the time stopped, kept in
+// longest_interval_change_us. The scheduler changes interval at most once
+// per ADV_ADVERTS_PER_STEP adverts
+void tag_adv_set_interval(uint32_t interval_ms);
+
+tag_adv_stats_t const *tag_adv_stats(void);
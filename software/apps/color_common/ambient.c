@@ -0,0 +1,125 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_error.h"
+#include "app_timer.h"
+
+#include "ambient.h"
+#include "kv_store.h"
+#include "q15_filter.h"
+#include "saadc_stream.h"
+#include "strip_brightness.h"
+
+// One oversampled reading every 8 ms, so a buffer of 128 fills each second
+#define SAMPLE_RATE_HZ 128
+#define ADJUST_INTERVAL_MS 1000
+
+// Buffer means go through a single pole low-pass with a time constant of
+// about 8 buffers, which rides out shadows and lights flicking past
+#define LEVEL_ALPHA 4096
+
+static q15_iir_t level_filter;
+static volatile int16_t level;
+static volatile bool level_valid = false;
+static uint32_t brightness = AMBIENT_MAX_SCALE;
+static ambient_handler_t changed_handler = NULL;
+
+APP_TIMER_DEF(adjust_timer);
+
+// Runs in the SAADC interrupt with a second of readings
+static void stream_handler(nrf_saadc_value_t const *samples, uint16_t scans)
+{
+  int32_t sum = 0;
+  for (uint16_t i = 0; i < scans; i++)
+  {
+    sum += samples[i];
+  }
+  int16_t mean = sum / scans;
+
+  if (!level_valid)
+  {
+    // Start from the first reading rather than ramping up from zero
+    q15_iir_init(&level_filter, LEVEL_ALPHA, mean);
+  }
+  int16_t filtered;
+  q15_iir(&level_filter, &mean, &filtered, 1);
+  level = filtered;
+  level_valid = true;
+}
+
+static uint32_t target_brightness(int32_t level_mv)
+{
+  if (level_mv <= AMBIENT_DARK_MV)
+  {
+    return AMBIENT_MIN_SCALE;
+  }
+  if (level_mv >= AMBIENT_BRIGHT_MV)
+  {
+    return AMBIENT_MAX_SCALE;
+  }
+  return AMBIENT_MIN_SCALE + (uint32_t)(level_mv - AMBIENT_DARK_MV) * (AMBIENT_MAX_SCALE - AMBIENT_MIN_SCALE) /
+                                 (AMBIENT_BRIGHT_MV - AMBIENT_DARK_MV);
+}
+
+static void adjust(void *context)
+{
+  if (!level_valid)
+  {
+    return;
+  }
+
+  uint32_t target = target_brightness(ambient_level_mv());
+  uint32_t difference = target > brightness ? target - brightness : brightness - target;
+
+  // The ends of the range are always reached, however close
+  bool at_end = target == AMBIENT_MIN_SCALE || target == AMBIENT_MAX_SCALE;
+  if (difference >= AMBIENT_HYSTERESIS || (at_end && difference > 0))
+  {
+    brightness = target;
+    set_brightness(brightness);
+    kv_store_set(KV_KEY_AMBIENT, &brightness, sizeof(brightness));
+    if (changed_handler)
+    {
+      changed_handler();
+    }
+  }
+}
+
+void ambient_init(ambient_handler_t handler)
+{
+  changed_handler = handler;
+
+  // The room is likely as bright as before a reset, until the first reading
+  uint32_t stored;
+  if (kv_store_get(KV_KEY_AMBIENT, &stored, sizeof(stored)) && stored >= AMBIENT_MIN_SCALE &&
+      stored <= AMBIENT_MAX_SCALE)
+  {
+    brightness = stored;
+  }
+  set_brightness(brightness);
+
+  saadc_stream_config_t config = {
+      .sample_rate_hz = SAMPLE_RATE_HZ,
+      .oversample = NRF_SAADC_OVERSAMPLE_8X,
+      .channel_count = 1,
+      .inputs = {AMBIENT_INPUT},
+  };
+  ret_code_t err_code = saadc_stream_init(&config, stream_handler);
+  APP_ERROR_CHECK(err_code);
+  saadc_stream_start();
+
+  err_code = app_timer_create(&adjust_timer, APP_TIMER_MODE_REPEATED, adjust);
+  APP_ERROR_CHECK(err_code);
+  err_code = app_timer_start(adjust_timer, APP_TIMER_TICKS(ADJUST_INTERVAL_MS), NULL);
+  APP_ERROR_CHECK(err_code);
+}
+
+int32_t ambient_level_mv(void)
+{
+  return saadc_stream_to_mv(level);
+}
+
+uint32_t ambient_brightness(void)
+{
+  return brightness;
+}
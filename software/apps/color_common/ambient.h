@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "nrfx_saadc.h"
+
+// Ambient light brightness
+//
+// Reads a photosensor through the SAADC stream from analog_read, low-passes
+// the level and sets the strip brightness to match: dim in a dark room, full
+// in a bright one. The brightness only follows once the target has moved
+// AMBIENT_HYSTERESIS away from it, so a level near a step doesn't flicker.
+//
+// The sensor should read higher in brighter light, e.g. a phototransistor
+// from VDD with a resistor to ground.
+//
+// Only the brightness is set, through strip_brightness.h. The app redraws
+// when told, from whichever context it draws in.
+
+#ifndef AMBIENT_INPUT
+#define AMBIENT_INPUT NRF_SAADC_INPUT_AIN7 // P0.31
+#endif
+
+// Sensor levels at which the strip is at its dimmest and its brightest
+#define AMBIENT_DARK_MV 100
+#define AMBIENT_BRIGHT_MV 2500
+
+// Brightness range and step, out of 256
+#define AMBIENT_MIN_SCALE 16
+#ifndef AMBIENT_MAX_SCALE
+#define AMBIENT_MAX_SCALE 256
+#endif
+#define AMBIENT_HYSTERESIS 16
+
+// Called from the app_timer interrupt after the brightness has changed, for
+// the app to redraw with it
+typedef void (*ambient_handler_t)(void);
+
+// Starts sampling and adjusting from the brightness kept in the kv_store.
+// Needs app_timer and kv_store_init(). The handler can be NULL
+void ambient_init(ambient_handler_t handler);
+
+// Filtered sensor level
+int32_t ambient_level_mv(void);
+
+// Brightness currently applied
+uint32_t ambient_brightness(void);
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "nrf.h"
+#include "nrf_delay.h"
+#include "nrfx_pwm.h"
+
+#include "strip_brightness.h"
+
+// LED strip driver shared by the color apps
+//
+// Each app's pwm_driver.h sets LED_COUNT, LED_STRIP_PIN and
+// LED_STRIP_POWER_PIN and then includes this. The driver keeps a framebuffer
+// and only re-encodes the pixels that changed, scales frames into the power
+// budget and leaves the strip's rail off while a frame is dark.
+
+#if !defined(LED_COUNT) || !defined(LED_STRIP_PIN) || !defined(LED_STRIP_POWER_PIN)
+#error "Include the app's pwm_driver.h, which configures the strip, instead"
+#endif
+
+// Time for the rail to settle before the first bit is clocked out
+#ifndef LED_STRIP_POWER_UP_US
+#define LED_STRIP_POWER_UP_US 500
+#endif
+
+// Pixel format of the strip, fixed at compile time (override with -D)
+//   GRB:  WS2812B, SK6812 RGB        RGB:  APA106
+//   GRBW: SK6812 RGBW                RGBW: RGBW parts with red first
+// LED_CHANNEL_BITS is 8, or 16 for WS2816-style parts
+#define LED_ORDER_GRB 0
+#define LED_ORDER_RGB 1
+#define LED_ORDER_GRBW 2
+#define LED_ORDER_RGBW 3
+
+#ifndef LED_PIXEL_ORDER
+#define LED_PIXEL_ORDER LED_ORDER_GRB
+#endif
+
+#ifndef LED_CHANNEL_BITS
+#define LED_CHANNEL_BITS 8
+#endif
+
+#if LED_PIXEL_ORDER == LED_ORDER_GRB
+#define LED_CHANNEL_COUNT 3
+#define LED_CHANNEL_0 green
+#define LED_CHANNEL_1 red
+#define LED_CHANNEL_2 blue
+#elif LED_PIXEL_ORDER == LED_ORDER_RGB
+#define LED_CHANNEL_COUNT 3
+#define LED_CHANNEL_0 red
+#define LED_CHANNEL_1 green
+#define LED_CHANNEL_2 blue
+#elif LED_PIXEL_ORDER == LED_ORDER_GRBW
+#define LED_CHANNEL_COUNT 4
+#define LED_CHANNEL_0 green
+#define LED_CHANNEL_1 red
+#define LED_CHANNEL_2 blue
+#define LED_CHANNEL_3 white
+#elif LED_PIXEL_ORDER == LED_ORDER_RGBW
+#define LED_CHANNEL_COUNT 4
+#define LED_CHANNEL_0 red
+#define LED_CHANNEL_1 green
+#define LED_CHANNEL_2 blue
+#define LED_CHANNEL_3 white
+#else
+#error "Unknown LED_PIXEL_ORDER"
+#endif
+
+#if LED_CHANNEL_BITS != 8 && LED_CHANNEL_BITS != 16
+#error "LED_CHANNEL_BITS must be 8 or 16"
+#endif
+
+#define LED_BITS_PER_PIXEL (LED_CHANNEL_COUNT * LED_CHANNEL_BITS)
+// Need enough for LED_COUNT LEDs * LED_BITS_PER_PIXEL + one pixel of 0's to mark end
+#define LED_DUTY_CYCLE_ARRAY_LENGTH ((LED_COUNT + 1) * LED_BITS_PER_PIXEL)
+
+// Power budget for the strip supply
+// The estimated draw is a fixed quiescent current per LED plus a calibrated
+// current per unit of channel value (a WS2812B channel draws ~20 mA at 255).
+// Frames estimated above the budget are scaled down as a whole.
+// The default is what a USB 2.0 port supplies; an LED at full white draws
+// ~60 mA, so it engages on bright frames of even a short strip. Raise it for
+// a bigger supply
+#ifndef LED_STRIP_BUDGET_MA
+#define LED_STRIP_BUDGET_MA 500
+#endif
+#define LED_QUIESCENT_UA 1000
+#define LED_GREEN_UA_PER_UNIT 78
+#define LED_RED_UA_PER_UNIT 78
+#define LED_BLUE_UA_PER_UNIT 78
+#define LED_WHITE_UA_PER_UNIT 78
+
+#if LED_COUNT * LED_QUIESCENT_UA >= LED_STRIP_BUDGET_MA * 1000
+#error "LED_STRIP_BUDGET_MA doesn't cover the quiescent current of LED_COUNT LEDs"
+#endif
+
+// Channels are sent in LED_PIXEL_ORDER, most significant bit first.
+// white is only sent to 4-channel strips
+typedef union color
+{
+  uint32_t val;
+  struct
+  {
+    uint8_t green;
+    uint8_t red;
+    uint8_t blue;
+    uint8_t white;
+  };
+} color_t;
+
+enum duty_cycle
+{
+  HIGH = (1 << 15) | 7,
+  LOW = (1 << 15) | 3
+};
+
+// Called as each frame starts playing out, from render_frame(), and once the
+// strip has latched it, from the PWM interrupt. A dark frame calls both at
+// once. Either can be NULL
+typedef void (*frame_handler_t)(void);
+
+void pwm_init(void);
+
+void pwm_set_frame_handlers(frame_handler_t started, frame_handler_t shown);
+
+// Framebuffer access. Changes only reach the strip on the next render_frame()
+void set_pixel(uint32_t led_num, color_t color);
+void fill_pixels(color_t color);
+
+// Encodes the pixels changed since the last frame and starts playback
+void render_frame(void);
+
+// Estimated current of the framebuffer contents, before budget scaling
+uint32_t estimated_strip_current_ma(void);
+
+void display_color(color_t color);
@@ -0,0 +1,285 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_util_platform.h"
+#include "nrf.h"
+#include "nrf_delay.h"
+#include "nrf_gpio.h"
+#include "nrfx_pwm.h"
+
+#include "profile.h"
+// The app's own, which configures the strip and includes led_strip.h
+#include "pwm_driver.h"
+#include "nrf52840dk.h"
+
+// PWM configuration
+static const nrfx_pwm_t PWM_INST = NRFX_PWM_INSTANCE(0);
+
+// Holds duty cycle values to trigger PWM toggle
+nrf_pwm_values_common_t sequence_data[LED_DUTY_CYCLE_ARRAY_LENGTH];
+
+// Sequence structure for configuring DMA
+nrf_pwm_sequence_t pwm_sequence = {
+    .values.p_common = sequence_data,
+    .length = LED_DUTY_CYCLE_ARRAY_LENGTH,
+    .repeats = 0,
+    .end_delay = 0,
+};
+
+// Framebuffer and the pixels that changed since they were last encoded
+static color_t framebuffer[LED_COUNT];
+static uint32_t dirty_pixels[(LED_COUNT + 31) / 32];
+
+// Per-channel sums of the framebuffer, kept up to date by set_pixel()
+static uint32_t green_sum;
+static uint32_t red_sum;
+static uint32_t blue_sum;
+static uint32_t white_sum;
+
+// Scale (out of 256) the current sequence_data was encoded with
+static uint32_t encoded_scale = 256;
+static bool strip_powered = false;
+
+// Scale (out of 256) from set_brightness()
+static uint32_t brightness = 256;
+
+static void mark_dirty(uint32_t led_num)
+{
+  dirty_pixels[led_num / 32] |= 1UL << (led_num % 32);
+}
+
+static void mark_all_dirty(void)
+{
+  for (uint32_t i = 0; i < LED_COUNT; i++)
+  {
+    mark_dirty(i);
+  }
+}
+
+static void set_strip_power(bool powered)
+{
+  if (powered == strip_powered)
+  {
+    return;
+  }
+
+  strip_powered = powered;
+  if (powered)
+  {
+    nrf_gpio_pin_set(LED_STRIP_POWER_PIN);
+    nrf_delay_us(LED_STRIP_POWER_UP_US);
+  }
+  else
+  {
+    nrf_gpio_pin_clear(LED_STRIP_POWER_PIN);
+  }
+}
+
+static frame_handler_t frame_started = NULL;
+static frame_handler_t frame_shown = NULL;
+
+static void notify(frame_handler_t handler)
+{
+  if (handler)
+  {
+    handler();
+  }
+}
+
+// The frame has been played out and the strip has latched it
+static void pwm_event_handler(nrfx_pwm_evt_type_t event_type)
+{
+  if (event_type == NRFX_PWM_EVT_STOPPED)
+  {
+    notify(frame_shown);
+  }
+}
+
+void pwm_set_frame_handlers(frame_handler_t started, frame_handler_t shown)
+{
+  frame_started = started;
+  frame_shown = shown;
+}
+
+void pwm_init(void)
+{
+  // Strip rail stays off until there is something to show
+  nrf_gpio_cfg_output(LED_STRIP_POWER_PIN);
+  nrf_gpio_pin_clear(LED_STRIP_POWER_PIN);
+
+  // Initialize the PWM
+  nrfx_pwm_config_t local_config;
+  local_config.output_pins[0] = LED_STRIP_PIN;
+  for (int i = 1; i < 4; i++)
+  {
+    local_config.output_pins[i] = NRFX_PWM_PIN_NOT_USED;
+  }
+  local_config.base_clock = NRF_PWM_CLK_8MHz;
+  local_config.count_mode = NRF_PWM_MODE_UP;
+  local_config.load_mode = NRF_PWM_LOAD_COMMON;
+  local_config.step_mode = NRF_PWM_STEP_AUTO;
+  local_config.top_value = 8000000 / 400000;
+  local_config.irq_priority = APP_IRQ_PRIORITY_LOWEST;
+
+  nrfx_pwm_init(&PWM_INST, &local_config, pwm_event_handler);
+
+  // Trailing 0's mark the end of the frame and never change
+  for (uint32_t i = LED_COUNT * LED_BITS_PER_PIXEL; i < LED_DUTY_CYCLE_ARRAY_LENGTH; i++)
+  {
+    sequence_data[i] = 0;
+  }
+  mark_all_dirty();
+}
+
+// Encodes the top 8 bits of a 16-bit channel value, MSB first
+static inline void encode_byte(nrf_pwm_values_common_t *out, uint32_t value)
+{
+  out[0] = LOW | ((value >> 13) & 4);
+  out[1] = LOW | ((value >> 12) & 4);
+  out[2] = LOW | ((value >> 11) & 4);
+  out[3] = LOW | ((value >> 10) & 4);
+  out[4] = LOW | ((value >> 9) & 4);
+  out[5] = LOW | ((value >> 8) & 4);
+  out[6] = LOW | ((value >> 7) & 4);
+  out[7] = LOW | ((value >> 6) & 4);
+}
+
+// Widens an 8-bit channel to 16 bits (0xFF -> 0xFFFF) and applies a scale out of 256
+static inline uint32_t scale_channel(uint8_t value, uint32_t scale)
+{
+  return (value * 257 * scale) >> 8;
+}
+
+static inline void encode_channel(nrf_pwm_values_common_t *out, uint8_t value, uint32_t scale)
+{
+  uint32_t wide = scale_channel(value, scale);
+  encode_byte(out, wide);
+#if LED_CHANNEL_BITS == 16
+  encode_byte(out + 8, wide << 8);
+#endif
+}
+
+// Fully unrolled for the configured format, no per-pixel format checks
+void set_led_to_color(uint32_t led_num, color_t color, uint32_t scale)
+{
+  nrf_pwm_values_common_t *out = &sequence_data[led_num * LED_BITS_PER_PIXEL];
+
+  encode_channel(out + 0 * LED_CHANNEL_BITS, color.LED_CHANNEL_0, scale);
+  encode_channel(out + 1 * LED_CHANNEL_BITS, color.LED_CHANNEL_1, scale);
+  encode_channel(out + 2 * LED_CHANNEL_BITS, color.LED_CHANNEL_2, scale);
+#if LED_CHANNEL_COUNT == 4
+  encode_channel(out + 3 * LED_CHANNEL_BITS, color.LED_CHANNEL_3, scale);
+#endif
+}
+
+void set_pixel(uint32_t led_num, color_t color)
+{
+  color_t old_color = framebuffer[led_num];
+  if (old_color.val == color.val)
+  {
+    return;
+  }
+
+  green_sum += color.green - old_color.green;
+  red_sum += color.red - old_color.red;
+  blue_sum += color.blue - old_color.blue;
+#if LED_CHANNEL_COUNT == 4
+  white_sum += color.white - old_color.white;
+#endif
+
+  framebuffer[led_num] = color;
+  mark_dirty(led_num);
+}
+
+void fill_pixels(color_t color)
+{
+  for (uint32_t i = 0; i < LED_COUNT; i++)
+  {
+    set_pixel(i, color);
+  }
+}
+
+static uint32_t estimated_load_ua(void)
+{
+  return green_sum * LED_GREEN_UA_PER_UNIT + red_sum * LED_RED_UA_PER_UNIT + blue_sum * LED_BLUE_UA_PER_UNIT +
+         white_sum * LED_WHITE_UA_PER_UNIT;
+}
+
+uint32_t estimated_strip_current_ma(void)
+{
+  return (LED_COUNT * LED_QUIESCENT_UA + estimated_load_ua()) / 1000;
+}
+
+// Scale (out of 256) that brings the frame within the power budget
+static uint32_t budget_scale(void)
+{
+  const uint32_t available_ua = LED_STRIP_BUDGET_MA * 1000 - LED_COUNT * LED_QUIESCENT_UA;
+  uint32_t load_ua = estimated_load_ua();
+
+  if (load_ua <= available_ua)
+  {
+    return 256;
+  }
+  return (uint32_t)(((uint64_t)available_ua * 256) / load_ua);
+}
+
+void set_brightness(uint32_t scale)
+{
+  brightness = scale < 256 ? scale : 256;
+}
+
+void render_frame(void)
+{
+  // Stop the PWM (and wait until its finished)
+  // Second argument blocks function until finished if true
+  nrfx_pwm_stop(&PWM_INST, true);
+
+  // A dark frame needs no data at all, so leave the strip unpowered
+  if (green_sum == 0 && red_sum == 0 && blue_sum == 0 && white_sum == 0)
+  {
+    set_strip_power(false);
+    notify(frame_started);
+    notify(frame_shown);
+    return;
+  }
+
+  uint32_t scale = budget_scale();
+  if (brightness < scale)
+  {
+    scale = brightness;
+  }
+  if (scale != encoded_scale)
+  {
+    encoded_scale = scale;
+    mark_all_dirty();
+  }
+
+  // Timed once per frame rather than per pixel, so recording doesn't weigh on
+  // display_color
+  PROFILE_BEGIN(encode_pixels);
+  for (uint32_t word = 0; word < sizeof(dirty_pixels) / sizeof(dirty_pixels[0]); word++)
+  {
+    while (dirty_pixels[word])
+    {
+      uint32_t bit = __builtin_ctz(dirty_pixels[word]);
+      dirty_pixels[word] &= dirty_pixels[word] - 1;
+
+      uint32_t led_num = word * 32 + bit;
+      set_led_to_color(led_num, framebuffer[led_num], scale);
+    }
+  }
+  PROFILE_END(encode_pixels);
+
+  set_strip_power(true);
+  notify(frame_started);
+  nrfx_pwm_simple_playback(&PWM_INST, &pwm_sequence, 1, NRFX_PWM_FLAG_STOP);
+}
+
+void display_color(color_t color)
+{
+  PROFILE_BEGIN(display_color);
+  fill_pixels(color);
+  render_frame();
+  PROFILE_END(display_color);
+}
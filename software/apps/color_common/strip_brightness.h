@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+// The part of the strip driver that ambient.c uses, so it doesn't depend on
+// the app's pwm_driver.h and its strip configuration
+
+// Global brightness out of 256, applied with the power budget on the next
+// render_frame(). Whichever of the two is lower wins
+void set_brightness(uint32_t scale);
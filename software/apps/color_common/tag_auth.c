@@ -0,0 +1,172 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "app_error.h"
+#include "app_util_platform.h"
+#include "mem_manager.h"
+#include "nrf.h"
+#include "nrf_crypto.h"
+
+#include "tag_auth.h"
+#include "tag_payload.h"
+
+#define ADDR_LENGTH 6
+#define CMAC_LENGTH 16
+
+typedef struct key_slot
+{
+  nrf_crypto_aes_context_t keyed_context; // never finalized, only copied
+  bool in_use;
+  bool has_counter;
+  uint32_t last_counter;
+  bool has_time;
+  uint32_t last_time_ms; // of the last payload accepted, if it was timed
+} key_slot_t;
+
+static key_slot_t slots[TAG_AUTH_MAX_KEYS];
+static tag_auth_stats_t stats;
+static uint64_t verify_cycles = 0;
+
+// The signed bytes of a payload: everything but the MAC, which sits at
+// mac_offset and is followed by the time if there is one
+static uint8_t signed_tail_length(uint8_t const *payload)
+{
+  return payload[1] & TAG_PAYLOAD_FLAG_TIME ? TAG_PAYLOAD_TIME_LENGTH : 0;
+}
+
+static void compute_mac(key_slot_t *slot, uint8_t const *addr, uint8_t const *payload, uint8_t mac_offset,
+                        uint8_t *mac)
+{
+  uint8_t tail_length = signed_tail_length(payload);
+  uint8_t message[ADDR_LENGTH + TAG_PAYLOAD_MAX_LENGTH];
+  memcpy(message, addr, ADDR_LENGTH);
+  memcpy(&message[ADDR_LENGTH], payload, mac_offset);
+  memcpy(&message[ADDR_LENGTH + mac_offset], &payload[mac_offset + TAG_PAYLOAD_MAC_LENGTH], tail_length);
+
+  // Tags sign from the radio notification and peers verify from BLE events,
+  // so the CC310 is only used by one of them at a time
+  nrf_crypto_aes_context_t context = slot->keyed_context;
+  size_t mac_size = CMAC_LENGTH;
+  ret_code_t err_code;
+  CRITICAL_REGION_ENTER();
+  err_code = nrf_crypto_aes_finalize(&context, message, ADDR_LENGTH + mac_offset + tail_length, mac, &mac_size);
+  CRITICAL_REGION_EXIT();
+  APP_ERROR_CHECK(err_code);
+}
+
+static uint32_t read_counter(uint8_t const *payload, uint8_t mac_offset)
+{
+  uint8_t const *counter = &payload[mac_offset - TAG_PAYLOAD_COUNTER_LENGTH];
+  return counter[0] | (counter[1] << 8) | (counter[2] << 16) | ((uint32_t)counter[3] << 24);
+}
+
+// A new counter is always fresh. The same counter is only fresh with a
+// signed time later than the last accepted, the time wrapping like the
+// tag's clock
+static bool is_fresh(key_slot_t const *key_slot, uint32_t counter, bool timed, uint32_t time_ms)
+{
+  if (!key_slot->has_counter || counter > key_slot->last_counter)
+  {
+    return true;
+  }
+  return counter == key_slot->last_counter && timed && key_slot->has_time &&
+         (int32_t)(time_ms - key_slot->last_time_ms) > 0;
+}
+
+void tag_auth_init(void)
+{
+  ret_code_t err_code = nrf_crypto_init();
+  APP_ERROR_CHECK(err_code);
+  err_code = nrf_mem_init();
+  APP_ERROR_CHECK(err_code);
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void tag_auth_set_key(uint8_t slot, uint8_t const *key)
+{
+  APP_ERROR_CHECK_BOOL(slot < TAG_AUTH_MAX_KEYS);
+  key_slot_t *key_slot = &slots[slot];
+
+  ret_code_t err_code = nrf_crypto_aes_init(&key_slot->keyed_context, &g_nrf_crypto_aes_cmac_128_info,
+                                            NRF_CRYPTO_MAC_CALCULATE);
+  APP_ERROR_CHECK(err_code);
+  err_code = nrf_crypto_aes_key_set(&key_slot->keyed_context, (uint8_t *)key);
+  APP_ERROR_CHECK(err_code);
+
+  key_slot->in_use = true;
+  key_slot->has_counter = false;
+  key_slot->has_time = false;
+}
+
+void tag_auth_sign(uint8_t slot, uint8_t const *addr, uint8_t *payload, uint8_t length)
+{
+  APP_ERROR_CHECK_BOOL(slot < TAG_AUTH_MAX_KEYS && slots[slot].in_use);
+  uint8_t mac_offset = tag_payload_stable_length(payload, length);
+
+  uint8_t mac[CMAC_LENGTH];
+  compute_mac(&slots[slot], addr, payload, mac_offset, mac);
+  memcpy(&payload[mac_offset], mac, TAG_PAYLOAD_MAC_LENGTH);
+}
+
+bool tag_auth_verify(uint8_t slot, uint8_t const *addr, uint8_t const *payload, uint8_t length)
+{
+  if (slot >= TAG_AUTH_MAX_KEYS || !slots[slot].in_use)
+  {
+    return false;
+  }
+  if (length < TAG_PAYLOAD_MIN_LENGTH || !(payload[1] & TAG_PAYLOAD_FLAG_AUTH))
+  {
+    return false;
+  }
+  uint8_t mac_offset = tag_payload_stable_length(payload, length);
+  if (length < mac_offset + TAG_PAYLOAD_MAC_LENGTH + signed_tail_length(payload))
+  {
+    return false;
+  }
+
+  key_slot_t *key_slot = &slots[slot];
+
+  uint32_t start = DWT->CYCCNT;
+  uint8_t mac[CMAC_LENGTH];
+  compute_mac(key_slot, addr, payload, mac_offset, mac);
+
+  // constant time compare
+  uint8_t difference = 0;
+  for (uint8_t i = 0; i < TAG_PAYLOAD_MAC_LENGTH; i++)
+  {
+    difference |= mac[i] ^ payload[mac_offset + i];
+  }
+  verify_cycles += DWT->CYCCNT - start;
+
+  if (difference)
+  {
+    stats.bad_mac++;
+    return false;
+  }
+
+  uint32_t counter = read_counter(payload, mac_offset);
+  uint32_t time_ms = 0;
+  bool timed = tag_payload_peek_time(payload, length, &time_ms);
+  if (!is_fresh(key_slot, counter, timed, time_ms))
+  {
+    stats.replayed++;
+    return false;
+  }
+
+  key_slot->last_counter = counter;
+  key_slot->has_counter = true;
+  key_slot->last_time_ms = time_ms;
+  key_slot->has_time = timed;
+  stats.verified++;
+  return true;
+}
+
+tag_auth_stats_t tag_auth_stats(void)
+{
+  uint32_t attempts = stats.verified + stats.bad_mac + stats.replayed;
+  stats.average_verify_us = attempts ? verify_cycles / attempts / (SystemCoreClock / 1000000) : 0;
+  return stats;
+}
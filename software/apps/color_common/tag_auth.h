@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Tag payload authentication
+//
+// A signed payload (TAG_PAYLOAD_FLAG_AUTH) has a counter and the first
+// TAG_PAYLOAD_MAC_LENGTH bytes of an AES-CMAC computed on the CC310 over the
+// tag's 6-byte BLE address followed by the rest of the payload, the time
+// after the MAC included. Setting a key keeps a context with the key
+// already loaded, and each MAC works on a copy of it, so verifying an advert
+// costs a single CMAC finalize.
+//
+// A payload is only accepted if it is newer than the last one verified under
+// the same key: either its counter is greater, or the counter is the same and
+// its signed time is later. Tags restamp the time before every advert, so no
+// payload, the current one included, is accepted twice. Untimed payloads
+// need a new counter each time, so a tag that stops restamping
+// (TAG_ADV_RESTART_ON_UPDATE) is accepted once per state and then kept alive
+// by the scanner's duplicate cache.
+
+#define TAG_AUTH_KEY_LENGTH 16
+#define TAG_AUTH_MAX_KEYS 2
+
+typedef struct
+{
+  uint32_t verified;
+  uint32_t bad_mac;
+  uint32_t replayed;         // valid MAC but not newer than the last accepted
+  uint32_t average_verify_us;
+} tag_auth_stats_t;
+
+// Starts nrf_crypto and the cycle counter used for timing
+void tag_auth_init(void);
+
+// slot is below TAG_AUTH_MAX_KEYS
+void tag_auth_set_key(uint8_t slot, uint8_t const *key);
+
+// Fills in the MAC of a payload produced by tag_payload_encode(), with a
+// slot that has a key. Sign again after restamping the time. Safe from any
+// application interrupt priority
+void tag_auth_sign(uint8_t slot, uint8_t const *addr, uint8_t *payload, uint8_t length);
+
+// Returns true if the payload is signed, its MAC matches and it is newer than
+// the last one accepted for this slot
+bool tag_auth_verify(uint8_t slot, uint8_t const *addr, uint8_t const *payload, uint8_t length);
+
+tag_auth_stats_t tag_auth_stats(void);
@@ -0,0 +1,182 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tag_payload.h"
+
+// AD type of manufacturer specific data
+#define AD_TYPE_MANUFACTURER_DATA 0xFF
+
+uint8_t tag_payload_encode(tag_state_t const *state, uint8_t *buf)
+{
+  buf[0] = TAG_PAYLOAD_VERSION;
+  buf[1] = state->flags;
+  buf[2] = state->sequence;
+  buf[3] = state->green;
+  buf[4] = state->red;
+  buf[5] = state->blue;
+  buf[6] = state->brightness;
+  buf[7] = state->effect;
+
+  uint8_t length = 8;
+  if (state->flags & TAG_PAYLOAD_FLAG_TX_POWER)
+  {
+    buf[length++] = (uint8_t)state->tx_power;
+  }
+
+  if (state->flags & TAG_PAYLOAD_FLAG_AUTH)
+  {
+    buf[length++] = state->counter;
+    buf[length++] = state->counter >> 8;
+    buf[length++] = state->counter >> 16;
+    buf[length++] = state->counter >> 24;
+    memset(&buf[length], 0, TAG_PAYLOAD_MAC_LENGTH);
+    length += TAG_PAYLOAD_MAC_LENGTH;
+  }
+
+  if (state->flags & TAG_PAYLOAD_FLAG_TIME)
+  {
+    tag_payload_stamp_time(buf, state->time_ms);
+    length += TAG_PAYLOAD_TIME_LENGTH;
+  }
+  return length;
+}
+
+bool tag_payload_find(uint8_t const *adv_data, uint16_t adv_length, uint8_t const **payload, uint8_t *length)
+{
+  // Walk the AD structures: length, type, data[length - 1]
+  uint16_t offset = 0;
+  while (offset + 1 < adv_length)
+  {
+    uint8_t field_length = adv_data[offset];
+    if (field_length == 0 || offset + 1 + field_length > adv_length)
+    {
+      return false;
+    }
+
+    uint8_t const *field = &adv_data[offset + 1];
+    if (field[0] == AD_TYPE_MANUFACTURER_DATA && field_length >= 3)
+    {
+      uint16_t company = field[1] | (field[2] << 8);
+      if (company == TAG_COMPANY_ID)
+      {
+        *payload = &field[3];
+        *length = field_length - 3;
+        return true;
+      }
+    }
+
+    offset += 1 + field_length;
+  }
+  return false;
+}
+
+static uint32_t read_u32(uint8_t const *buf)
+{
+  return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+// The time follows all signed fields
+static uint8_t time_offset(uint8_t flags)
+{
+  uint8_t offset = 8;
+  if (flags & TAG_PAYLOAD_FLAG_TX_POWER)
+  {
+    offset += 1;
+  }
+  if (flags & TAG_PAYLOAD_FLAG_AUTH)
+  {
+    offset += TAG_PAYLOAD_COUNTER_LENGTH + TAG_PAYLOAD_MAC_LENGTH;
+  }
+  return offset;
+}
+
+static bool is_valid(uint8_t const *payload, uint8_t length)
+{
+  if (length < TAG_PAYLOAD_MIN_LENGTH || payload[0] != TAG_PAYLOAD_VERSION)
+  {
+    return false;
+  }
+
+  uint8_t expected = time_offset(payload[1]);
+  if (payload[1] & TAG_PAYLOAD_FLAG_TIME)
+  {
+    expected += TAG_PAYLOAD_TIME_LENGTH;
+  }
+  return length >= expected;
+}
+
+bool tag_payload_peek_sequence(uint8_t const *payload, uint8_t length, uint8_t *sequence)
+{
+  if (!is_valid(payload, length))
+  {
+    return false;
+  }
+
+  *sequence = payload[2];
+  return true;
+}
+
+uint8_t tag_payload_stable_length(uint8_t const *payload, uint8_t length)
+{
+  if (payload[1] & TAG_PAYLOAD_FLAG_AUTH)
+  {
+    return time_offset(payload[1]) - TAG_PAYLOAD_MAC_LENGTH;
+  }
+  if (payload[1] & TAG_PAYLOAD_FLAG_TIME)
+  {
+    return time_offset(payload[1]);
+  }
+  return length;
+}
+
+bool tag_payload_peek_time(uint8_t const *payload, uint8_t length, uint32_t *time_ms)
+{
+  if (!(payload[1] & TAG_PAYLOAD_FLAG_TIME))
+  {
+    return false;
+  }
+
+  *time_ms = read_u32(&payload[time_offset(payload[1])]);
+  return true;
+}
+
+void tag_payload_stamp_time(uint8_t *payload, uint32_t time_ms)
+{
+  uint8_t *time = &payload[time_offset(payload[1])];
+  time[0] = time_ms;
+  time[1] = time_ms >> 8;
+  time[2] = time_ms >> 16;
+  time[3] = time_ms >> 24;
+}
+
+bool tag_payload_decode(uint8_t const *payload, uint8_t length, tag_state_t *state)
+{
+  if (!is_valid(payload, length))
+  {
+    return false;
+  }
+
+  state->flags = payload[1];
+  state->sequence = payload[2];
+  state->green = payload[3];
+  state->red = payload[4];
+  state->blue = payload[5];
+  state->brightness = payload[6];
+  state->effect = payload[7];
+  state->tx_power = 0;
+  state->counter = 0;
+  state->time_ms = 0;
+
+  uint8_t offset = 8;
+  if (state->flags & TAG_PAYLOAD_FLAG_TX_POWER)
+  {
+    state->tx_power = (int8_t)payload[offset++];
+  }
+  if (state->flags & TAG_PAYLOAD_FLAG_AUTH)
+  {
+    state->counter = read_u32(&payload[offset]);
+  }
+  tag_payload_peek_time(payload, length, &state->time_ms);
+  return true;
+}
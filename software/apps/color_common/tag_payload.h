@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Tag state payload
+//
+// Carried in the manufacturer-specific data of a tag's adverts, after the
+// company identifier. All fields are single bytes:
+//
+//   0 version     TAG_PAYLOAD_VERSION
+//   1 flags       TAG_PAYLOAD_FLAG_*
+//   2 sequence    changes whenever any other field changes
+//   3 green
+//   4 red
+//   5 blue
+//   6 brightness  0-255, applied to the color by the scanner
+//   7 effect      TAG_EFFECT_*
+//   8 tx_power    dBm, only present with TAG_PAYLOAD_FLAG_TX_POWER
+//
+// With TAG_PAYLOAD_FLAG_AUTH the payload ends with a signature, see tag_auth.h:
+//
+//   counter       4 bytes, little endian, increases with every new state
+//   mac           TAG_PAYLOAD_MAC_LENGTH bytes
+//
+// With TAG_PAYLOAD_FLAG_TIME the tag's clock follows, see timebase.h:
+//
+//   time          4 bytes, little endian, ms. Restamped and signed again for
+//                 every advert, which makes each advert newer than the last
+//                 under the same counter. It and the MAC are left out of the
+//                 advert cache's hash
+//
+// Scanners only need byte 2 to tell a repeat from a new state.
+
+// 2: the time is signed
+#define TAG_PAYLOAD_VERSION 2
+
+#define TAG_PAYLOAD_FLAG_TX_POWER (1 << 0)
+#define TAG_PAYLOAD_FLAG_AUTH (1 << 1)
+#define TAG_PAYLOAD_FLAG_TIME (1 << 2)
+
+#define TAG_PAYLOAD_COUNTER_LENGTH 4
+#define TAG_PAYLOAD_MAC_LENGTH 4
+#define TAG_PAYLOAD_TIME_LENGTH 4
+
+#define TAG_PAYLOAD_MIN_LENGTH 8
+#define TAG_PAYLOAD_MAX_LENGTH (9 + TAG_PAYLOAD_COUNTER_LENGTH + TAG_PAYLOAD_MAC_LENGTH + TAG_PAYLOAD_TIME_LENGTH)
+
+// Lab11 company identifier, as used by simple_ble
+#define TAG_COMPANY_ID 0x02E0
+
+// How often an idle tag advertises, see adv_scheduler.h. color_scan forgets
+// a tag after DEVICE_TTL_MS (1500 ms) without adverts
+#ifndef ADV_IDLE_INTERVAL_MS
+#define ADV_IDLE_INTERVAL_MS 1000
+#endif
+// Random delay the controller adds to every advertising interval
+#define ADV_RANDOM_DELAY_MS 10
+
+typedef enum
+{
+  TAG_EFFECT_SOLID = 0,
+  TAG_EFFECT_BLINK = 1,
+  TAG_EFFECT_BREATHE = 2,
+} tag_effect_t;
+
+typedef struct
+{
+  uint8_t flags;
+  uint8_t sequence;
+  uint8_t green;
+  uint8_t red;
+  uint8_t blue;
+  uint8_t brightness;
+  uint8_t effect;
+  int8_t tx_power;
+  uint32_t counter; // only sent with TAG_PAYLOAD_FLAG_AUTH
+  uint32_t time_ms; // only sent with TAG_PAYLOAD_FLAG_TIME
+} tag_state_t;
+
+// Writes the payload for `state` into buf (at least TAG_PAYLOAD_MAX_LENGTH
+// bytes) and returns its length. The MAC of a signed payload is left zeroed
+// for tag_auth_sign()
+uint8_t tag_payload_encode(tag_state_t const *state, uint8_t *buf);
+
+// Finds the tag payload in raw advertising data. Returns false if the advert
+// has no manufacturer data from TAG_COMPANY_ID
+bool tag_payload_find(uint8_t const *adv_data, uint16_t adv_length, uint8_t const **payload, uint8_t *length);
+
+// Checks the payload and reads just the sequence number. Returns false for an
+// unknown version or a short payload, in which case decoding would fail too
+bool tag_payload_peek_sequence(uint8_t const *payload, uint8_t length, uint8_t *sequence);
+
+// Bytes of a valid payload that stay the same between adverts of one state:
+// everything before the MAC and the time
+uint8_t tag_payload_stable_length(uint8_t const *payload, uint8_t length);
+
+// Reads the time of a valid payload. Returns false if it has none
+bool tag_payload_peek_time(uint8_t const *payload, uint8_t length, uint32_t *time_ms);
+
+// Overwrites the time of a payload produced by tag_payload_encode()
+void tag_payload_stamp_time(uint8_t *payload, uint32_t time_ms);
+
+// Returns false for an unknown version or a short payload
+bool tag_payload_decode(uint8_t const *payload, uint8_t length, tag_state_t *state);
+
@@ -0,0 +1,102 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_timer.h"
+#include "app_util_platform.h"
+
+#include "timebase.h"
+
+typedef struct neighbour_clock
+{
+  bool valid;
+  uint16_t id;
+  int32_t offset_ms; // remote - local, from the last window
+  int32_t window_offset_ms;
+  bool window_valid;
+  uint32_t window_start_ms;
+  uint32_t last_heard_ms;
+} neighbour_clock_t;
+
+static neighbour_clock_t neighbours[TIMEBASE_MAX_DEVICES];
+static uint16_t own_id = 0xFFFF;
+
+static uint32_t last_counter = 0;
+static uint64_t elapsed_ticks = 0;
+
+void timebase_init(uint16_t id)
+{
+  own_id = id;
+  last_counter = app_timer_cnt_get();
+  elapsed_ticks = 0;
+}
+
+uint32_t timebase_local_ms(void)
+{
+  uint64_t ticks;
+
+  // called from both the radio notification and app_timer handlers
+  CRITICAL_REGION_ENTER();
+  uint32_t now = app_timer_cnt_get();
+  elapsed_ticks += app_timer_cnt_diff_compute(now, last_counter);
+  last_counter = now;
+  ticks = elapsed_ticks;
+  CRITICAL_REGION_EXIT();
+
+  return ticks * 1000 / APP_TIMER_CLOCK_FREQ;
+}
+
+void timebase_sample(uint8_t index, uint16_t id, uint32_t remote_ms, uint32_t rx_ms)
+{
+  neighbour_clock_t *clock = &neighbours[index];
+  // positive: the remote clock is ahead by that much, less the delays
+  int32_t offset_ms = (int32_t)(remote_ms - rx_ms);
+
+  if (!clock->valid || clock->id != id || (int32_t)(rx_ms - clock->last_heard_ms) > TIMEBASE_TIMEOUT_MS)
+  {
+    // first sample, or the tag was gone long enough that it may have rebooted
+    clock->valid = true;
+    clock->id = id;
+    clock->offset_ms = offset_ms;
+    clock->window_valid = false;
+    clock->window_start_ms = rx_ms;
+  }
+  clock->last_heard_ms = rx_ms;
+
+  // delays make the remote clock look behind, so the largest offset is the best
+  if (offset_ms > clock->offset_ms)
+  {
+    clock->offset_ms = offset_ms;
+  }
+  if (!clock->window_valid || offset_ms > clock->window_offset_ms)
+  {
+    clock->window_offset_ms = offset_ms;
+    clock->window_valid = true;
+  }
+
+  // start over from this window's best, which lets the estimate drift down too
+  if (rx_ms - clock->window_start_ms >= TIMEBASE_WINDOW_MS)
+  {
+    clock->offset_ms = clock->window_offset_ms;
+    clock->window_valid = false;
+    clock->window_start_ms = rx_ms;
+  }
+}
+
+uint32_t timebase_group_ms(void)
+{
+  uint32_t now = timebase_local_ms();
+
+  neighbour_clock_t const *leader = NULL;
+  uint16_t leader_id = own_id;
+  for (uint8_t i = 0; i < TIMEBASE_MAX_DEVICES; i++)
+  {
+    neighbour_clock_t const *clock = &neighbours[i];
+    if (clock->valid && clock->id < leader_id && now - clock->last_heard_ms <= TIMEBASE_TIMEOUT_MS)
+    {
+      leader = clock;
+      leader_id = clock->id;
+    }
+  }
+
+  return leader == NULL ? now : now + leader->offset_ms;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Shared timebase
+//
+// Tags advertise their local clock (TAG_PAYLOAD_FLAG_TIME). For each tag, a
+// scanner tracks the offset from its own clock to the tag's: advertised time
+// minus receive time. Delays in the tag, on air and in the scanner only ever
+// make that difference smaller, so the largest one seen is the best
+// estimate. The maximum is taken over a window of TIMEBASE_WINDOW_MS and
+// restarted, so the estimate follows the drift between the two 32 kHz clocks.
+//
+// The group follows the clock of the lowest device id that has been heard
+// within TIMEBASE_TIMEOUT_MS, including this device if it advertises, which
+// gives every board in range the same group time to within a few ms.
+
+#define TIMEBASE_MAX_DEVICES 2
+#define TIMEBASE_WINDOW_MS 10000
+#define TIMEBASE_TIMEOUT_MS 3000
+
+// Starts the local clock. own_id is this board's device id if it advertises
+// its clock itself, or 0xFFFF if it only scans. app_timer_init() must be
+// called first
+void timebase_init(uint16_t own_id);
+
+// Milliseconds since timebase_init(). Follows app_timer's 24-bit counter, so
+// it has to be called at least every 512 s. Every advert sent or received
+// calls it; an idle gap longer than that drops 512 s, after which neighbours
+// re-estimate the offset within one window
+uint32_t timebase_local_ms(void);
+
+// Records an advert from device `index` (0 to TIMEBASE_MAX_DEVICES - 1) with
+// id `id` carrying its clock, received at local time rx_ms
+void timebase_sample(uint8_t index, uint16_t id, uint32_t remote_ms, uint32_t rx_ms);
+
+// Local time moved onto the group leader's clock
+uint32_t timebase_group_ms(void);
@@ -0,0 +1,127 @@
+// Color Peer app
+//
+// Every board is both a tag and a display: advertises its own color like
+// color_adv and mixes the colors of the peers it hears like color_scan
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "simple_ble.h"
+#include "pwm_driver.h"
+#include "device_registry.h"
+#include "tag_receiver.h"
+#include "tag_auth.h"
+#include "tag_payload.h"
+#include "adv_scheduler.h"
+#include "peer_scan.h"
+#include "timebase.h"
+#include "helpers.h"
+#include "kv_store.h"
+#include "app_timer.h"
+#include "deferred_log.h"
+#include "telemetry.h"
+#include "profile.h"
+#include "nrf52840dk.h"
+
+// Must be one of the ids in helpers.c, with a key in color_scan/tag_keys.h
+#ifndef PEER_DEVICE_ID
+#define PEER_DEVICE_ID 0xAABB
+#endif
+
+// Peers blink in step with the group, see timebase.h
+#define PEER_EFFECT TAG_EFFECT_BLINK
+
+// BLE configuration
+static simple_ble_config_t ble_config = {
+    // BLE address is c0:98:e5:4e:xx:xx
+    .platform_id = 0x4E,                                                // used as 4th octet in device BLE address
+    .device_id = PEER_DEVICE_ID,                                        // must be unique on each device you program!
+    .adv_name = "CS397/497",                                            // irrelevant, adverts only carry the tag payload
+    .adv_interval = MSEC_TO_UNITS(ADV_IDLE_INTERVAL_MS, UNIT_0_625_MS), // see adv_scheduler.h
+    .min_conn_interval = MSEC_TO_UNITS(500, UNIT_1_25_MS),              // irrelevant if advertising only
+    .max_conn_interval = MSEC_TO_UNITS(1000, UNIT_1_25_MS),             // irrelevant if advertising only
+};
+simple_ble_app_t *simple_ble_app;
+
+// Color each peer advertises, by device index
+static const color_t PEER_COLORS[DEVICE_COUNT] = {
+    {.red = 0x8F},
+    {.blue = 0x8F},
+};
+
+tag_state_t tag_state = {
+    .flags = TAG_PAYLOAD_FLAG_TX_POWER | TAG_PAYLOAD_FLAG_AUTH | TAG_PAYLOAD_FLAG_TIME,
+    .brightness = 255,
+    .effect = PEER_EFFECT,
+    .tx_power = 0, // SoftDevice default
+};
+
+APP_TIMER_DEF(rate_timer);
+const uint32_t RATE_MS = 1000;
+
+// Totals at the last report, for the per second rates
+uint32_t last_sent = 0;
+uint32_t last_heard[DEVICE_COUNT];
+
+// Callback handler for advertisement reception
+void ble_evt_adv_report(ble_evt_t const *p_ble_evt)
+{
+  PROFILE_BEGIN(ble_evt_adv_report);
+  tag_receiver_process(&(p_ble_evt->evt.gap_evt.params.adv_report));
+  PROFILE_END(ble_evt_adv_report);
+}
+
+void print_rates(void *context)
+{
+  adv_scheduler_stats_t schedule = adv_scheduler_stats();
+  tag_receiver_stats_t const *received = tag_receiver_stats();
+
+  printf("Sent %lu/s, received", schedule.adverts - last_sent);
+  last_sent = schedule.adverts;
+  for (uint8_t i = 0; i < DEVICE_COUNT; i++)
+  {
+    printf(" %lu/s", received->heard[i] - last_heard[i]);
+    last_heard[i] = received->heard[i];
+  }
+  printf("\n");
+}
+
+int main(void)
+{
+  uint8_t own_index = get_device_index(PEER_DEVICE_ID);
+
+  telemetry_init();
+  profile_init();
+  tag_auth_init();
+  tag_receiver_init();
+
+  printf("Board started. Initializing BLE: \n\n");
+  simple_ble_app = simple_ble_init(&ble_config);
+
+  app_timer_init();
+  timebase_init(PEER_DEVICE_ID);
+
+  // The registry draws the first frame from the restored state
+  kv_store_init();
+  pwm_init();
+  device_registry_init();
+
+  tag_state.green = PEER_COLORS[own_index].green;
+  tag_state.red = PEER_COLORS[own_index].red;
+  tag_state.blue = PEER_COLORS[own_index].blue;
+  adv_scheduler_start(&tag_state, own_index);
+  peer_scan_start();
+  printf("Peer %d advertising and scanning\n\n", own_index);
+
+  app_timer_create(&rate_timer, APP_TIMER_MODE_REPEATED, print_rates);
+  app_timer_start(rate_timer, APP_TIMER_TICKS(RATE_MS), NULL);
+
+  // go into low power mode
+  while (1)
+  {
+    deferred_log_process();
+    profile_poll();
+    power_manage();
+  }
+}
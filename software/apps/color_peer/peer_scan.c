@@ -0,0 +1,28 @@
+#include <stdint.h>
+
+#include "app_error.h"
+#include "ble_gap.h"
+#include "app_util.h"
+
+#include "peer_scan.h"
+
+static uint8_t scan_buffer_data[BLE_GAP_SCAN_BUFFER_MIN];
+static ble_data_t scan_buffer = {
+    .p_data = scan_buffer_data,
+    .len = BLE_GAP_SCAN_BUFFER_MIN,
+};
+
+static ble_gap_scan_params_t const scan_params = {
+    .active = 0,
+    .interval = MSEC_TO_UNITS(PEER_SCAN_INTERVAL_MS, UNIT_0_625_MS),
+    .window = MSEC_TO_UNITS(PEER_SCAN_WINDOW_MS, UNIT_0_625_MS),
+    .timeout = BLE_GAP_SCAN_TIMEOUT_UNLIMITED,
+    .scan_phys = BLE_GAP_PHY_1MBPS,
+    .filter_policy = BLE_GAP_SCAN_FP_ACCEPT_ALL,
+};
+
+void peer_scan_start(void)
+{
+  ret_code_t err_code = sd_ble_gap_scan_start(&scan_params, &scan_buffer);
+  APP_ERROR_CHECK(err_code);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+// Peer scanning
+//
+// A peer advertises and scans at once. With a scan window as long as the
+// scan interval the scanner wants the radio all the time, and the SoftDevice
+// has to cut into scan windows or skip advertising events to fit both. A
+// shorter window leaves a gap in every interval, which the advertiser can
+// take without either side losing out. Windows are timed by the SoftDevice,
+// so duty cycling costs no CPU wakeups.
+
+#define PEER_SCAN_INTERVAL_MS 100
+#define PEER_SCAN_WINDOW_MS 70
+
+// Starts passive scanning with the duty cycle above. simple_ble resumes the
+// scan after each report, which keeps these parameters
+void peer_scan_start(void);
@@ -0,0 +1,114 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "app_timer.h"
+
+#include "adv_cache.h"
+
+#define WINDOW_TICKS APP_TIMER_TICKS(ADV_CACHE_WINDOW_MS)
+
+typedef struct adv_cache_entry
+{
+  uint8_t addr[6];
+  int8_t rssi;
+  bool in_use;
+  uint8_t tail_length;
+  uint8_t tail[ADV_CACHE_TAIL_LENGTH]; // the bytes after the stable part, as accepted
+  uint32_t hash;
+  uint32_t last_seen_ticks;
+} adv_cache_entry_t;
+
+static adv_cache_entry_t entries[ADV_CACHE_SIZE];
+static adv_cache_stats_t stats;
+
+// FNV-1a
+static uint32_t hash_payload(uint8_t const *data, uint16_t length)
+{
+  uint32_t hash = 2166136261u;
+  for (uint16_t i = 0; i < length; i++)
+  {
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  return hash;
+}
+
+static uint16_t tail_length(uint16_t stable_length, uint16_t length)
+{
+  uint16_t after_stable = length > stable_length ? length - stable_length : 0;
+  return after_stable < ADV_CACHE_TAIL_LENGTH ? after_stable : ADV_CACHE_TAIL_LENGTH;
+}
+
+static adv_cache_entry_t *find_entry(uint8_t const *addr, uint32_t hash)
+{
+  for (uint8_t i = 0; i < ADV_CACHE_SIZE; i++)
+  {
+    adv_cache_entry_t *entry = &entries[i];
+    if (entry->in_use && entry->hash == hash && memcmp(entry->addr, addr, sizeof(entry->addr)) == 0)
+    {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+bool adv_cache_check(uint8_t const *addr, uint8_t const *data, uint16_t stable_length, uint16_t length, int8_t rssi,
+                     uint32_t now_ticks)
+{
+  adv_cache_entry_t *entry = find_entry(addr, hash_payload(data, stable_length));
+  uint16_t tail = tail_length(stable_length, length);
+  if (entry != NULL && app_timer_cnt_diff_compute(now_ticks, entry->last_seen_ticks) <= WINDOW_TICKS &&
+      entry->tail_length == tail && memcmp(entry->tail, &data[stable_length], tail) == 0)
+  {
+    entry->rssi = rssi;
+    entry->last_seen_ticks = now_ticks;
+    stats.hits++;
+    return true;
+  }
+
+  stats.misses++;
+  return false;
+}
+
+void adv_cache_add(uint8_t const *addr, uint8_t const *data, uint16_t stable_length, uint16_t length, int8_t rssi,
+                   uint32_t now_ticks)
+{
+  uint32_t hash = hash_payload(data, stable_length);
+  adv_cache_entry_t *entry = find_entry(addr, hash);
+
+  if (entry == NULL)
+  {
+    // New (address, payload) pair replaces a free or the least recently seen entry
+    entry = &entries[0];
+    uint32_t oldest_age = 0;
+    for (uint8_t i = 0; i < ADV_CACHE_SIZE; i++)
+    {
+      if (!entries[i].in_use)
+      {
+        entry = &entries[i];
+        break;
+      }
+
+      uint32_t age = app_timer_cnt_diff_compute(now_ticks, entries[i].last_seen_ticks);
+      if (age > oldest_age)
+      {
+        entry = &entries[i];
+        oldest_age = age;
+      }
+    }
+
+    memcpy(entry->addr, addr, sizeof(entry->addr));
+    entry->hash = hash;
+    entry->in_use = true;
+  }
+
+  entry->tail_length = tail_length(stable_length, length);
+  memcpy(entry->tail, &data[stable_length], entry->tail_length);
+  entry->rssi = rssi;
+  entry->last_seen_ticks = now_ticks;
+}
+
+adv_cache_stats_t adv_cache_stats(void)
+{
+  return stats;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tag_payload.h"
+
+// Duplicate advert suppression
+//
+// A tag's advert is heard once per primary advertising channel, and an
+// unchanged tag repeats the same payload every interval. The cache remembers
+// recently seen (address, payload hash) pairs so repeats can skip decoding,
+// color comparison and redraw and only refresh presence.
+//
+// A signed timed payload changes its time and MAC every advertising event,
+// so those are left out of the hash and kept in the entry as the tail
+// accepted last. Only an exact copy of that is a hit; a new tail has to be
+// verified again, and a forged one can't pass as a copy.
+
+#define ADV_CACHE_SIZE 16
+// Longest tail kept: the MAC and time, longer tails compare by these bytes
+#define ADV_CACHE_TAIL_LENGTH (TAG_PAYLOAD_MAC_LENGTH + TAG_PAYLOAD_TIME_LENGTH)
+// Entries older than this are treated as new adverts again. A scanner often
+// hears one copy per advertising event, so the window spans two idle
+// intervals: the next event comes an interval plus the random delay later
+#define ADV_CACHE_WINDOW_MS (2 * ADV_IDLE_INTERVAL_MS)
+#if ADV_CACHE_WINDOW_MS <= ADV_IDLE_INTERVAL_MS + ADV_RANDOM_DELAY_MS
+#error "ADV_CACHE_WINDOW_MS must outlast an idle interval"
+#endif
+
+typedef struct
+{
+  uint32_t hits;
+  uint32_t misses;
+} adv_cache_stats_t;
+
+// Returns true if the same payload, its first stable_length bytes hashed and
+// the rest compared with the accepted tail, was seen from this address within
+// the window, refreshing the entry's RSSI and time
+bool adv_cache_check(uint8_t const *addr, uint8_t const *data, uint16_t stable_length, uint16_t length, int8_t rssi,
+                     uint32_t now_ticks);
+
+// Records an advert once it has been accepted, so that adverts which failed
+// authentication never become cache hits. An entry with the same stable part
+// takes the new tail
+void adv_cache_add(uint8_t const *addr, uint8_t const *data, uint16_t stable_length, uint16_t length, int8_t rssi,
+                   uint32_t now_ticks);
+
+adv_cache_stats_t adv_cache_stats(void);
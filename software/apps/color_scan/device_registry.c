@@ -0,0 +1,260 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "app_timer.h"
+
+#include "device_registry.h"
+#include "helpers.h"
+#include "kv_store.h"
+#include "latency.h"
+#include "presence.h"
+#include "profile.h"
+#include "timebase.h"
+
+APP_TIMER_DEF(device_1_ttl_timer);
+APP_TIMER_DEF(device_2_ttl_timer);
+static app_timer_id_t device_ttl_timers[DEVICE_COUNT] = {device_1_ttl_timer, device_2_ttl_timer};
+
+// One timer for every fade-in and effect, see device_registry.h
+APP_TIMER_DEF(frame_timer);
+static uint32_t frame_group_ms; // group time the scheduled frame is for
+
+typedef struct animation_state
+{
+  uint8_t device_id;
+  float brightness;
+  uint8_t is_undimming;
+  tag_effect_t effect;
+} animation_state_t;
+
+static animation_state_t animation_states[DEVICE_COUNT];
+
+static color_t actual_device_color[DEVICE_COUNT];
+
+// What the store keeps of each device, restored by device_registry_init()
+typedef struct
+{
+  uint32_t color; // color_t.val
+  uint8_t effect;
+  uint8_t present; // shown, not yet dimmed out
+  uint8_t reserved[2];
+} stored_device_t;
+
+static void store_device(uint8_t device_id, uint8_t present)
+{
+  stored_device_t stored = {
+      .color = actual_device_color[device_id].val,
+      .effect = animation_states[device_id].effect,
+      .present = present,
+  };
+  kv_store_set(KV_KEY_REGISTRY_DEVICE + device_id, &stored, sizeof(stored));
+}
+
+// Brightness (in percent) an effect gives at time t in the group timebase
+static float effect_level(tag_effect_t effect, uint32_t t)
+{
+  switch (effect)
+  {
+  case TAG_EFFECT_BLINK:
+    return t % DEVICE_BLINK_PERIOD_MS < DEVICE_BLINK_PERIOD_MS / 2 ? 100.0 : 0.0;
+  case TAG_EFFECT_BREATHE:
+  {
+    uint32_t phase = t % DEVICE_BREATHE_PERIOD_MS;
+    uint32_t half = DEVICE_BREATHE_PERIOD_MS / 2;
+    return 100.0 * (phase < half ? phase : DEVICE_BREATHE_PERIOD_MS - phase) / half;
+  }
+  default:
+    return 100.0;
+  }
+}
+
+static color_t calculate_combined_color(uint32_t group_ms)
+{
+  color_t final_color;
+  final_color.val = 0x00;
+
+  // add up every device, saturating each channel
+  uint16_t green = 0, red = 0, blue = 0;
+  for (uint8_t i = 0; i < DEVICE_COUNT; i++)
+  {
+    animation_state_t const *state = &animation_states[i];
+    float brightness = state->brightness * effect_level(state->effect, group_ms) / 100.0;
+    color_t color = make_color_of_brightness(actual_device_color[i], brightness);
+
+    green += color.green;
+    red += color.red;
+    blue += color.blue;
+  }
+
+  final_color.green = green > 255 ? 255 : green;
+  final_color.red = red > 255 ? 255 : red;
+  final_color.blue = blue > 255 ? 255 : blue;
+
+  return final_color;
+}
+
+// Time between the frames the devices need right now, 0 if none
+static uint32_t frame_period_ms(void)
+{
+  uint32_t period_ms = 0;
+  for (uint8_t i = 0; i < DEVICE_COUNT; i++)
+  {
+    animation_state_t const *state = &animation_states[i];
+    uint32_t device_period_ms = 0;
+
+    if (state->is_undimming || (state->effect == TAG_EFFECT_BREATHE && state->brightness > 0.0))
+    {
+      device_period_ms = DEVICE_ANIMATION_MS;
+    }
+    else if (state->effect == TAG_EFFECT_BLINK && state->brightness > 0.0)
+    {
+      // only the on and off edges change anything
+      device_period_ms = DEVICE_BLINK_PERIOD_MS / 2;
+    }
+
+    if (device_period_ms && (!period_ms || device_period_ms < period_ms))
+    {
+      period_ms = device_period_ms;
+    }
+  }
+  return period_ms;
+}
+
+// Starts the frame timer for the next multiple of the frame period in group
+// time, so every board draws its frames at the same moments
+static void schedule_frame(void)
+{
+  app_timer_stop(frame_timer);
+
+  uint32_t period_ms = frame_period_ms();
+  if (!period_ms)
+  {
+    return;
+  }
+
+  uint32_t now_ms = timebase_group_ms();
+  frame_group_ms = now_ms - now_ms % period_ms + period_ms;
+  if (APP_TIMER_TICKS(frame_group_ms - now_ms) < APP_TIMER_MIN_TIMEOUT_TICKS)
+  {
+    frame_group_ms += period_ms;
+  }
+  app_timer_start(frame_timer, APP_TIMER_TICKS(frame_group_ms - now_ms), NULL);
+}
+
+static void draw_frame(void *context)
+{
+  PROFILE_BEGIN(draw_frame);
+  for (uint8_t i = 0; i < DEVICE_COUNT; i++)
+  {
+    animation_state_t *state = &animation_states[i];
+    if (!state->is_undimming)
+    {
+      continue;
+    }
+
+    state->brightness = fmin(100.0, state->brightness + DEVICE_ANIMATION_STEP); // increase brightness
+    if (state->brightness == 100.0)
+    {
+      state->is_undimming = 0;
+    }
+  }
+
+  // drawn for the time it was scheduled for, the timer may fire a tick early
+  display_color(calculate_combined_color(frame_group_ms));
+  schedule_frame();
+  PROFILE_END(draw_frame);
+}
+
+static void dim_device(void *animation_state_ptr)
+{
+  PROFILE_BEGIN(dim_device);
+  animation_state_t *state = (animation_state_t *)animation_state_ptr;
+  uint8_t device_id = state->device_id;
+
+  state->is_undimming = 0;
+
+  float brightness = state->brightness;                               // read
+  brightness = fmax(0.0, brightness - (DEVICE_ANIMATION_STEP + 5)); // update: reduce brightness
+  state->brightness = brightness;                                     // write back
+
+  display_color(calculate_combined_color(timebase_group_ms()));
+
+  if (brightness == 0.0)
+  {
+    app_timer_stop(device_ttl_timers[device_id]);
+    presence_left(device_id);
+    store_device(device_id, 0);
+  }
+  PROFILE_END(dim_device);
+}
+
+void device_registry_init(void)
+{
+  for (uint8_t i = 0; i < DEVICE_COUNT; i++)
+  {
+    animation_states[i].device_id = i;
+    animation_states[i].effect = TAG_EFFECT_SOLID;
+
+    app_timer_create(&device_ttl_timers[i], APP_TIMER_MODE_REPEATED, dim_device);
+  }
+  app_timer_create(&frame_timer, APP_TIMER_MODE_SINGLE_SHOT, draw_frame);
+  pwm_set_frame_handlers(latency_frame_started, latency_frame_shown);
+
+  // Devices shown before a reset are shown again straight away, and dim out
+  // as usual unless their tags are heard
+  for (uint8_t i = 0; i < DEVICE_COUNT; i++)
+  {
+    stored_device_t stored;
+    if (!kv_store_get(KV_KEY_REGISTRY_DEVICE + i, &stored, sizeof(stored)))
+    {
+      continue;
+    }
+    actual_device_color[i].val = stored.color;
+    animation_states[i].effect = stored.effect;
+    if (stored.present)
+    {
+      animation_states[i].brightness = 100.0;
+      app_timer_start(device_ttl_timers[i], APP_TIMER_TICKS(DEVICE_TTL_MS), &animation_states[i]);
+    }
+  }
+
+  // The first frame
+  display_color(calculate_combined_color(timebase_group_ms()));
+  schedule_frame();
+}
+
+void device_registry_keep_alive(uint8_t device_id)
+{
+  // Undims the device when it comes back
+  PROFILE_BEGIN(device_keep_alive);
+  animation_state_t *animation_state = &animation_states[device_id];
+
+  app_timer_stop(device_ttl_timers[device_id]);
+  presence_seen(device_id);
+
+  if (!animation_state->is_undimming && animation_state->brightness < 100.0)
+  {
+    // start the undimming process if the light has not yet fully undimmed upon entry
+    animation_state->is_undimming = 1;
+    animation_state->brightness = fmin(100.0, animation_state->brightness + DEVICE_ANIMATION_STEP);
+    store_device(device_id, 1);
+    latency_state_updated();
+    display_color(calculate_combined_color(timebase_group_ms()));
+    schedule_frame();
+  }
+
+  app_timer_start(device_ttl_timers[device_id], APP_TIMER_TICKS(DEVICE_TTL_MS), animation_state);
+  PROFILE_END(device_keep_alive);
+}
+
+void device_registry_set_color(uint8_t device_id, color_t color, tag_effect_t effect)
+{
+  actual_device_color[device_id] = color;
+  animation_states[device_id].effect = effect;
+  store_device(device_id, animation_states[device_id].brightness > 0.0 || animation_states[device_id].is_undimming);
+
+  latency_state_updated();
+  display_color(calculate_combined_color(timebase_group_ms()));
+  schedule_frame();
+}
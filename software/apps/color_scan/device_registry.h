@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "pwm_driver.h"
+#include "tag_payload.h"
+
+// Device registry
+//
+// Tracks the tags in range. A tag fades in while it's heard and fades out
+// once it hasn't been for DEVICE_TTL_MS, and the colors of all tags are
+// mixed onto the strip. Devices are numbered like get_device_index().
+//
+// Fade-ins and tag effects share a single frame timer, which only runs while
+// something is animating. Frames fall on multiples of DEVICE_ANIMATION_MS in
+// the group timebase (timebase.h), so boards that share it blink together.
+//
+// Each device's color, effect and whether it's shown are kept in the
+// kv_store, so after a reset the strip comes back as it was.
+
+#define DEVICE_COUNT 2
+#define DEVICE_TTL_MS 1500
+#define DEVICE_ANIMATION_MS 100
+#define DEVICE_ANIMATION_STEP 10 // how much (in percent) the brightness changes in each frame of animation
+
+// Effect periods, multiples of DEVICE_ANIMATION_MS
+#define DEVICE_BLINK_PERIOD_MS 1000
+#define DEVICE_BREATHE_PERIOD_MS 2000
+
+// Creates the animation timers, restores the devices and draws the first
+// frame. app_timer_init(), kv_store_init() and timebase_init() must be
+// called first
+void device_registry_init(void);
+
+// Restarts a device's TTL, fading it back in if it had started to dim
+void device_registry_keep_alive(uint8_t device_id);
+
+// Sets the color a device shows at full brightness and its effect, and redraws
+void device_registry_set_color(uint8_t device_id, color_t color, tag_effect_t effect);
@@ -0,0 +1,131 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_util_platform.h"
+#include "nrf.h"
+
+#include "latency.h"
+
+#define CYCLES_PER_US 64
+
+// A frame that never reports back is given up on after this long
+#define TRACE_TIMEOUT_CYCLES (1000000 * CYCLES_PER_US)
+
+// Stages the followed advert has reached
+typedef enum
+{
+  TRACE_IDLE,
+  TRACE_RECEIVED,
+  TRACE_UPDATED,
+  TRACE_STARTED,
+} trace_state_t;
+
+static trace_state_t trace = TRACE_IDLE;
+static uint32_t received_cycles;
+static uint32_t updated_cycles;
+static uint32_t started_cycles;
+
+static latency_histogram_t histograms[LATENCY_STAGE_COUNT];
+
+static void record(latency_stage_t stage, uint32_t from_cycles, uint32_t to_cycles)
+{
+  latency_histogram_t *histogram = &histograms[stage];
+  uint32_t us = (to_cycles - from_cycles) / CYCLES_PER_US;
+
+  uint32_t bin = 31 - __builtin_clz(us | 1);
+  if (bin >= LATENCY_HISTOGRAM_BINS)
+  {
+    bin = LATENCY_HISTOGRAM_BINS - 1;
+  }
+  if (histogram->histogram[bin] < UINT16_MAX)
+  {
+    histogram->histogram[bin]++;
+  }
+
+  histogram->count++;
+  histogram->total_us += us;
+  if (us > histogram->max_us)
+  {
+    histogram->max_us = us;
+  }
+}
+
+void latency_adv_received(void)
+{
+  CRITICAL_REGION_ENTER();
+  // An advert that has changed the state is followed until it's shown
+  if (trace <= TRACE_RECEIVED || DWT->CYCCNT - received_cycles > TRACE_TIMEOUT_CYCLES)
+  {
+    received_cycles = DWT->CYCCNT;
+    trace = TRACE_RECEIVED;
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+void latency_state_updated(void)
+{
+  CRITICAL_REGION_ENTER();
+  if (trace == TRACE_RECEIVED)
+  {
+    updated_cycles = DWT->CYCCNT;
+    trace = TRACE_UPDATED;
+    record(LATENCY_STAGE_PROCESS, received_cycles, updated_cycles);
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+void latency_frame_started(void)
+{
+  CRITICAL_REGION_ENTER();
+  if (trace == TRACE_UPDATED)
+  {
+    started_cycles = DWT->CYCCNT;
+    trace = TRACE_STARTED;
+    record(LATENCY_STAGE_SCHEDULE, updated_cycles, started_cycles);
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+void latency_frame_shown(void)
+{
+  CRITICAL_REGION_ENTER();
+  if (trace == TRACE_STARTED)
+  {
+    uint32_t shown_cycles = DWT->CYCCNT;
+    trace = TRACE_IDLE;
+    record(LATENCY_STAGE_PLAYBACK, started_cycles, shown_cycles);
+    record(LATENCY_STAGE_TOTAL, received_cycles, shown_cycles);
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+latency_histogram_t const *latency_histograms(void)
+{
+  return histograms;
+}
+
+void latency_print(void)
+{
+  static char const *const STAGE_NAMES[LATENCY_STAGE_COUNT] = {"process", "schedule", "playback", "total"};
+
+  for (uint8_t stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+  {
+    latency_histogram_t histogram;
+    CRITICAL_REGION_ENTER();
+    histogram = histograms[stage];
+    CRITICAL_REGION_EXIT();
+
+    uint32_t mean_us = histogram.count ? histogram.total_us / histogram.count : 0;
+    printf("Latency %-8s %lu, mean %lu us, max %lu us:", STAGE_NAMES[stage], histogram.count, mean_us,
+           histogram.max_us);
+    for (uint8_t bin = 0; bin < LATENCY_HISTOGRAM_BINS; bin++)
+    {
+      if (histogram.histogram[bin])
+      {
+        printf(" <2^%d:%u", bin + 1, histogram.histogram[bin]);
+      }
+    }
+    printf("\n");
+  }
+}
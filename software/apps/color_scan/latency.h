@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+// Advert to light latency
+//
+// Times how long a tag's advert takes to show on the strip, in stages:
+//
+//   advert received  tag_receiver_process() starts on the advert
+//   state updated    the registry changes what a device shows
+//   frame started    the strip driver starts playing the new frame out
+//   frame shown      the PWM reports the frame played out, the strip latches
+//
+// Only one advert is followed at a time: each new advert restarts the
+// measurement until one of them changes the state, and that one is followed
+// to the strip. Adverts that change nothing aren't counted.
+//
+// Times come from the DWT cycle counter, which telemetry_init() starts. The
+// host replay build drives the same counter on simulated time.
+
+typedef enum
+{
+  LATENCY_STAGE_PROCESS,  // advert received to state updated
+  LATENCY_STAGE_SCHEDULE, // state updated to frame started
+  LATENCY_STAGE_PLAYBACK, // frame started to frame shown
+  LATENCY_STAGE_TOTAL,    // advert received to frame shown
+  LATENCY_STAGE_COUNT,
+} latency_stage_t;
+
+// Bin i counts latencies of 2^i to 2^(i+1) - 1 us, bin 0 also counts 0 and
+// the last bin everything longer
+#define LATENCY_HISTOGRAM_BINS 20
+
+// Also the layout of the BLE characteristic, one per stage, little endian
+typedef struct
+{
+  uint32_t count;
+  uint32_t total_us;
+  uint32_t max_us;
+  uint16_t histogram[LATENCY_HISTOGRAM_BINS]; // saturate at 0xFFFF
+} latency_histogram_t;
+
+// Stage hooks, safe from any application interrupt priority
+void latency_adv_received(void);
+void latency_state_updated(void);
+void latency_frame_started(void);
+void latency_frame_shown(void);
+
+// One histogram per latency_stage_t, updated in place
+latency_histogram_t const *latency_histograms(void);
+
+// Prints every stage over RTT
+void latency_print(void);
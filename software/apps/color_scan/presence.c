@@ -0,0 +1,125 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "nrf.h"
+
+#include "presence.h"
+#include "tag_receiver.h"
+#include "timebase.h"
+
+// Weight of a new advert in the RSSI average, as 1/2^n
+#define AVERAGE_SHIFT 3
+
+typedef struct
+{
+  volatile uint32_t sequence; // odd while the record is being written
+  presence_counters_t counters; // dwell_ms only counts finished visits
+  int16_t average_rssi_x16;
+  uint8_t visiting;
+  uint32_t visit_start_ms;
+  uint32_t last_seen_ms;
+} presence_record_t;
+
+static presence_record_t records[DEVICE_COUNT];
+
+static void write_begin(presence_record_t *record)
+{
+  record->sequence++;
+  __DMB();
+}
+
+static void write_end(presence_record_t *record)
+{
+  __DMB();
+  record->sequence++;
+}
+
+void presence_advert(uint8_t device_id, int8_t rssi)
+{
+  presence_record_t *record = &records[device_id];
+  write_begin(record);
+
+  presence_counters_t *counters = &record->counters;
+  if (counters->adverts == 0)
+  {
+    record->average_rssi_x16 = rssi * 16;
+  }
+  else
+  {
+    record->average_rssi_x16 += (rssi * 16 - record->average_rssi_x16) >> AVERAGE_SHIFT;
+  }
+  counters->adverts++;
+  counters->last_rssi = rssi;
+  counters->average_rssi = (record->average_rssi_x16 + 8) >> 4;
+  if (rssi < TAG_RECEIVER_MIN_RSSI)
+  {
+    counters->rejected_rssi++;
+  }
+
+  write_end(record);
+}
+
+void presence_seen(uint8_t device_id)
+{
+  presence_record_t *record = &records[device_id];
+  uint32_t now_ms = timebase_local_ms();
+  write_begin(record);
+
+  if (!record->visiting)
+  {
+    record->visiting = 1;
+    record->visit_start_ms = now_ms;
+    record->counters.visits++;
+  }
+  record->last_seen_ms = now_ms;
+
+  write_end(record);
+}
+
+void presence_left(uint8_t device_id)
+{
+  presence_record_t *record = &records[device_id];
+  write_begin(record);
+
+  if (record->visiting)
+  {
+    record->visiting = 0;
+    record->counters.dwell_ms += record->last_seen_ms - record->visit_start_ms;
+  }
+
+  write_end(record);
+}
+
+void presence_snapshot(presence_counters_t *counters)
+{
+  for (uint8_t i = 0; i < DEVICE_COUNT; i++)
+  {
+    presence_record_t const *record = &records[i];
+    uint32_t sequence;
+    do
+    {
+      sequence = record->sequence;
+      __DMB();
+      counters[i] = record->counters;
+      if (record->visiting)
+      {
+        counters[i].dwell_ms += record->last_seen_ms - record->visit_start_ms;
+      }
+      __DMB();
+    } while ((sequence & 1) || sequence != record->sequence);
+  }
+}
+
+void presence_print(void)
+{
+  presence_counters_t counters[DEVICE_COUNT];
+  presence_snapshot(counters);
+
+  for (uint8_t i = 0; i < DEVICE_COUNT; i++)
+  {
+    printf("Device %d: %lu adverts, %lu too weak, RSSI %d dBm (mean %d), %u visits, %lu ms in range\n", i,
+           counters[i].adverts, counters[i].rejected_rssi, counters[i].last_rssi, counters[i].average_rssi,
+           counters[i].visits, counters[i].dwell_ms);
+  }
+}
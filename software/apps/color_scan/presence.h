@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "device_registry.h"
+
+// Per-device presence
+//
+// Counts what each tag has done in range, which the registry forgets once a
+// device has faded out. Every advert heard from a known tag is counted, along
+// with the ones too weak to keep it shown (TAG_RECEIVER_MIN_RSSI). A visit
+// starts when the registry fades a device in from dark and ends when the TTL
+// timer has dimmed it all the way out. Dwell adds up, over every visit, the
+// time from the advert that started it to the last one that kept it alive.
+//
+// Updates are O(1) and come from the adv path and the TTL timers. Each
+// device's record carries a sequence count that is odd while it's being
+// written, so presence_snapshot() copies it without locks and takes it again
+// if a writer got in between.
+
+// Also the layout of the BLE characteristic, one per device, little endian
+typedef struct
+{
+  uint32_t adverts;       // heard from the tag
+  uint32_t rejected_rssi; // of those, too weak to keep it shown
+  uint32_t dwell_ms;      // over all visits, including the one under way
+  uint16_t visits;
+  int8_t last_rssi;    // dBm
+  int8_t average_rssi; // dBm, moving average over about the last 8 adverts
+} presence_counters_t;
+
+// Every advert heard from a known tag, before it's checked
+void presence_advert(uint8_t device_id, int8_t rssi);
+
+// The registry kept a device alive, starting a visit if it was dark
+void presence_seen(uint8_t device_id);
+
+// The registry dimmed a device out, ending its visit
+void presence_left(uint8_t device_id);
+
+// Copies every device's counters into DEVICE_COUNT entries. A snapshot
+// interrupted by a writer is taken again, so only call it from the main loop,
+// below every writer
+void presence_snapshot(presence_counters_t *counters);
+
+// Prints a snapshot over RTT, from the main loop too
+void presence_print(void);
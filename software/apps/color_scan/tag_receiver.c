@@ -0,0 +1,142 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_timer.h"
+
+#include "adv_cache.h"
+#include "deferred_log.h"
+#include "device_registry.h"
+#include "helpers.h"
+#include "latency.h"
+#include "presence.h"
+#include "tag_auth.h"
+#include "tag_keys.h"
+#include "tag_payload.h"
+#include "tag_receiver.h"
+#include "timebase.h"
+
+static tag_receiver_stats_t stats;
+
+// Longest time each tag went unheard, to check that color updates never silence its adverts
+static uint32_t last_heard_ticks[DEVICE_COUNT];
+
+// Sequence number of the last advert processed from each tag, see tag_payload.h
+static uint8_t last_sequence[DEVICE_COUNT];
+static uint8_t has_sequence[DEVICE_COUNT];
+
+static void track_silence(uint8_t device_id, uint32_t now)
+{
+  if (last_heard_ticks[device_id] != 0)
+  {
+    uint32_t silence_ms = (uint64_t)app_timer_cnt_diff_compute(now, last_heard_ticks[device_id]) * 1000 / APP_TIMER_CLOCK_FREQ;
+    if (silence_ms > stats.longest_silence_ms[device_id])
+    {
+      stats.longest_silence_ms[device_id] = silence_ms;
+      LOG("Device %d: longest silence %lu ms\n", device_id, silence_ms);
+    }
+  }
+  last_heard_ticks[device_id] = now;
+}
+
+static void sample_time(uint8_t device_id, uint16_t adv_id, uint8_t const *payload, uint8_t payload_length)
+{
+  uint32_t remote_ms;
+  if (tag_payload_peek_time(payload, payload_length, &remote_ms))
+  {
+    timebase_sample(device_id, adv_id, remote_ms, timebase_local_ms());
+  }
+}
+
+void tag_receiver_init(void)
+{
+  for (uint8_t i = 0; i < DEVICE_COUNT; i++)
+  {
+    tag_auth_set_key(i, TAG_KEYS[i]);
+  }
+}
+
+void tag_receiver_process(ble_gap_evt_adv_report_t const *adv_report)
+{
+  latency_adv_received();
+
+  // extract the fields we care about
+  uint8_t const *ble_addr = adv_report->peer_addr.addr; // array of 6 bytes of the address
+  uint8_t const *adv_buf = adv_report->data.p_data;     // array of up to 31 bytes of advertisement payload data
+  int8_t adv_rssi = adv_report->rssi;
+
+  uint16_t adv_id = (ble_addr[1] << 8) + ble_addr[0];
+  if (!has_known_id(adv_id))
+  {
+    return;
+  }
+
+  uint8_t device_id = get_device_index(adv_id);
+  uint32_t now = app_timer_cnt_get();
+  stats.heard[device_id]++;
+  presence_advert(device_id, adv_rssi);
+  track_silence(device_id, now);
+
+  uint8_t const *payload;
+  uint8_t payload_length;
+  uint8_t sequence;
+  if (!tag_payload_find(adv_buf, adv_report->data.len, &payload, &payload_length) ||
+      !tag_payload_peek_sequence(payload, payload_length, &sequence))
+  {
+    return;
+  }
+
+  // The time and its MAC change with every advertising event, so only the
+  // rest is hashed; the cache compares them with those last verified
+  uint8_t stable_length = tag_payload_stable_length(payload, payload_length);
+
+  // Copies of an advert already verified only keep the tag alive, without
+  // another MAC
+  if (adv_cache_check(ble_addr, payload, stable_length, payload_length, adv_rssi, now))
+  {
+    if (adv_rssi >= TAG_RECEIVER_MIN_RSSI)
+    {
+      device_registry_keep_alive(device_id);
+    }
+    return;
+  }
+
+  // Unsigned, forged or replayed adverts are dropped before they can touch
+  // any state
+  if (!tag_auth_verify(device_id, ble_addr, payload, payload_length))
+  {
+    return;
+  }
+  adv_cache_add(ble_addr, payload, stable_length, payload_length, adv_rssi, now);
+  sample_time(device_id, adv_id, payload, payload_length);
+
+  // A repeat of the last processed state only keeps the tag alive
+  uint8_t is_repeat = has_sequence[device_id] && sequence == last_sequence[device_id];
+
+  if (!is_repeat)
+  {
+    tag_state_t tag_state;
+    tag_payload_decode(payload, payload_length, &tag_state);
+    last_sequence[device_id] = sequence;
+    has_sequence[device_id] = 1;
+
+    color_t adv_color;
+    adv_color.val = 0x00;
+    adv_color.green = tag_state.green * tag_state.brightness / 255;
+    adv_color.red = tag_state.red * tag_state.brightness / 255;
+    adv_color.blue = tag_state.blue * tag_state.brightness / 255;
+    device_registry_set_color(device_id, adv_color, tag_state.effect);
+  }
+
+  // Tags further away still keep the group in time and their color up to
+  // date, but aren't shown
+  if (adv_rssi >= TAG_RECEIVER_MIN_RSSI)
+  {
+    device_registry_keep_alive(device_id);
+  }
+}
+
+tag_receiver_stats_t const *tag_receiver_stats(void)
+{
+  return &stats;
+}
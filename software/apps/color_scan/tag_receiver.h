@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ble_gap.h"
+
+#include "device_registry.h"
+
+// Tag advert pipeline
+//
+// Takes adverts from the scanner and hands the states of nearby known tags
+// to the device registry. Repeats are caught by the advert cache or the
+// payload's sequence number before anything is decoded, and only adverts
+// that pass authentication can change what is shown. Authenticated adverts
+// from known tags at any distance feed the timebase.
+
+#define TAG_RECEIVER_MIN_RSSI -48
+
+typedef struct
+{
+  uint32_t heard[DEVICE_COUNT];              // adverts from each tag, at any RSSI
+  uint32_t longest_silence_ms[DEVICE_COUNT]; // longest time each tag went unheard
+} tag_receiver_stats_t;
+
+// Loads the tag keys, tag_auth_init() must be called first
+void tag_receiver_init(void);
+
+void tag_receiver_process(ble_gap_evt_adv_report_t const *adv_report);
+
+tag_receiver_stats_t const *tag_receiver_stats(void);
@@ -0,0 +1,437 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "crc16.h"
+#include "nrf_fstorage.h"
+#include "nrf_fstorage_sd.h"
+
+#include "kv_store.h"
+
+#define PAGE_MAGIC 0x3153564B // "KVS1"
+#define NO_PAGE 0xFF
+
+typedef struct {
+  uint32_t sequence; // written first, so a page with the magic has all of it
+  uint32_t magic;
+} page_header_t;
+
+typedef struct {
+  uint8_t key;
+  uint8_t length;
+  uint16_t crc;
+} record_header_t;
+
+#define RECORD_SIZE(length) (sizeof(record_header_t) + (((length) + 3) & ~3u))
+
+typedef enum {
+  PAGE_ERASED,
+  PAGE_DATA,
+  PAGE_DIRTY, // neither erased nor holding a log, erased before anything else
+} page_state_t;
+
+typedef struct {
+  page_state_t state;
+  uint32_t sequence;
+} page_t;
+
+typedef struct {
+  uint8_t length; // 0 while the key has no value
+  uint8_t dirty;  // changed since its last record was written
+  uint8_t page;   // holding its newest record, NO_PAGE if none
+  uint8_t value[KV_STORE_MAX_VALUE];
+} entry_t;
+
+typedef enum {
+  OP_NONE,
+  OP_OPEN_PAGE,
+  OP_WRITE_RECORD,
+  OP_ERASE_PAGE,
+} op_t;
+
+static void fstorage_handler(nrf_fstorage_evt_t* evt);
+
+NRF_FSTORAGE_DEF(nrf_fstorage_t fstorage) = {
+  .evt_handler = fstorage_handler,
+  .start_addr = KV_STORE_START_ADDR,
+  .end_addr = KV_STORE_START_ADDR + KV_STORE_PAGES * KV_STORE_PAGE_SIZE - 1,
+};
+
+static entry_t entries[KV_STORE_MAX_KEYS];
+static page_t pages[KV_STORE_PAGES];
+static uint8_t head = NO_PAGE;    // page being appended to
+static uint32_t head_offset;      // where its next record goes
+static uint8_t reclaim = NO_PAGE; // oldest page, being emptied so it can be erased
+static uint32_t next_sequence = 1;
+
+// The flash operation under way. fstorage reads the source when it gets to
+// the operation, so what's written is kept here until it completes
+static volatile bool busy = false;
+static op_t op = OP_NONE;
+static uint8_t op_page;
+static uint8_t op_key;
+static uint32_t op_size;
+static page_header_t page_header_buffer;
+static uint32_t record_buffer[RECORD_SIZE(KV_STORE_MAX_VALUE) / 4];
+
+static kv_store_stats_t stats;
+
+APP_TIMER_DEF(flush_timer);
+static bool flush_pending = false;
+
+static void run(void);
+
+static uint32_t page_addr(uint8_t page) {
+  return KV_STORE_START_ADDR + page * KV_STORE_PAGE_SIZE;
+}
+
+static uint16_t record_crc(uint8_t key, uint8_t length, uint8_t const* value) {
+  uint8_t header[2] = {key, length};
+  uint16_t crc = crc16_compute(header, sizeof(header), NULL);
+  return crc16_compute(value, length, &crc);
+}
+
+static void read_flash(uint32_t addr, void* dest, uint32_t length) {
+  ret_code_t err_code = nrf_fstorage_read(&fstorage, addr, dest, length);
+  APP_ERROR_CHECK(err_code);
+}
+
+static bool is_erased(uint32_t addr, uint32_t length) {
+  uint32_t words[16];
+  while (length) {
+    uint32_t chunk = length < sizeof(words) ? length : sizeof(words);
+    read_flash(addr, words, chunk);
+    for (uint32_t i = 0; i < chunk / 4; i++) {
+      if (words[i] != 0xFFFFFFFF) {
+        return false;
+      }
+    }
+    addr += chunk;
+    length -= chunk;
+  }
+  return true;
+}
+
+// Loads a page's records into the entries, newer ones over older. Returns
+// where the log in the page ends
+static uint32_t replay_page(uint8_t page) {
+  uint32_t offset = sizeof(page_header_t);
+  while (offset + sizeof(record_header_t) <= KV_STORE_PAGE_SIZE) {
+    uint32_t addr = page_addr(page) + offset;
+    record_header_t header;
+    read_flash(addr, &header, sizeof(header));
+    if (header.key == 0xFF && header.length == 0xFF && header.crc == 0xFFFF) {
+      return offset;
+    }
+
+    uint32_t size = RECORD_SIZE(header.length);
+    if (header.key >= KV_STORE_MAX_KEYS || header.length == 0 || header.length > KV_STORE_MAX_VALUE ||
+        offset + size > KV_STORE_PAGE_SIZE) {
+      // A header torn by a reset hides where the next record starts, so
+      // nothing more goes in this page
+      stats.bad_records++;
+      return KV_STORE_PAGE_SIZE;
+    }
+
+    uint8_t value[KV_STORE_MAX_VALUE];
+    read_flash(addr + sizeof(header), value, header.length);
+    if (header.crc == record_crc(header.key, header.length, value)) {
+      entry_t* entry = &entries[header.key];
+      entry->length = header.length;
+      entry->page = page;
+      memcpy(entry->value, value, header.length);
+    } else {
+      stats.bad_records++;
+    }
+    offset += size;
+  }
+  return KV_STORE_PAGE_SIZE;
+}
+
+static void schedule_flush(void) {
+  bool start;
+  CRITICAL_REGION_ENTER();
+  start = !flush_pending;
+  flush_pending = true;
+  CRITICAL_REGION_EXIT();
+
+  if (start) {
+    ret_code_t err_code = app_timer_start(flush_timer, APP_TIMER_TICKS(KV_STORE_DELAY_MS), NULL);
+    APP_ERROR_CHECK(err_code);
+  }
+}
+
+static void flush(void* context) {
+  flush_pending = false;
+  run();
+}
+
+// An operation fstorage wouldn't take, e.g. with its queue full, is tried
+// again after the delay
+static bool started(ret_code_t err_code) {
+  if (err_code != NRF_SUCCESS) {
+    op = OP_NONE;
+    stats.failed++;
+    schedule_flush();
+    return false;
+  }
+  return true;
+}
+
+// Keeps a page erased. Once the last one is opened, the oldest page is
+// emptied: the values whose newest record is there are written again, then
+// it's erased
+static void keep_page_free(void) {
+  if (reclaim != NO_PAGE) {
+    return;
+  }
+
+  uint8_t oldest = NO_PAGE;
+  for (uint8_t page = 0; page < KV_STORE_PAGES; page++) {
+    if (pages[page].state != PAGE_DATA) {
+      return;
+    }
+    if (page != head && (oldest == NO_PAGE || pages[page].sequence < pages[oldest].sequence)) {
+      oldest = page;
+    }
+  }
+
+  reclaim = oldest;
+  for (uint8_t key = 0; key < KV_STORE_MAX_KEYS; key++) {
+    if (entries[key].page == oldest) {
+      entries[key].dirty = 1;
+    }
+  }
+}
+
+// Starts writing a header to the next erased page around the ring
+static bool open_page(void) {
+  uint8_t first = head == NO_PAGE ? 0 : head + 1;
+  for (uint8_t i = 0; i < KV_STORE_PAGES; i++) {
+    uint8_t page = (first + i) % KV_STORE_PAGES;
+    if (pages[page].state == PAGE_ERASED) {
+      page_header_buffer.sequence = next_sequence;
+      page_header_buffer.magic = PAGE_MAGIC;
+      op = OP_OPEN_PAGE;
+      op_page = page;
+      return started(nrf_fstorage_write(&fstorage, page_addr(page), &page_header_buffer,
+          sizeof(page_header_buffer), NULL));
+    }
+  }
+  // Only when the live values don't fit in a page
+  return false;
+}
+
+static bool write_record(uint8_t key) {
+  entry_t* entry = &entries[key];
+  record_header_t* header = (record_header_t*)record_buffer;
+  uint8_t* value = (uint8_t*)(header + 1);
+
+  memset(record_buffer, 0xFF, sizeof(record_buffer));
+  CRITICAL_REGION_ENTER();
+  header->key = key;
+  header->length = entry->length;
+  memcpy(value, entry->value, entry->length);
+  entry->dirty = 0;
+  CRITICAL_REGION_EXIT();
+  header->crc = record_crc(key, header->length, value);
+
+  uint32_t size = RECORD_SIZE(header->length);
+  if (head == NO_PAGE || head_offset + size > KV_STORE_PAGE_SIZE) {
+    entry->dirty = 1;
+    return open_page();
+  }
+
+  op = OP_WRITE_RECORD;
+  op_page = head;
+  op_key = key;
+  op_size = size;
+  if (!started(nrf_fstorage_write(&fstorage, page_addr(head) + head_offset, record_buffer, size, NULL))) {
+    entry->dirty = 1;
+    return false;
+  }
+  return true;
+}
+
+static bool erase_page(uint8_t page) {
+  op = OP_ERASE_PAGE;
+  op_page = page;
+  return started(nrf_fstorage_erase(&fstorage, page_addr(page), 1, NULL));
+}
+
+static bool start_operation(void) {
+  // Left half written by a reset, or never used by the store
+  for (uint8_t page = 0; page < KV_STORE_PAGES; page++) {
+    if (pages[page].state == PAGE_DIRTY) {
+      return erase_page(page);
+    }
+  }
+
+  if (reclaim != NO_PAGE) {
+    for (uint8_t key = 0; key < KV_STORE_MAX_KEYS; key++) {
+      if (entries[key].page == reclaim) {
+        return write_record(key);
+      }
+    }
+    return erase_page(reclaim);
+  }
+
+  for (uint8_t key = 0; key < KV_STORE_MAX_KEYS; key++) {
+    if (entries[key].dirty) {
+      return write_record(key);
+    }
+  }
+  return false;
+}
+
+// Starts the next flash operation unless one is under way
+static void run(void) {
+  bool start;
+  CRITICAL_REGION_ENTER();
+  start = !busy;
+  busy = true;
+  CRITICAL_REGION_EXIT();
+
+  if (start && !start_operation()) {
+    busy = false;
+  }
+}
+
+static void fstorage_handler(nrf_fstorage_evt_t* evt) {
+  bool ok = evt->result == NRF_SUCCESS;
+
+  switch (op) {
+    case OP_OPEN_PAGE:
+      if (ok) {
+        pages[op_page].state = PAGE_DATA;
+        pages[op_page].sequence = next_sequence++;
+        head = op_page;
+        head_offset = sizeof(page_header_t);
+        keep_page_free();
+      } else {
+        pages[op_page].state = PAGE_DIRTY;
+      }
+      break;
+
+    case OP_WRITE_RECORD:
+      // A failed write may have used the space, and its CRC won't match
+      head_offset += op_size;
+      if (ok) {
+        entries[op_key].page = op_page;
+        stats.records_written++;
+      } else {
+        entries[op_key].dirty = 1;
+      }
+      break;
+
+    case OP_ERASE_PAGE:
+      if (ok) {
+        pages[op_page].state = PAGE_ERASED;
+        if (op_page == reclaim) {
+          reclaim = NO_PAGE;
+        }
+        stats.pages_erased++;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  op = OP_NONE;
+  busy = false;
+  if (ok) {
+    run();
+  } else {
+    stats.failed++;
+    schedule_flush();
+  }
+}
+
+void kv_store_init(void) {
+  ret_code_t err_code = nrf_fstorage_init(&fstorage, &nrf_fstorage_sd, NULL);
+  APP_ERROR_CHECK(err_code);
+  err_code = app_timer_create(&flush_timer, APP_TIMER_MODE_SINGLE_SHOT, flush);
+  APP_ERROR_CHECK(err_code);
+
+  for (uint8_t key = 0; key < KV_STORE_MAX_KEYS; key++) {
+    entries[key].page = NO_PAGE;
+  }
+
+  // Pages holding a log, oldest first
+  uint8_t order[KV_STORE_PAGES];
+  uint8_t count = 0;
+  for (uint8_t page = 0; page < KV_STORE_PAGES; page++) {
+    page_header_t header;
+    read_flash(page_addr(page), &header, sizeof(header));
+    if (header.magic == PAGE_MAGIC) {
+      pages[page].state = PAGE_DATA;
+      pages[page].sequence = header.sequence;
+      uint8_t i = count++;
+      while (i > 0 && pages[order[i - 1]].sequence > header.sequence) {
+        order[i] = order[i - 1];
+        i--;
+      }
+      order[i] = page;
+    } else if (is_erased(page_addr(page), KV_STORE_PAGE_SIZE)) {
+      pages[page].state = PAGE_ERASED;
+    } else {
+      pages[page].state = PAGE_DIRTY;
+    }
+  }
+
+  for (uint8_t i = 0; i < count; i++) {
+    head = order[i];
+    head_offset = replay_page(head);
+    next_sequence = pages[head].sequence + 1;
+  }
+
+  // A reset while the oldest page was being emptied, or a first boot over
+  // old data, leaves work to do
+  keep_page_free();
+  run();
+}
+
+bool kv_store_get(uint8_t key, void* value, uint8_t length) {
+  if (key >= KV_STORE_MAX_KEYS) {
+    return false;
+  }
+
+  bool found;
+  CRITICAL_REGION_ENTER();
+  found = entries[key].length == length;
+  if (found) {
+    memcpy(value, entries[key].value, length);
+  }
+  CRITICAL_REGION_EXIT();
+  return found;
+}
+
+void kv_store_set(uint8_t key, void const* value, uint8_t length) {
+  APP_ERROR_CHECK_BOOL(key < KV_STORE_MAX_KEYS && length > 0 && length <= KV_STORE_MAX_VALUE);
+  entry_t* entry = &entries[key];
+
+  bool changed;
+  CRITICAL_REGION_ENTER();
+  changed = entry->length != length || memcmp(entry->value, value, length);
+  if (changed) {
+    if (entry->dirty) {
+      stats.sets_coalesced++;
+    }
+    memcpy(entry->value, value, length);
+    entry->length = length;
+    entry->dirty = 1;
+  }
+  CRITICAL_REGION_EXIT();
+
+  if (changed) {
+    schedule_flush();
+  }
+}
+
+kv_store_stats_t kv_store_stats(void) {
+  return stats;
+}
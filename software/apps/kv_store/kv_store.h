@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Key-value store in flash
+//
+// A handful of small values that survive a reset, kept as a log of records
+// in KV_STORE_PAGES flash pages through nrf_fstorage and its SoftDevice
+// backend. Every value is also held in RAM, so reads never touch flash.
+//
+// kv_store_set() only changes the RAM copy and marks it dirty. The first one
+// starts a KV_STORE_DELAY_MS timer, and when it fires every dirty value is
+// appended to the log, one fstorage write at a time, each started from the
+// last one's completion. However often a value changes within the delay it
+// costs one record, and the SoftDevice fits the flash operations between
+// radio events, so nothing in the BLE path waits on flash.
+//
+// Layout, little endian. Each page starts with a header, then records:
+//
+//   page header  sequence (4), magic (4)
+//   record       key (1), length (1), crc (2), value padded to 4 bytes
+//
+// The CRC is CRC-16-CCITT over the key, length and value, so a record torn
+// by a reset is skipped. The page with the highest sequence number is the
+// one being appended to, and at boot the pages are replayed from the lowest
+// sequence number up, so the newest record of each key wins.
+//
+// Pages are filled in turn around the ring, and one is always kept erased.
+// Opening the last erased page starts reclaiming the oldest one: the values
+// whose newest record is there are written again to the new page, ahead of
+// anything else, and then it is erased. Every page is erased once per trip
+// around the ring, which levels the wear.
+//
+// The pages sit below where a bootloader and its settings would go. The
+// application has to end below KV_STORE_START_ADDR.
+
+#define KV_STORE_START_ADDR 0xF0000
+#define KV_STORE_PAGE_SIZE 4096
+#define KV_STORE_PAGES 4
+
+// Keys are below KV_STORE_MAX_KEYS, values 1 to KV_STORE_MAX_VALUE bytes.
+// The live values have to fit in one page with room to spare
+#define KV_STORE_MAX_KEYS 16
+#define KV_STORE_MAX_VALUE 32
+
+#define KV_STORE_DELAY_MS 2000
+
+// Keys of the apps, in one place so modules shared between apps can't clash
+#define KV_KEY_AMBIENT 1         // ambient.c: brightness applied
+#define KV_KEY_TAG_STATE 2       // color_adv: selected color and effect
+#define KV_KEY_DEMO 3            // kv_store demo app
+#define KV_KEY_TAG_COUNTER 4     // adv_scheduler.c: counter of the last payload signed
+#define KV_KEY_REGISTRY_DEVICE 8 // device_registry.c: one per device from here
+
+typedef struct {
+  uint32_t records_written;
+  uint32_t sets_coalesced; // sets that replaced a value not written yet
+  uint32_t pages_erased;
+  uint32_t failed;         // fstorage operations that failed and were retried
+  uint32_t bad_records;    // records with a bad CRC found at boot
+} kv_store_stats_t;
+
+// Reads every value back from flash. The SoftDevice has to be enabled and
+// app_timer_init() called first. Call it before anything that restores its
+// state, and before the first frame, so the state is there when it's drawn
+void kv_store_init(void);
+
+// Copies a value out. Returns false, leaving value alone, if the key has no
+// value of exactly this length, so a changed struct reads as never stored
+bool kv_store_get(uint8_t key, void* value, uint8_t length);
+
+// Changes a value, written to flash in the background. Setting the value a
+// key already has costs nothing. Safe from any application interrupt priority
+void kv_store_set(uint8_t key, void const* value, uint8_t length);
+
+kv_store_stats_t kv_store_stats(void);
@@ -0,0 +1,92 @@
+// Key-value store app
+//
+// Counts boots and time powered in the store: the count goes up by one at
+// every reset, and the time is set ten times a second, which the store
+// coalesces into a record every KV_STORE_DELAY_MS. Records come to a page
+// every ten minutes or so, which shows pages being reclaimed around the
+// ring. Prints the store's statistics every ten seconds. Other apps build
+// kv_store.c from this directory.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "simple_ble.h"
+
+#include "kv_store.h"
+#include "nrf52840dk.h"
+
+#define TICK_MS 100
+#define REPORT_INTERVAL_MS 10000
+
+// Intervals for advertising and connections
+static simple_ble_config_t ble_config = {
+    // c0:98:e5:4e:xx:xx
+    .platform_id = 0x4E,     // used as 4th octect in device BLE address
+    .device_id = 0xAABB,     // must be unique on each device you program!
+    .adv_name = "CS397/497", // used in advertisements if there is room
+    .adv_interval = MSEC_TO_UNITS(1000, UNIT_0_625_MS),
+    .min_conn_interval = MSEC_TO_UNITS(500, UNIT_1_25_MS),
+    .max_conn_interval = MSEC_TO_UNITS(1000, UNIT_1_25_MS),
+};
+
+simple_ble_app_t* simple_ble_app;
+
+typedef struct {
+  uint32_t boots;
+  uint32_t on_ticks; // TICK_MS each
+} demo_state_t;
+
+static demo_state_t state;
+
+APP_TIMER_DEF(tick_timer);
+APP_TIMER_DEF(report_timer);
+static volatile bool report_due = false;
+
+static void tick(void* context) {
+  state.on_ticks++;
+  kv_store_set(KV_KEY_DEMO, &state, sizeof(state));
+}
+
+static void report_callback(void* context) {
+  report_due = true;
+}
+
+int main(void) {
+  printf("Board started. Initializing BLE: \n");
+
+  // The store writes through the SoftDevice, which has to run first
+  simple_ble_app = simple_ble_init(&ble_config);
+  app_timer_init();
+  kv_store_init();
+
+  kv_store_get(KV_KEY_DEMO, &state, sizeof(state));
+  state.boots++;
+  kv_store_set(KV_KEY_DEMO, &state, sizeof(state));
+  printf("Boot %lu, %lu s powered before\n", state.boots, state.on_ticks * TICK_MS / 1000);
+
+  // Advertising runs alongside the flash operations
+  simple_ble_adv_only_name();
+
+  ret_code_t err_code = app_timer_create(&tick_timer, APP_TIMER_MODE_REPEATED, tick);
+  APP_ERROR_CHECK(err_code);
+  err_code = app_timer_start(tick_timer, APP_TIMER_TICKS(TICK_MS), NULL);
+  APP_ERROR_CHECK(err_code);
+  err_code = app_timer_create(&report_timer, APP_TIMER_MODE_REPEATED, report_callback);
+  APP_ERROR_CHECK(err_code);
+  err_code = app_timer_start(report_timer, APP_TIMER_TICKS(REPORT_INTERVAL_MS), NULL);
+  APP_ERROR_CHECK(err_code);
+
+  while (1) {
+    if (report_due) {
+      report_due = false;
+      kv_store_stats_t stats = kv_store_stats();
+      printf("%lu s powered: %lu records, %lu sets coalesced, %lu pages erased, %lu failed, %lu bad at boot\n",
+          state.on_ticks * TICK_MS / 1000, stats.records_written, stats.sets_coalesced, stats.pages_erased,
+          stats.failed, stats.bad_records);
+    }
+    power_manage();
+  }
+}
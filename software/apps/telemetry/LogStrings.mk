@@ -0,0 +1,18 @@
+# Deferred log dictionary, see README.md
+#
+# Writes _build/$(PROJECT_NAME).log_strings.json from the app's ELF after
+# every link, since the format strings move with each build. Include after
+# AppMakefile.mk, which names the ELF
+
+LOG_STRINGS_SCRIPT := $(shell dirname $(realpath $(lastword $(MAKEFILE_LIST))))/../../scripts/telemetry/log_strings.py
+LOG_STRINGS_ELF ?= $(BUILDDIR)$(OUTPUT_NAME).elf
+LOG_STRINGS_JSON = _build/$(PROJECT_NAME).log_strings.json
+
+.PHONY: log_strings
+
+all: $(LOG_STRINGS_JSON)
+
+log_strings: $(LOG_STRINGS_JSON)
+
+$(LOG_STRINGS_JSON): $(LOG_STRINGS_ELF)
+	$(LOG_STRINGS_SCRIPT) $< -o $@
@@ -0,0 +1,62 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_util_platform.h"
+#include "nrf.h"
+
+#include "deferred_log.h"
+#include "telemetry.h"
+
+typedef struct {
+  char const* fmt;
+  uint32_t timestamp;
+  uint32_t args[DEFERRED_LOG_MAX_ARGS];
+} log_entry_t;
+
+static log_entry_t ring[DEFERRED_LOG_SLOTS];
+static volatile uint32_t ring_head = 0;
+static volatile uint32_t ring_tail = 0;
+static deferred_log_stats_t stats;
+
+void deferred_log_write(char const* fmt, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+  // Any priority can log, so claiming a slot has to be atomic
+  CRITICAL_REGION_ENTER();
+  if (ring_head - ring_tail == DEFERRED_LOG_SLOTS) {
+    stats.dropped++;
+  } else {
+    log_entry_t* entry = &ring[ring_head % DEFERRED_LOG_SLOTS];
+    entry->fmt = fmt;
+    entry->timestamp = DWT->CYCCNT;
+    entry->args[0] = a0;
+    entry->args[1] = a1;
+    entry->args[2] = a2;
+    entry->args[3] = a3;
+    ring_head++;
+    stats.written++;
+  }
+  CRITICAL_REGION_EXIT();
+}
+
+static void emit(log_entry_t const* entry) {
+#if DEFERRED_LOG_HOST
+  // The format string's address, then the arguments, each stamped with the
+  // time of the call
+  telemetry_write_at(entry->timestamp, TELEMETRY_ID_LOG, DEFERRED_LOG_MAX_ARGS, (int32_t)entry->fmt);
+  for (uint16_t i = 0; i < DEFERRED_LOG_MAX_ARGS; i++) {
+    telemetry_write_at(entry->timestamp, TELEMETRY_ID_LOG_ARG, i, entry->args[i]);
+  }
+#else
+  printf(entry->fmt, entry->args[0], entry->args[1], entry->args[2], entry->args[3]);
+#endif
+}
+
+void deferred_log_process(void) {
+  while (ring_tail != ring_head) {
+    emit(&ring[ring_tail % DEFERRED_LOG_SLOTS]);
+    ring_tail++;
+  }
+}
+
+deferred_log_stats_t deferred_log_stats(void) {
+  return stats;
+}
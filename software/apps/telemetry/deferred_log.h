@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+
+// Deferred logging
+//
+// LOG(fmt, ...) formats nothing at the call: it records the address of the
+// format string and up to four integer arguments in a ring buffer, which
+// takes a few dozen cycles from any context. deferred_log_process() drains
+// the ring from the main loop and either formats each entry with printf on
+// the device, or with DEFERRED_LOG_HOST=1 passes it on raw over the
+// telemetry channel for the host to format.
+//
+// In host mode the format strings never leave the ELF: every one sits in a
+// symbol named log_fmt.*, and scripts/telemetry/log_strings.py extracts them
+// into a dictionary keyed by address that telemetry_decode.py formats with.
+//
+// Arguments are cast to 32 bits, so %d, %u, %x, %c and %p work. A %s
+// argument is passed as its address: it prints on the device as long as the
+// string is still there when the entry is formatted, while the host only
+// sees the address.
+
+#ifndef DEFERRED_LOG_HOST
+#define DEFERRED_LOG_HOST 0
+#endif
+
+// Entries waiting for deferred_log_process(), a power of two
+#define DEFERRED_LOG_SLOTS 64
+
+#define DEFERRED_LOG_MAX_ARGS 4
+
+#define LOG(fmt, ...) LOG_(fmt, ##__VA_ARGS__, 0, 0, 0, 0)
+#define LOG_(fmt, a0, a1, a2, a3, ...)                                                             \
+  do {                                                                                             \
+    static char const log_fmt[] __attribute__((used)) = fmt;                                       \
+    deferred_log_write(log_fmt, (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2), (uint32_t)(a3)); \
+  } while (0)
+
+typedef struct {
+  uint32_t written;
+  uint32_t dropped;  // the ring was full
+} deferred_log_stats_t;
+
+void deferred_log_write(char const* fmt, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+
+// Formats or sends everything logged so far. Call from the main loop
+void deferred_log_process(void);
+
+deferred_log_stats_t deferred_log_stats(void);
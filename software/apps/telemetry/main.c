@@ -0,0 +1,94 @@
+// Telemetry app
+//
+// Streams telemetry records as fast as it can: a sawtooth on
+// TELEMETRY_ID_SAMPLE, with a mark every 1000 records. Once a second it
+// prints the records written and dropped, and the cycles each write takes.
+// At startup it compares the cycles a LOG() call takes against printf.
+// Other apps build telemetry.c and deferred_log.c from this directory.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "nrf.h"
+#include "nrf_drv_clock.h"
+
+#include "deferred_log.h"
+#include "nrf52840dk.h"
+#include "telemetry.h"
+
+#define REPORT_INTERVAL_MS 1000
+#define LOG_BENCHMARK_CALLS 16
+
+APP_TIMER_DEF(report_timer);
+static volatile bool report_due = false;
+
+static void report_callback(void* context) {
+  report_due = true;
+}
+
+// Cycles per call for the same message logged both ways. The LOG() calls are
+// timed before the ring is drained, so formatting them isn't counted
+static void benchmark_logging(void) {
+  uint32_t start = DWT->CYCCNT;
+  for (uint32_t i = 0; i < LOG_BENCHMARK_CALLS; i++) {
+    printf("printf %lu of %d\n", i, LOG_BENCHMARK_CALLS);
+  }
+  uint32_t printf_cycles = (DWT->CYCCNT - start) / LOG_BENCHMARK_CALLS;
+
+  start = DWT->CYCCNT;
+  for (uint32_t i = 0; i < LOG_BENCHMARK_CALLS; i++) {
+    LOG("LOG %lu of %d\n", i, LOG_BENCHMARK_CALLS);
+  }
+  uint32_t log_cycles = (DWT->CYCCNT - start) / LOG_BENCHMARK_CALLS;
+  deferred_log_process();
+
+  printf("%lu cycles per printf, %lu cycles per LOG\n", printf_cycles, log_cycles);
+}
+
+int main(void) {
+  // Start the low-frequency clock for app_timer
+  ret_code_t err_code = nrf_drv_clock_init();
+  APP_ERROR_CHECK(err_code);
+  nrf_drv_clock_lfclk_request(NULL);
+  app_timer_init();
+
+  telemetry_init();
+  benchmark_logging();
+
+  app_timer_create(&report_timer, APP_TIMER_MODE_REPEATED, report_callback);
+  app_timer_start(report_timer, APP_TIMER_TICKS(REPORT_INTERVAL_MS), NULL);
+
+  printf("Streaming telemetry on RTT channel %d\n", TELEMETRY_RTT_CHANNEL);
+
+  telemetry_stats_t last = telemetry_stats();
+  uint32_t write_cycles = 0;
+  uint32_t writes = 0;
+  uint32_t count = 0;
+
+  while (1) {
+    deferred_log_process();
+
+    uint32_t start = DWT->CYCCNT;
+    TELEMETRY(TELEMETRY_ID_SAMPLE, 0, count & 0xFFF);
+    write_cycles += DWT->CYCCNT - start;
+    writes++;
+
+    count++;
+    if (count % 1000 == 0) {
+      TELEMETRY(TELEMETRY_ID_MARK, 0, count);
+    }
+
+    if (report_due) {
+      report_due = false;
+      telemetry_stats_t now = telemetry_stats();
+      printf("%lu records/s written, %lu dropped, %lu cycles per write\n",
+          now.written - last.written, now.dropped - last.dropped, write_cycles / writes);
+      last = now;
+      write_cycles = 0;
+      writes = 0;
+    }
+  }
+}
@@ -0,0 +1,98 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "app_util_platform.h"
+#include "nrf.h"
+#include "SEGGER_RTT.h"
+
+#include "profile.h"
+
+#if PROFILE_ENABLED
+
+static profile_region_t* regions[PROFILE_MAX_REGIONS];
+static uint32_t region_count = 0;
+
+void profile_init(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void profile_record(profile_region_t* region, uint32_t cycles) {
+  uint32_t bin = 31 - __builtin_clz(cycles | 1);
+
+  // The same region can be timed from more than one priority
+  CRITICAL_REGION_ENTER();
+  if (!region->registered && region_count < PROFILE_MAX_REGIONS) {
+    regions[region_count++] = region;
+    region->registered = 1;
+  }
+  if (region->count == 0 || cycles < region->min) {
+    region->min = cycles;
+  }
+  if (cycles > region->max) {
+    region->max = cycles;
+  }
+  region->count++;
+  region->total += cycles;
+  region->histogram[bin]++;
+  CRITICAL_REGION_EXIT();
+}
+
+void profile_dump(void) {
+  printf("%-24s %10s %10s %10s %10s\n", "region (cycles)", "count", "min", "mean", "max");
+  for (uint32_t i = 0; i < region_count; i++) {
+    // Copied first so the line holds together if the region is hit meanwhile
+    profile_region_t region;
+    CRITICAL_REGION_ENTER();
+    region = *regions[i];
+    CRITICAL_REGION_EXIT();
+
+    uint32_t mean = region.count ? (uint32_t)(region.total / region.count) : 0;
+    printf("%-24s %10lu %10lu %10lu %10lu\n", region.name, region.count, region.min, mean, region.max);
+
+    printf("  ");
+    for (uint32_t bin = 0; bin < PROFILE_HISTOGRAM_BINS; bin++) {
+      if (region.histogram[bin]) {
+        printf(" <2^%lu:%lu", bin + 1, region.histogram[bin]);
+      }
+    }
+    printf("\n");
+  }
+  if (region_count == PROFILE_MAX_REGIONS) {
+    printf("Region table full, raise PROFILE_MAX_REGIONS to see the rest\n");
+  }
+}
+
+void profile_reset(void) {
+  for (uint32_t i = 0; i < region_count; i++) {
+    profile_region_t* region = regions[i];
+    CRITICAL_REGION_ENTER();
+    region->count = 0;
+    region->min = 0;
+    region->max = 0;
+    region->total = 0;
+    memset(region->histogram, 0, sizeof(region->histogram));
+    CRITICAL_REGION_EXIT();
+  }
+}
+
+void profile_poll(void) {
+  if (!SEGGER_RTT_HasKey()) {
+    return;
+  }
+
+  switch (SEGGER_RTT_GetKey()) {
+    case 'p':
+      profile_dump();
+      break;
+    case 'r':
+      profile_reset();
+      printf("Profile cleared\n");
+      break;
+    default:
+      break;
+  }
+}
+
+#endif
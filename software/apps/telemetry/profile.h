@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "nrf.h"
+
+// Cycle counter profiling
+//
+// PROFILE_BEGIN(name) and PROFILE_END(name) around a stretch of code time it
+// with the DWT cycle counter (64 per us) and add it to a region called name,
+// which keeps a count, min, max, mean and log2 histogram. Regions register
+// themselves the first time they end, up to PROFILE_MAX_REGIONS.
+//
+//   void display_color(color_t color) {
+//     PROFILE_BEGIN(display_color);
+//     ...
+//     PROFILE_END(display_color);
+//   }
+//
+// PROFILE_BEGIN declares variables, so it has to start the block it's in and
+// each name can be used once per function. Every path out of the region needs
+// its PROFILE_END.
+//
+// profile_poll() in the main loop prints every region over RTT when 'p' is
+// typed in the RTT terminal, and clears them on 'r'. A key doesn't wake the
+// board, so it's handled on the next wakeup. Build with PROFILE_ENABLED=0 to
+// compile all of it out.
+
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED 1
+#endif
+
+#define PROFILE_MAX_REGIONS 16
+
+// Bin i counts times of 2^i to 2^(i+1) - 1 cycles, bin 0 also counts 0
+#define PROFILE_HISTOGRAM_BINS 32
+
+typedef struct {
+  char const* name;
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t total;
+  uint32_t histogram[PROFILE_HISTOGRAM_BINS];
+  uint8_t registered;
+} profile_region_t;
+
+#if PROFILE_ENABLED
+
+#define PROFILE_BEGIN(region)                                          \
+  static profile_region_t profile_region_##region = {.name = #region}; \
+  uint32_t const profile_start_##region = DWT->CYCCNT
+
+#define PROFILE_END(region) \
+  profile_record(&profile_region_##region, DWT->CYCCNT - profile_start_##region)
+
+// Starts the cycle counter
+void profile_init(void);
+
+// Safe from any application interrupt priority
+void profile_record(profile_region_t* region, uint32_t cycles);
+
+// Prints every region over RTT
+void profile_dump(void);
+
+// Clears every region's statistics
+void profile_reset(void);
+
+// Dumps or resets the regions when asked to over RTT, call from the main loop
+void profile_poll(void);
+
+#else
+
+#define PROFILE_BEGIN(region) ((void)0)
+#define PROFILE_END(region) ((void)0)
+
+static inline void profile_init(void) {}
+static inline void profile_dump(void) {}
+static inline void profile_reset(void) {}
+static inline void profile_poll(void) {}
+
+#endif
@@ -0,0 +1,55 @@
+#include <stdint.h>
+
+#include "nrf.h"
+#include "SEGGER_RTT.h"
+
+#include "telemetry.h"
+
+#if TELEMETRY_ENABLED
+
+static uint8_t rtt_buffer[TELEMETRY_BUFFER_SIZE];
+static uint8_t sequence = 0;
+static telemetry_stats_t stats;
+
+void telemetry_init(void) {
+  // Skip mode drops a record that doesn't fit whole, so the stream stays
+  // aligned on record boundaries
+  SEGGER_RTT_ConfigUpBuffer(TELEMETRY_RTT_CHANNEL, "Telemetry", rtt_buffer, sizeof(rtt_buffer),
+      SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+void telemetry_write(telemetry_id_t id, uint16_t arg, int32_t value) {
+  telemetry_write_at(DWT->CYCCNT, id, arg, value);
+}
+
+void telemetry_write_at(uint32_t timestamp, telemetry_id_t id, uint16_t arg, int32_t value) {
+  telemetry_record_t record = {
+    .timestamp = timestamp,
+    .id = id,
+    .arg = arg,
+    .value = value,
+  };
+
+  // The sequence number and the copy have to go together when an interrupt
+  // writes a record in between. RTT's own lock leaves the SoftDevice's
+  // interrupt levels running
+  SEGGER_RTT_LOCK();
+  record.sequence = sequence;
+  if (SEGGER_RTT_WriteSkipNoLock(TELEMETRY_RTT_CHANNEL, &record, sizeof(record)) == sizeof(record)) {
+    stats.written++;
+  } else {
+    stats.dropped++;
+  }
+  // Counts dropped records too, which is how the host sees the gap
+  sequence++;
+  SEGGER_RTT_UNLOCK();
+}
+
+telemetry_stats_t telemetry_stats(void) {
+  return stats;
+}
+
+#endif
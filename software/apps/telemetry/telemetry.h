@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+
+// Binary telemetry over RTT
+//
+// Fixed-size records on their own RTT up-buffer, next to the text output on
+// buffer 0. Writing a record copies 12 bytes into the buffer and never
+// waits: if the host hasn't drained enough room, the record is dropped and
+// counted. scripts/telemetry decodes a capture into CSV or JSON.
+//
+// Record layout, little endian:
+//
+//   timestamp (4)  DWT cycle counter, 64 MHz, wraps every 67 s
+//   id        (1)  what the record is, telemetry_id_t
+//   sequence  (1)  counts up by one per record written, so the host can
+//                  tell where records were dropped
+//   arg       (2)  meaning depends on id
+//   value     (4)  meaning depends on id, signed
+//
+// Build with TELEMETRY_ENABLED=0 to compile the records out.
+
+#ifndef TELEMETRY_ENABLED
+#define TELEMETRY_ENABLED 1
+#endif
+
+#define TELEMETRY_RTT_CHANNEL 1
+#define TELEMETRY_BUFFER_SIZE 8192
+
+// Keep in step with IDS in scripts/telemetry/telemetry_decode.py
+typedef enum {
+  TELEMETRY_ID_MARK = 0,         // arg, value: anything
+  TELEMETRY_ID_SAMPLE = 1,       // arg: SAADC channel, value: raw result
+  TELEMETRY_ID_BLE_EVENT = 2,    // arg: BLE event id, value: connection handle
+  TELEMETRY_ID_COLOR_OPTIONS = 3, // arg: options shown, value: first option
+  TELEMETRY_ID_LOG = 4,          // arg: arguments to follow, value: format string address
+  TELEMETRY_ID_LOG_ARG = 5,      // arg: index, value: argument, see deferred_log.h
+} telemetry_id_t;
+
+typedef struct {
+  uint32_t timestamp;
+  uint8_t id;
+  uint8_t sequence;
+  uint16_t arg;
+  int32_t value;
+} telemetry_record_t;
+
+typedef struct {
+  uint32_t written;
+  uint32_t dropped;  // no room in the RTT buffer
+} telemetry_stats_t;
+
+#if TELEMETRY_ENABLED
+
+#define TELEMETRY(id, arg, value) telemetry_write((id), (arg), (value))
+
+// Sets up the RTT buffer and starts the cycle counter
+void telemetry_init(void);
+
+// Safe from any application interrupt priority
+void telemetry_write(telemetry_id_t id, uint16_t arg, int32_t value);
+
+// Same with a timestamp taken earlier
+void telemetry_write_at(uint32_t timestamp, telemetry_id_t id, uint16_t arg, int32_t value);
+
+telemetry_stats_t telemetry_stats(void);
+
+#else
+
+#define TELEMETRY(id, arg, value) ((void)0)
+
+static inline void telemetry_init(void) {}
+static inline void telemetry_write_at(uint32_t timestamp, telemetry_id_t id, uint16_t arg, int32_t value) {}
+static inline telemetry_stats_t telemetry_stats(void) {
+  return (telemetry_stats_t){0};
+}
+
+#endif
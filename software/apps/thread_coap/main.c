@@ -16,6 +16,7 @@
 #include <openthread/thread.h>
 #include "simple_thread.h"
 #include "thread_coap.h"
+#include "profile.h"
 
 // Timer data
 #define SCHED_QUEUE_SIZE 32
@@ -46,9 +47,11 @@ void coap_timer_callback(void* context) {
   const char* path = "test";
   otInstance* thread_instance = thread_get_instance();
 
+  PROFILE_BEGIN(coap_send);
   otError error = thread_coap_send(thread_instance,
       OT_COAP_CODE_PUT, OT_COAP_TYPE_NON_CONFIRMABLE,
       &coap_ipv6_address, path, data, strlen((char*)data), coap_response_handler);
+  PROFILE_END(coap_send);
   if (error != OT_ERROR_NONE) {
     printf("CoAP send error: %d\n", error);
   } else {
@@ -85,6 +88,7 @@ int main(void) {
   APP_ERROR_CHECK(err_code);
   NRF_LOG_DEFAULT_BACKENDS_INIT();
   printf("Board started. Initializing Thread\n");
+  profile_init();
 
   // Initialize application timers
   APP_SCHED_INIT(SCHED_EVENT_DATA_SIZE, SCHED_QUEUE_SIZE);
@@ -126,6 +130,7 @@ int main(void) {
   while (true) {
     thread_process();
     app_sched_execute();
+    profile_poll();
     thread_sleep();
   }
 }
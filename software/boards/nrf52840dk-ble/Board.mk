@@ -38,6 +38,7 @@ BOARD_SOURCES += \
 	app_uart.c\
 	app_util_platform.c\
 	before_startup.c\
+	crc16.c\
 	hardfault_handler_gcc.c\
 	hardfault_implementation.c\
 	nrf_assert.c\
@@ -97,8 +98,10 @@ BOARD_SOURCES += \
 	ble_srv_common.c\
 	nrf_ble_gatt.c\
 	nrf_ble_qwr.c\
+	nrf_fstorage_sd.c\
 	nrf_sdh.c\
 	nrf_sdh_ble.c\
+	nrf_sdh_soc.c\
 	simple_ble.c\
 
 endif
@@ -81,6 +81,10 @@ BOARD_SOURCES += \
 	nrfx_uarte.c\
 
 ifneq ($(SOFTDEVICE_MODEL),blank)
+# The SoftDevice needs more RAM for the links app_config.h sets up, see the
+# linker script. Found through BOARD_LINKER_PATHS
+LINKER_SCRIPT = nrf52840_s140_8links.ld
+
 BOARD_SOURCES += \
 	ble_advdata.c\
 	ble_advertising.c\
@@ -91,8 +95,10 @@ BOARD_SOURCES += \
 	nrf_ble_gatt.c\
 	nrf_ble_scan.c\
 	nrf_ble_qwr.c\
+	nrf_fstorage_sd.c\
 	nrf_sdh.c\
 	nrf_sdh_ble.c\
+	nrf_sdh_soc.c\
 
 	#simple_ble.c\ ## Cannot have simple BLE or everything breaks for some reason...
 
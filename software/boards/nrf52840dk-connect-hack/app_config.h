@@ -137,9 +137,14 @@
 #define NRF_SDH_ENABLED 1
 #define NRF_SDH_BLE_ENABLED 1
 #define NRF_SDH_BLE_GAP_DATA_LENGTH 251
-#define NRF_SDH_BLE_PERIPHERAL_LINK_COUNT 1
-#define NRF_SDH_BLE_CENTRAL_LINK_COUNT 1
-#define NRF_SDH_BLE_TOTAL_LINK_COUNT 2
+// ble_connect is central only, so connection handles index its links. Each
+// link costs SoftDevice RAM, which nrf52840_s140_8links.ld makes room for:
+// change its RAM origin along with these counts.
+#define NRF_SDH_BLE_PERIPHERAL_LINK_COUNT 0
+#define NRF_SDH_BLE_CENTRAL_LINK_COUNT 8
+#define NRF_SDH_BLE_TOTAL_LINK_COUNT 8
+// 5 ms events fit a full length packet pair on 1M; links share the interval
+#define NRF_SDH_BLE_GAP_EVENT_LENGTH 4
 #define NRF_SDH_BLE_GATT_MAX_MTU_SIZE 247
 #define NRF_SDH_BLE_VS_UUID_COUNT 10
 #define NRF_SDH_SOC_ENABLED 1
@@ -0,0 +1,72 @@
+#! /usr/bin/env python3
+
+# Streams a moving rainbow to apps/ble_framebuffer and prints the stats it
+# notifies back. Needs bleak (pip install bleak).
+
+import argparse
+import asyncio
+import colorsys
+import struct
+import time
+
+from bleak import BleakClient, BleakScanner
+
+FRAME_UUID = "61b2fb01-195e-27a1-864f-419c2e7a5b3d"
+STATS_UUID = "61b2fb02-195e-27a1-864f-419c2e7a5b3d"
+
+HEADER_LENGTH = 4
+FLAG_SHOW = 1 << 0
+
+def rainbow(led_count, step):
+    pixels = bytearray()
+    for i in range(led_count):
+        r, g, b = colorsys.hsv_to_rgb(((i + step) % led_count) / led_count, 1, 0.2)
+        pixels += bytes((int(r * 255), int(g * 255), int(b * 255)))
+    return pixels
+
+def chunks(frame, pixels, max_length):
+    # Splits a frame into writes of whole pixels, the last one shows it
+    per_chunk = (max_length - HEADER_LENGTH) // 3
+    offsets = range(0, len(pixels) // 3, per_chunk)
+    for offset in offsets:
+        flags = FLAG_SHOW if offset == offsets[-1] else 0
+        data = pixels[offset * 3:(offset + per_chunk) * 3]
+        yield struct.pack("<BBH", frame & 0xFF, flags, offset) + data
+
+def print_stats(sender, data):
+    bytes_per_s, chunks_per_s, frames_per_s, dropped, skipped = struct.unpack("<IHHII", data)
+    print("{} fps, {} chunks/s, {} B/s | {} chunks dropped, {} frames skipped".format(
+        frames_per_s, chunks_per_s, bytes_per_s, dropped, skipped))
+
+async def stream(args):
+    device = await BleakScanner.find_device_by_name(args.name)
+    if device is None:
+        print("{} not found".format(args.name))
+        return
+
+    async with BleakClient(device) as client:
+        # MTU minus the 3 byte ATT header, never more than the characteristic holds
+        max_length = min(client.mtu_size - 3, 244)
+        print("Connected, {} byte writes".format(max_length))
+        await client.start_notify(STATS_UUID, print_stats)
+
+        frame = 0
+        period = 1 / args.fps
+        next_time = time.monotonic()
+        while True:
+            for chunk in chunks(frame, rainbow(args.leds, frame), max_length):
+                await client.write_gatt_char(FRAME_UUID, chunk, response=False)
+            frame += 1
+
+            next_time += period
+            await asyncio.sleep(max(0, next_time - time.monotonic()))
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--name", default="CS397/497")
+parser.add_argument("--leds", type=int, default=100)
+parser.add_argument("--fps", type=float, default=60)
+
+try:
+    asyncio.run(stream(parser.parse_args()))
+except KeyboardInterrupt:
+    pass
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Minimal checks for the host tests. A failed CHECK prints where and carries
+// on, so one run shows every failure. Each test's main() ends with
+// CHECK_DONE(), which exits non-zero if any check failed
+
+static int check_failures = 0;
+
+#define CHECK(condition)                                                            \
+  do                                                                                \
+  {                                                                                 \
+    if (!(condition))                                                               \
+    {                                                                               \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+      check_failures++;                                                             \
+    }                                                                               \
+  } while (0)
+
+// Like CHECK, printing both values
+#define CHECK_EQUAL(actual, expected)                                                                  \
+  do                                                                                                   \
+  {                                                                                                    \
+    long long check_actual = (actual), check_expected = (expected);                                    \
+    if (check_actual != check_expected)                                                                \
+    {                                                                                                  \
+      fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, check_actual, \
+              check_expected);                                                                         \
+      check_failures++;                                                                                \
+    }                                                                                                  \
+  } while (0)
+
+#define CHECK_DONE()                                                       \
+  do                                                                       \
+  {                                                                        \
+    if (check_failures)                                                    \
+    {                                                                      \
+      fprintf(stderr, "%s: %d checks failed\n", __FILE__, check_failures); \
+      return EXIT_FAILURE;                                                 \
+    }                                                                      \
+    printf("%s: ok\n", __FILE__);                                          \
+    return EXIT_SUCCESS;                                                   \
+  } while (0)
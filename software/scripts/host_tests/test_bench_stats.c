@@ -0,0 +1,172 @@
+// Host tests of ble_bench_central's latency statistics
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Included rather than linked, to reach bucket_of() and bucket_upper()
+#include "bench_stats.c"
+
+#include "check.h"
+
+static bench_stats_t stats;
+
+static void test_buckets(void)
+{
+  // Every bucket's upper edge lands back in it, one past it in the next
+  for (uint32_t bucket = 0; bucket < BENCH_LATENCY_BUCKETS; bucket++)
+  {
+    CHECK_EQUAL(bucket_of(bucket_upper(bucket)), bucket);
+    if (bucket + 1 < BENCH_LATENCY_BUCKETS)
+    {
+      CHECK_EQUAL(bucket_of(bucket_upper(bucket) + 1), bucket + 1);
+    }
+  }
+  CHECK_EQUAL(bucket_upper(BENCH_LATENCY_BUCKETS - 1), UINT32_MAX);
+
+  // Every value is at most its bucket's upper edge, within 12.5% of it
+  for (uint64_t value = 0; value <= UINT32_MAX; value = value < 100000 ? value + 1 : value * 1001 / 1000)
+  {
+    uint32_t upper = bucket_upper(bucket_of(value));
+    CHECK(value <= upper);
+    CHECK(upper - value <= value / BENCH_LATENCY_SUB_BUCKETS);
+  }
+  CHECK_EQUAL(bucket_of(UINT32_MAX), BENCH_LATENCY_BUCKETS - 1);
+}
+
+static void test_percentiles(void)
+{
+  bench_stats_reset(&stats);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 0), 0);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 50), 0);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 100), 0);
+
+  // One sample is every percentile
+  bench_stats_add_latency(&stats, 1000);
+  uint32_t upper = bucket_upper(bucket_of(1000));
+  CHECK_EQUAL(upper, 1023);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 0), upper);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 50), upper);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 99), upper);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 100), upper);
+
+  // p99 of 100 samples is the 99th: one outlier doesn't reach it, two do
+  bench_stats_reset(&stats);
+  for (int i = 0; i < 99; i++)
+  {
+    bench_stats_add_latency(&stats, 7);
+  }
+  bench_stats_add_latency(&stats, 50000);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 99), 7);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 100), bucket_upper(bucket_of(50000)));
+
+  bench_stats_reset(&stats);
+  for (int i = 0; i < 98; i++)
+  {
+    bench_stats_add_latency(&stats, 7);
+  }
+  bench_stats_add_latency(&stats, 50000);
+  bench_stats_add_latency(&stats, 50000);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 98), 7);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 99), bucket_upper(bucket_of(50000)));
+
+  // Percentiles round up: p50 of 3 samples is the 2nd
+  bench_stats_reset(&stats);
+  bench_stats_add_latency(&stats, 1);
+  bench_stats_add_latency(&stats, 2);
+  bench_stats_add_latency(&stats, 3);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 50), 2);
+  CHECK_EQUAL(bench_stats_percentile_us(&stats, 1), 1);
+}
+
+static void test_fifo(void)
+{
+  bench_stats_reset(&stats);
+
+  // Fills up, then refuses
+  for (uint32_t i = 0; i < BENCH_INFLIGHT_SIZE; i++)
+  {
+    CHECK(bench_stats_queued(&stats, i));
+  }
+  CHECK(!bench_stats_queued(&stats, 0));
+  CHECK_EQUAL(bench_stats_inflight(&stats), BENCH_INFLIGHT_SIZE);
+
+  // Completes in queue order
+  bench_stats_completed(&stats, 20, 100);
+  CHECK_EQUAL(stats.latencies, 1);
+  CHECK_EQUAL(stats.histogram[bucket_of(100)], 1);
+  CHECK_EQUAL(bench_stats_inflight(&stats), BENCH_INFLIGHT_SIZE - 1);
+
+  // Runs through the 16-bit indices and the 32-bit clock many times over,
+  // with a latency that depends on the packet so a mixed-up slot shows
+  bench_stats_reset(&stats);
+  uint32_t now = UINT32_MAX - 1000;
+  uint32_t queued = 0;
+  uint32_t completed = 0;
+  uint32_t wrong = 0;
+  while (completed < 3 * 65536)
+  {
+    // Queue a few, complete fewer, until full, then drain
+    for (int i = 0; i < 3 && bench_stats_queued(&stats, now - (queued % 5)); i++)
+    {
+      queued++;
+    }
+    for (int i = 0; i < 2 && bench_stats_inflight(&stats) > 0; i++)
+    {
+      uint32_t before = stats.histogram[bucket_of(completed % 5 + 10)];
+      bench_stats_completed(&stats, 1, now + 10);
+      wrong += stats.histogram[bucket_of(completed % 5 + 10)] != before + 1;
+      completed++;
+    }
+    if (bench_stats_inflight(&stats) == BENCH_INFLIGHT_SIZE)
+    {
+      while (bench_stats_inflight(&stats) > 0)
+      {
+        uint32_t before = stats.histogram[bucket_of(completed % 5 + 10)];
+        bench_stats_completed(&stats, 1, now + 10);
+        wrong += stats.histogram[bucket_of(completed % 5 + 10)] != before + 1;
+        completed++;
+      }
+    }
+  }
+  CHECK_EQUAL(wrong, 0);
+  CHECK_EQUAL(stats.latencies, completed);
+  CHECK_EQUAL(stats.packets, completed);
+  CHECK_EQUAL(queued - completed, bench_stats_inflight(&stats));
+
+  // A completion with nothing queued counts the packet but no latency
+  bench_stats_reset(&stats);
+  bench_stats_completed(&stats, 20, 100);
+  CHECK_EQUAL(stats.packets, 1);
+  CHECK_EQUAL(stats.bytes, 20);
+  CHECK_EQUAL(stats.latencies, 0);
+}
+
+static void test_result(void)
+{
+  bench_stats_reset(&stats);
+  for (int i = 0; i < 100; i++)
+  {
+    bench_stats_add_packet(&stats, 244);
+  }
+
+  // 100 packets over 1 s at 7.5 ms: 133 events
+  bench_result_t result = bench_stats_result(&stats, 1000000, 7500);
+  CHECK_EQUAL(result.bytes_per_s, 24400);
+  CHECK_EQUAL(result.packets, 100);
+  CHECK_EQUAL(result.packets_per_event_x100, 75);
+
+  // Shorter than one interval counts as one event
+  result = bench_stats_result(&stats, 1000, 7500);
+  CHECK_EQUAL(result.packets_per_event_x100, 10000);
+  result = bench_stats_result(&stats, 0, 0);
+  CHECK_EQUAL(result.bytes_per_s, 0);
+}
+
+int main(void)
+{
+  test_buckets();
+  test_percentiles();
+  test_fifo();
+  test_result();
+  CHECK_DONE();
+}
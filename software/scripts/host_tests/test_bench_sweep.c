@@ -0,0 +1,85 @@
+// Host tests of ble_bench_central's parameter sweep
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "bench_sweep.h"
+
+#include "check.h"
+
+static void test_order(void)
+{
+  bench_sweep_t sweep;
+  bench_sweep_start(&sweep);
+
+  // The first configuration is the smallest of everything, on the link the
+  // sweep starts with
+  bench_config_t config = bench_sweep_config(&sweep);
+  CHECK_EQUAL(config.att_mtu, 23);
+  CHECK_EQUAL(config.data_length, 27);
+  CHECK_EQUAL(config.phy, BENCH_PHY_1M);
+  CHECK_EQUAL(config.interval_units, 6);
+  CHECK_EQUAL(bench_sweep_index(&sweep), 0);
+  CHECK(!bench_sweep_needs_reconnect(&sweep));
+
+  uint16_t steps = 1;
+  uint16_t reconnects = 0;
+  bench_config_t previous = config;
+  while (bench_sweep_next(&sweep))
+  {
+    config = bench_sweep_config(&sweep);
+    CHECK_EQUAL(bench_sweep_index(&sweep), steps);
+
+    // MTU outermost, then data length, PHY and interval innermost: the
+    // configurations come in order of that tuple
+    bool mtu_changed = config.att_mtu != previous.att_mtu;
+    CHECK(config.att_mtu >= previous.att_mtu);
+    if (!mtu_changed)
+    {
+      CHECK(config.data_length >= previous.data_length);
+      if (config.data_length == previous.data_length)
+      {
+        CHECK(config.phy >= previous.phy);
+        if (config.phy == previous.phy)
+        {
+          CHECK(config.interval_units > previous.interval_units);
+        }
+      }
+    }
+
+    // Only a new MTU needs a new connection
+    CHECK_EQUAL(bench_sweep_needs_reconnect(&sweep), mtu_changed);
+    reconnects += mtu_changed;
+
+    previous = config;
+    steps++;
+  }
+
+  CHECK_EQUAL(steps, bench_sweep_count());
+  CHECK_EQUAL(bench_sweep_count(), 3 * 2 * 3 * 4);
+  CHECK_EQUAL(reconnects, 2);
+
+  // The last is the largest of everything
+  CHECK_EQUAL(previous.att_mtu, 247);
+  CHECK_EQUAL(previous.data_length, 251);
+  CHECK_EQUAL(previous.phy, BENCH_PHY_CODED);
+  CHECK_EQUAL(previous.interval_units, 40);
+
+  // Done stays done
+  CHECK(sweep.done);
+  CHECK(!bench_sweep_next(&sweep));
+  CHECK(!bench_sweep_needs_reconnect(&sweep));
+}
+
+static void test_interval(void)
+{
+  CHECK_EQUAL(bench_interval_ms_x100(6), 750);
+  CHECK_EQUAL(bench_interval_ms_x100(40), 5000);
+}
+
+int main(void)
+{
+  test_order();
+  test_interval();
+  CHECK_DONE();
+}
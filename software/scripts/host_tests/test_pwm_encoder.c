@@ -0,0 +1,226 @@
+// Host tests of the color apps' strip encoder, for one pixel format
+//
+// Built once per LED_PIXEL_ORDER and LED_CHANNEL_BITS by the Makefile, against
+// the replay's SDK headers, with the PWM and GPIO calls stubbed out below.
+// Checks the bits of every channel against a reference that doesn't share
+// the driver's channel macros, then times set_led_to_color().
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Included rather than linked, to reach encode_byte(), scale_channel() and
+// the sequence data
+#include "pwm_driver.c"
+
+#include "check.h"
+
+#define BENCH_ROUNDS 200000
+
+// The order channels go out on the wire, written out independently of
+// led_strip.h
+#if LED_PIXEL_ORDER == LED_ORDER_GRB
+#define ORDER_NAME "GRB"
+#define WIRE_ORDER(c) {(c).green, (c).red, (c).blue}
+#elif LED_PIXEL_ORDER == LED_ORDER_RGB
+#define ORDER_NAME "RGB"
+#define WIRE_ORDER(c) {(c).red, (c).green, (c).blue}
+#elif LED_PIXEL_ORDER == LED_ORDER_GRBW
+#define ORDER_NAME "GRBW"
+#define WIRE_ORDER(c) {(c).green, (c).red, (c).blue, (c).white}
+#elif LED_PIXEL_ORDER == LED_ORDER_RGBW
+#define ORDER_NAME "RGBW"
+#define WIRE_ORDER(c) {(c).red, (c).green, (c).blue, (c).white}
+#endif
+
+// Stand-ins for the PWM driver and GPIO, recording the last playback
+static nrf_pwm_sequence_t const *played = NULL;
+static uint32_t playbacks = 0;
+
+void nrf_gpio_cfg_output(uint32_t pin_number) {}
+void nrf_gpio_pin_set(uint32_t pin_number) {}
+void nrf_gpio_pin_clear(uint32_t pin_number) {}
+void nrf_delay_us(uint32_t us_time) {}
+
+uint32_t nrfx_pwm_init(nrfx_pwm_t const *p_instance, nrfx_pwm_config_t const *p_config, nrfx_pwm_handler_t handler)
+{
+  return 0;
+}
+
+uint32_t nrfx_pwm_simple_playback(nrfx_pwm_t const *p_instance, nrf_pwm_sequence_t const *p_sequence,
+                                  uint16_t playback_count, uint32_t flags)
+{
+  played = p_sequence;
+  playbacks++;
+  return 0;
+}
+
+bool nrfx_pwm_stop(nrfx_pwm_t const *p_instance, bool wait_until_stopped)
+{
+  return true;
+}
+
+static color_t random_color(void)
+{
+  return (color_t){.val = (uint32_t)rand() << 16 ^ rand()};
+}
+
+// Checks one pixel's duty cycles: each channel's top LED_CHANNEL_BITS bits of
+// the 16-bit scaled value, MSB first
+static void check_pixel(nrf_pwm_values_common_t const *out, color_t color, uint32_t scale)
+{
+  uint8_t const channels[LED_CHANNEL_COUNT] = WIRE_ORDER(color);
+  for (uint32_t channel = 0; channel < LED_CHANNEL_COUNT; channel++)
+  {
+    uint32_t wide = channels[channel] * 257 * scale / 256;
+    uint32_t sent = wide >> (16 - LED_CHANNEL_BITS);
+    for (uint32_t bit = 0; bit < LED_CHANNEL_BITS; bit++)
+    {
+      bool one = (sent >> (LED_CHANNEL_BITS - 1 - bit)) & 1;
+      CHECK_EQUAL(out[channel * LED_CHANNEL_BITS + bit], one ? HIGH : LOW);
+    }
+  }
+}
+
+static void test_encode_byte(void)
+{
+  // Only the top byte of the 16-bit value is sent
+  for (uint32_t value = 0; value < 256; value++)
+  {
+    nrf_pwm_values_common_t out[8];
+    encode_byte(out, value << 8 | 0xA5);
+    for (uint32_t bit = 0; bit < 8; bit++)
+    {
+      CHECK_EQUAL(out[bit], (value >> (7 - bit)) & 1 ? HIGH : LOW);
+    }
+  }
+}
+
+static void test_scale_channel(void)
+{
+  // Full scale widens 0xFF to 0xFFFF, and the top byte is the value
+  for (uint32_t value = 0; value < 256; value++)
+  {
+    CHECK_EQUAL(scale_channel(value, 256), value * 257);
+    CHECK_EQUAL(scale_channel(value, 256) >> 8, value);
+    CHECK_EQUAL(scale_channel(value, 0), 0);
+  }
+  CHECK_EQUAL(scale_channel(255, 128), 0x7FFF);
+
+  // Never brighter for a lower value or scale
+  for (uint32_t scale = 1; scale <= 256; scale++)
+  {
+    for (uint32_t value = 1; value < 256; value++)
+    {
+      CHECK(scale_channel(value, scale) >= scale_channel(value - 1, scale));
+      CHECK(scale_channel(value, scale) >= scale_channel(value, scale - 1));
+    }
+  }
+}
+
+static void test_set_led_to_color(void)
+{
+  static const uint32_t SCALES[] = {0, 1, 77, 128, 255, 256};
+  for (int i = 0; i < 1000; i++)
+  {
+    color_t color = random_color();
+    uint32_t scale = SCALES[i % (sizeof(SCALES) / sizeof(SCALES[0]))];
+    uint32_t led = rand() % LED_COUNT;
+
+    // The neighbours are left alone
+    for (uint32_t j = 0; j < LED_DUTY_CYCLE_ARRAY_LENGTH; j++)
+    {
+      sequence_data[j] = 0x1234;
+    }
+    set_led_to_color(led, color, scale);
+    check_pixel(&sequence_data[led * LED_BITS_PER_PIXEL], color, scale);
+    for (uint32_t j = 0; j < LED_DUTY_CYCLE_ARRAY_LENGTH; j++)
+    {
+      if (j / LED_BITS_PER_PIXEL != led)
+      {
+        CHECK_EQUAL(sequence_data[j], 0x1234);
+      }
+    }
+  }
+
+  // Extremes of every channel
+  set_led_to_color(0, (color_t){.val = 0}, 256);
+  check_pixel(sequence_data, (color_t){.val = 0}, 256);
+  set_led_to_color(0, (color_t){.val = 0xFFFFFFFF}, 256);
+  check_pixel(sequence_data, (color_t){.val = 0xFFFFFFFF}, 256);
+}
+
+static void test_render_frame(void)
+{
+  pwm_init();
+  set_brightness(256);
+
+  // The first and last pixels lit, both well inside the power budget
+  color_t first = {.green = 10, .red = 20, .blue = 30, .white = 40};
+  color_t last = {.green = 50, .red = 60, .blue = 70, .white = 80};
+  set_pixel(0, first);
+  set_pixel(LED_COUNT - 1, last);
+  render_frame();
+
+  CHECK_EQUAL(playbacks, 1);
+  CHECK(played && played->values.p_common == sequence_data);
+  CHECK_EQUAL(played->length, LED_DUTY_CYCLE_ARRAY_LENGTH);
+  check_pixel(&sequence_data[0], first, 256);
+  check_pixel(&sequence_data[LED_BITS_PER_PIXEL], (color_t){.val = 0}, 256);
+  check_pixel(&sequence_data[(LED_COUNT - 1) * LED_BITS_PER_PIXEL], last, 256);
+
+  // One pixel of zeros at the end latches the strip
+  for (uint32_t j = LED_COUNT * LED_BITS_PER_PIXEL; j < LED_DUTY_CYCLE_ARRAY_LENGTH; j++)
+  {
+    CHECK_EQUAL(sequence_data[j], 0);
+  }
+
+  // A new brightness re-encodes every pixel
+  set_brightness(100);
+  render_frame();
+  check_pixel(&sequence_data[0], first, 100);
+  check_pixel(&sequence_data[(LED_COUNT - 1) * LED_BITS_PER_PIXEL], last, 100);
+}
+
+static double seconds(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Not a check: prints the time to encode a pixel in this format
+static void bench_set_led_to_color(void)
+{
+  static color_t colors[LED_COUNT];
+  for (uint32_t led = 0; led < LED_COUNT; led++)
+  {
+    colors[led] = random_color();
+  }
+
+  double start = seconds();
+  for (int round = 0; round < BENCH_ROUNDS; round++)
+  {
+    for (uint32_t led = 0; led < LED_COUNT; led++)
+    {
+      set_led_to_color(led, colors[led], 200);
+    }
+    // Kept so the rounds aren't folded into one
+    __asm__ volatile("" ::: "memory");
+  }
+  double elapsed = seconds() - start;
+
+  printf("set_led_to_color, %s %d-bit: %.1f ns per pixel\n", ORDER_NAME, LED_CHANNEL_BITS,
+         elapsed * 1e9 / ((double)BENCH_ROUNDS * LED_COUNT));
+}
+
+int main(void)
+{
+  test_encode_byte();
+  test_scale_channel();
+  test_set_led_to_color();
+  test_render_frame();
+  bench_set_led_to_color();
+  CHECK_DONE();
+}
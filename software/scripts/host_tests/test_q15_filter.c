@@ -0,0 +1,322 @@
+// Host tests of analog_read's Q15 filters
+//
+// The host has no DSP extension, so this runs the plain C smlad() and checks
+// it against the instruction's definition, then every filter against golden
+// vectors and a direct reference, fed in blocks of many sizes.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Included rather than linked, to reach smlad() and ssat16()
+#include "q15_filter.c"
+
+#include "check.h"
+
+#define STREAM_LENGTH 2000
+
+static int16_t input[STREAM_LENGTH];
+static int16_t output[STREAM_LENGTH];
+static int16_t expected[STREAM_LENGTH];
+
+// Block sizes a stream is fed in, cycled through
+static const uint16_t BLOCK_SIZES[] = {1, 2, 3, 7, 64, 255, 256, 13};
+#define BLOCK_SIZE_COUNT (sizeof(BLOCK_SIZES) / sizeof(BLOCK_SIZES[0]))
+
+static int16_t random_q15(void)
+{
+  return (int16_t)(rand() & 0xFFFF);
+}
+
+static uint32_t pack(int16_t low, int16_t high)
+{
+  return (uint16_t)low | ((uint32_t)(uint16_t)high << 16);
+}
+
+static void test_smlad(void)
+{
+  // Both halves multiplied pairwise and added to the accumulator, as SMLAD
+  CHECK_EQUAL(smlad(pack(3, -4), pack(5, 6), 100), 100 + 15 - 24);
+  CHECK_EQUAL(smlad(pack(INT16_MIN, 0), pack(INT16_MIN, 0), 0), 1 << 30);
+  CHECK_EQUAL(smlad(pack(INT16_MAX, INT16_MIN), pack(INT16_MIN, INT16_MAX), 0),
+              2 * (int32_t)INT16_MAX * INT16_MIN);
+
+  for (int i = 0; i < 100000; i++)
+  {
+    int16_t a = random_q15(), b = random_q15(), c = random_q15(), d = random_q15();
+    int32_t acc = rand() % (1 << 29) - (1 << 28);
+    int64_t reference = (int64_t)acc + (int64_t)a * c + (int64_t)b * d;
+    // The filters keep the accumulator in range, see q15_fir_decimate_t
+    if (reference < INT32_MIN || reference > INT32_MAX)
+    {
+      continue;
+    }
+    CHECK_EQUAL(smlad(pack(a, b), pack(c, d), acc), reference);
+  }
+
+  CHECK_EQUAL(ssat16(40000), INT16_MAX);
+  CHECK_EQUAL(ssat16(-40000), INT16_MIN);
+  CHECK_EQUAL(ssat16(-5), -5);
+}
+
+static void test_moving_average(void)
+{
+  // Golden: starts as if preceded by zeros, divides towards zero
+  static const int16_t in[] = {4, 8, 12, 16, 20, -4, -100, -100, -100, -100};
+  static const int16_t golden[] = {1, 3, 6, 10, 14, 11, -17, -46, -76, -100};
+  q15_moving_average_t filter;
+  q15_moving_average_init(&filter, 4);
+  int16_t out[10];
+  q15_moving_average(&filter, in, out, 10);
+  for (int i = 0; i < 10; i++)
+  {
+    CHECK_EQUAL(out[i], golden[i]);
+  }
+
+  // Lengths past the history are clamped, 0 passes samples through
+  q15_moving_average_init(&filter, 1000);
+  CHECK_EQUAL(filter.length, Q15_MOVING_AVERAGE_MAX);
+  q15_moving_average_init(&filter, 0);
+  q15_moving_average(&filter, in, out, 10);
+  for (int i = 0; i < 10; i++)
+  {
+    CHECK_EQUAL(out[i], in[i]);
+  }
+
+  // Against a direct mean over a stream of full scale noise, in blocks
+  for (uint16_t length = 1; length <= Q15_MOVING_AVERAGE_MAX; length = length * 2 + 1)
+  {
+    for (int i = 0; i < STREAM_LENGTH; i++)
+    {
+      int32_t sum = 0;
+      for (int k = 0; k < length && k <= i; k++)
+      {
+        sum += input[i - k];
+      }
+      expected[i] = sum / length;
+    }
+
+    q15_moving_average_init(&filter, length);
+    int done = 0;
+    for (int block = 0; done < STREAM_LENGTH; block++)
+    {
+      int count = BLOCK_SIZES[block % BLOCK_SIZE_COUNT];
+      count = count < STREAM_LENGTH - done ? count : STREAM_LENGTH - done;
+      q15_moving_average(&filter, &input[done], &output[done], count);
+      done += count;
+    }
+
+    int wrong = 0;
+    for (int i = 0; i < STREAM_LENGTH; i++)
+    {
+      wrong += output[i] != expected[i];
+    }
+    CHECK_EQUAL(wrong, 0);
+  }
+}
+
+// Direct form FIR with the filter's rounding, keeping every factor-th output
+static uint32_t reference_fir(int16_t const *coeffs, uint16_t taps, uint8_t factor)
+{
+  uint32_t outputs = 0;
+  for (uint32_t n = factor - 1; n < STREAM_LENGTH; n += factor)
+  {
+    int64_t acc = 0;
+    for (uint32_t k = 0; k < taps && k <= n; k++)
+    {
+      acc += (int32_t)coeffs[k] * input[n - k];
+    }
+    expected[outputs++] = ssat16(acc >> 15);
+  }
+  return outputs;
+}
+
+static uint32_t run_fir(int16_t const *coeffs, uint16_t taps, uint8_t factor, int block_offset)
+{
+  static q15_fir_decimate_t filter;
+  q15_fir_decimate_init(&filter, coeffs, taps, factor);
+
+  uint32_t outputs = 0;
+  int done = 0;
+  for (int block = block_offset; done < STREAM_LENGTH; block++)
+  {
+    int count = BLOCK_SIZES[block % BLOCK_SIZE_COUNT];
+    count = count < STREAM_LENGTH - done ? count : STREAM_LENGTH - done;
+    outputs += q15_fir_decimate(&filter, &input[done], &output[outputs], count);
+    done += count;
+  }
+  return outputs;
+}
+
+static void test_fir_decimate(void)
+{
+  // Golden: 0.5, 0.25, 0.25 on an impulse and a step, odd taps
+  static const int16_t coeffs[] = {16384, 8192, 8192};
+  static const int16_t in[] = {1000, 0, 0, 0, 2000, 2000, 2000, 2000, -2000};
+  static const int16_t golden[] = {500, 250, 250, 0, 1000, 1500, 2000, 2000, 0};
+  static q15_fir_decimate_t filter;
+  int16_t out[9];
+
+  q15_fir_decimate_init(&filter, coeffs, 3, 1);
+  CHECK_EQUAL(q15_fir_decimate(&filter, in, out, 9), 9);
+  for (int i = 0; i < 9; i++)
+  {
+    CHECK_EQUAL(out[i], golden[i]);
+  }
+
+  // Decimating by 2 keeps every second output, the first at the 2nd input
+  q15_fir_decimate_init(&filter, coeffs, 3, 2);
+  CHECK_EQUAL(q15_fir_decimate(&filter, in, out, 9), 4);
+  for (int i = 0; i < 4; i++)
+  {
+    CHECK_EQUAL(out[i], golden[2 * i + 1]);
+  }
+
+  // The same, one sample at a time
+  q15_fir_decimate_init(&filter, coeffs, 3, 2);
+  uint16_t outputs = 0;
+  for (int i = 0; i < 9; i++)
+  {
+    outputs += q15_fir_decimate(&filter, &in[i], &out[outputs], 1);
+  }
+  CHECK_EQUAL(outputs, 4);
+  CHECK_EQUAL(out[3], golden[7]);
+
+  // Against the reference: odd and even taps up to the maximum, several
+  // factors, random coefficients within the 2.0 gain limit, and block sizes
+  // that put the block boundaries everywhere in the decimation phase
+  static const uint16_t TAPS[] = {1, 2, 3, 5, 8, 15, 31, Q15_FIR_MAX_TAPS};
+  static const uint8_t FACTORS[] = {1, 2, 3, 4, 7};
+  for (uint32_t t = 0; t < sizeof(TAPS) / sizeof(TAPS[0]); t++)
+  {
+    uint16_t taps = TAPS[t];
+    int16_t random_coeffs[Q15_FIR_MAX_TAPS];
+    int32_t total = 0;
+    for (uint16_t k = 0; k < taps; k++)
+    {
+      random_coeffs[k] = random_q15();
+      total += abs(random_coeffs[k]);
+    }
+    for (uint16_t k = 0; k < taps; k++)
+    {
+      random_coeffs[k] = (int64_t)random_coeffs[k] * 65000 / total;
+    }
+
+    for (uint32_t f = 0; f < sizeof(FACTORS) / sizeof(FACTORS[0]); f++)
+    {
+      uint32_t reference_outputs = reference_fir(random_coeffs, taps, FACTORS[f]);
+      for (int offset = 0; offset < (int)BLOCK_SIZE_COUNT; offset += 3)
+      {
+        uint32_t outputs = run_fir(random_coeffs, taps, FACTORS[f], offset);
+        CHECK_EQUAL(outputs, reference_outputs);
+
+        int wrong = 0;
+        for (uint32_t i = 0; i < reference_outputs; i++)
+        {
+          wrong += output[i] != expected[i];
+        }
+        if (wrong)
+        {
+          fprintf(stderr, "%u taps, factor %u, block offset %d:\n", taps, FACTORS[f], offset);
+        }
+        CHECK_EQUAL(wrong, 0);
+      }
+    }
+  }
+
+  // Gain just under 2.0 on a full scale input saturates instead of wrapping
+  static const int16_t loud[] = {INT16_MAX, INT16_MAX};
+  static const int16_t full_scale[] = {INT16_MAX, INT16_MAX, INT16_MIN, INT16_MIN};
+  q15_fir_decimate_init(&filter, loud, 2, 1);
+  CHECK_EQUAL(q15_fir_decimate(&filter, full_scale, out, 4), 4);
+  CHECK_EQUAL(out[0], INT16_MAX - 1);
+  CHECK_EQUAL(out[1], INT16_MAX);
+  CHECK_EQUAL(out[2], -1);
+  CHECK_EQUAL(out[3], INT16_MIN);
+}
+
+static void test_iir(void)
+{
+  // Golden: alpha 0.5 on a step of 1000, rounding to nearest
+  static const int16_t in[] = {1000, 1000, 1000, 1000, 1000, -1000};
+  static const int16_t golden[] = {500, 750, 875, 938, 969, -16};
+  q15_iir_t filter;
+  q15_iir_init(&filter, 16384, 0);
+  int16_t out[6];
+  q15_iir(&filter, in, out, 6);
+  for (int i = 0; i < 6; i++)
+  {
+    CHECK_EQUAL(out[i], golden[i]);
+  }
+
+  // Starts at the initial value
+  q15_iir_init(&filter, 16384, 1000);
+  q15_iir(&filter, &in[0], out, 1);
+  CHECK_EQUAL(out[0], 1000);
+
+  // A small alpha still settles exactly on the input, either way, instead of
+  // stalling a few counts short
+  q15_iir_init(&filter, 100, 0);
+  for (int i = 0; i < STREAM_LENGTH; i++)
+  {
+    expected[i] = 1000;
+  }
+  for (int i = 0; i < 5; i++)
+  {
+    q15_iir(&filter, expected, output, STREAM_LENGTH);
+  }
+  CHECK_EQUAL(output[STREAM_LENGTH - 1], 1000);
+  for (int i = 0; i < STREAM_LENGTH; i++)
+  {
+    expected[i] = -1000;
+  }
+  for (int i = 0; i < 5; i++)
+  {
+    q15_iir(&filter, expected, output, STREAM_LENGTH);
+  }
+  CHECK_EQUAL(output[STREAM_LENGTH - 1], -1000);
+
+  // Time constant of about 32768 / alpha samples: 63% of a step by then
+  q15_iir_init(&filter, 328, 0);
+  for (int i = 0; i < STREAM_LENGTH; i++)
+  {
+    expected[i] = 10000;
+  }
+  q15_iir(&filter, expected, output, 100);
+  CHECK(abs(output[99] - 6321) < 50);
+
+  // Block size doesn't matter
+  q15_iir_t whole, pieces;
+  q15_iir_init(&whole, 1234, -50);
+  q15_iir_init(&pieces, 1234, -50);
+  q15_iir(&whole, input, expected, STREAM_LENGTH);
+  int done = 0;
+  for (int block = 0; done < STREAM_LENGTH; block++)
+  {
+    int count = BLOCK_SIZES[block % BLOCK_SIZE_COUNT];
+    count = count < STREAM_LENGTH - done ? count : STREAM_LENGTH - done;
+    q15_iir(&pieces, &input[done], &output[done], count);
+    done += count;
+  }
+  int wrong = 0;
+  for (int i = 0; i < STREAM_LENGTH; i++)
+  {
+    wrong += output[i] != expected[i];
+  }
+  CHECK_EQUAL(wrong, 0);
+}
+
+int main(void)
+{
+  srand(1);
+  for (int i = 0; i < STREAM_LENGTH; i++)
+  {
+    input[i] = random_q15();
+  }
+
+  test_smlad();
+  test_moving_average();
+  test_fir_decimate();
+  test_iir();
+  CHECK_DONE();
+}
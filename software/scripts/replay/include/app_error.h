@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+typedef uint32_t ret_code_t;
+
+#define NRF_SUCCESS 0
+#define NRF_ERROR_NO_MEM 4
+#define NRF_ERROR_INVALID_LENGTH 9
+#define NRF_ERROR_INVALID_ADDR 16
+
+void sim_error(ret_code_t err_code, char const *file, int line);
+
+#define APP_ERROR_CHECK(err_code)                 \
+  do                                              \
+  {                                               \
+    if ((err_code) != NRF_SUCCESS)                \
+    {                                             \
+      sim_error((err_code), __FILE__, __LINE__);  \
+    }                                             \
+  } while (0)
+
+#define APP_ERROR_CHECK_BOOL(condition)           \
+  do                                              \
+  {                                               \
+    if (!(condition))                             \
+    {                                             \
+      sim_error(0, __FILE__, __LINE__);           \
+    }                                             \
+  } while (0)
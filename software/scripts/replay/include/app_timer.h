@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_error.h"
+
+// app_timer on simulated time, see sim_timer.c. Ticks are the 24-bit RTC
+// counter at 32768 Hz, as on the board
+
+#define APP_TIMER_CLOCK_FREQ 32768
+#define APP_TIMER_MIN_TIMEOUT_TICKS 5
+#define APP_TIMER_TICKS(MS) ((uint32_t)(((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ + 500) / 1000))
+
+typedef void (*app_timer_timeout_handler_t)(void *p_context);
+
+typedef enum
+{
+  APP_TIMER_MODE_SINGLE_SHOT,
+  APP_TIMER_MODE_REPEATED,
+} app_timer_mode_t;
+
+typedef struct app_timer
+{
+  app_timer_timeout_handler_t handler;
+  app_timer_mode_t mode;
+  bool active;
+  uint64_t expiry_ticks;
+  uint32_t period_ticks;
+  void *context;
+  struct app_timer *next; // every timer ever created
+} app_timer_t;
+
+typedef app_timer_t *app_timer_id_t;
+
+#define APP_TIMER_DEF(timer_id)              \
+  static app_timer_t timer_id##_data = {0}; \
+  static const app_timer_id_t timer_id = &timer_id##_data
+
+ret_code_t app_timer_init(void);
+ret_code_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode,
+                            app_timer_timeout_handler_t timeout_handler);
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context);
+ret_code_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(void);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from);
@@ -0,0 +1,10 @@
+#pragma once
+
+enum
+{
+  UNIT_0_625_MS = 625,
+  UNIT_1_25_MS = 1250,
+  UNIT_10_MS = 10000,
+};
+
+#define MSEC_TO_UNITS(TIME, RESOLUTION) (((TIME) * 1000) / (RESOLUTION))
@@ -0,0 +1,8 @@
+#pragma once
+
+// Everything runs on one thread, so there is nothing to lock out
+#define CRITICAL_REGION_ENTER() {
+#define CRITICAL_REGION_EXIT() }
+
+#define APP_IRQ_PRIORITY_LOW 6
+#define APP_IRQ_PRIORITY_LOWEST 7
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ble_gap.h"
+
+#define BLE_CONN_HANDLE_INVALID 0xFFFF
+
+typedef struct
+{
+  uint16_t evt_id;
+  uint16_t evt_len;
+} ble_evt_hdr_t;
+
+typedef struct
+{
+  ble_evt_hdr_t header;
+  union
+  {
+    ble_gap_evt_t gap_evt;
+  } evt;
+} ble_evt_t;
+
+typedef struct
+{
+  uint16_t value_handle;
+  uint16_t user_desc_handle;
+  uint16_t cccd_handle;
+  uint16_t sccd_handle;
+} ble_gatts_char_handles_t;
+
+typedef struct
+{
+  uint16_t len;
+  uint16_t offset;
+  uint8_t *p_value;
+} ble_gatts_value_t;
+
+// Accepted and dropped, nothing reads the characteristics
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t *p_value);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+#define BLE_GAP_ADDR_LEN 6
+#define BLE_GAP_EVT_ADV_REPORT 0x1D
+
+typedef struct
+{
+  uint8_t addr_id_peer : 1;
+  uint8_t addr_type : 7;
+  uint8_t addr[BLE_GAP_ADDR_LEN]; // least significant byte first
+} ble_gap_addr_t;
+
+typedef struct
+{
+  uint8_t *p_data;
+  uint16_t len;
+} ble_data_t;
+
+typedef struct
+{
+  ble_gap_addr_t peer_addr;
+  int8_t tx_power;
+  int8_t rssi;
+  uint8_t ch_index;
+  ble_data_t data;
+} ble_gap_evt_adv_report_t;
+
+typedef struct
+{
+  uint16_t conn_handle;
+  union
+  {
+    ble_gap_evt_adv_report_t adv_report;
+  } params;
+} ble_gap_evt_t;
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// The SDK's CRC-16-CCITT, sim_flash.c
+uint16_t crc16_compute(uint8_t const *p_data, uint32_t size, uint16_t const *p_crc);
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "app_error.h"
+
+ret_code_t nrf_mem_init(void);
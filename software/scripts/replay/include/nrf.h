@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+// Cycle counter, which the simulation advances at 64 per simulated us
+typedef struct
+{
+  uint32_t CTRL;
+  uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+  uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type sim_dwt;
+extern CoreDebug_Type sim_core_debug;
+extern uint32_t SystemCoreClock;
+
+#define DWT (&sim_dwt)
+#define CoreDebug (&sim_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk 1
+#define CoreDebug_DEMCR_TRCENA_Msk (1 << 24)
+
+// One thread on the host, only the compiler needs holding back
+#define __DMB() __asm__ volatile("" ::: "memory")
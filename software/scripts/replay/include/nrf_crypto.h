@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_error.h"
+
+// AES-CMAC for tag_auth.c, in software, see sim_crypto.c
+
+typedef enum
+{
+  NRF_CRYPTO_ENCRYPT,
+  NRF_CRYPTO_DECRYPT,
+  NRF_CRYPTO_MAC_CALCULATE,
+} nrf_crypto_operation_t;
+
+typedef struct
+{
+  int mode;
+} nrf_crypto_aes_info_t;
+
+typedef struct
+{
+  uint8_t key[16];
+} nrf_crypto_aes_context_t;
+
+extern nrf_crypto_aes_info_t const g_nrf_crypto_aes_cmac_128_info;
+
+ret_code_t nrf_crypto_init(void);
+ret_code_t nrf_crypto_aes_init(nrf_crypto_aes_context_t *p_context, nrf_crypto_aes_info_t const *p_info,
+                               nrf_crypto_operation_t operation);
+ret_code_t nrf_crypto_aes_key_set(nrf_crypto_aes_context_t *p_context, uint8_t *p_key);
+ret_code_t nrf_crypto_aes_finalize(nrf_crypto_aes_context_t *p_context, uint8_t *p_data_in, size_t data_size,
+                                   uint8_t *p_data_out, size_t *p_data_out_size);
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Busy waits take their simulated time
+void nrf_delay_us(uint32_t us_time);
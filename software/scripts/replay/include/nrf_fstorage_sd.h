@@ -0,0 +1,5 @@
+#pragma once
+
+#include "nrf_fstorage.h"
+
+extern nrf_fstorage_api_t nrf_fstorage_sd;
@@ -0,0 +1,4 @@
+#pragma once
+
+// Only for ambient.h's default input, the replay stands in for ambient.c
+#define NRF_SAADC_INPUT_AIN7 8
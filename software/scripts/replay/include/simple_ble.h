@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "app_util.h"
+#include "ble.h"
+
+// simple_ble as color_scan uses it, see sim_board.c. Adverts from the trace
+// reach the app through ble_evt_adv_report(), as they would from the
+// SoftDevice
+
+typedef struct
+{
+  uint8_t platform_id;
+  uint16_t device_id;
+  char const *adv_name;
+  uint16_t adv_interval;
+  uint16_t min_conn_interval;
+  uint16_t max_conn_interval;
+} simple_ble_config_t;
+
+typedef struct
+{
+  uint16_t conn_handle;
+} simple_ble_app_t;
+
+typedef struct
+{
+  struct
+  {
+    uint8_t uuid128[16];
+  } uuid_block;
+  uint16_t uuid16;
+  uint16_t service_handle;
+} simple_ble_service_t;
+
+typedef struct
+{
+  uint16_t uuid16;
+  ble_gatts_char_handles_t char_handle;
+} simple_ble_char_t;
+
+simple_ble_app_t *simple_ble_init(simple_ble_config_t const *conf);
+void simple_ble_add_service(simple_ble_service_t *service);
+void simple_ble_add_characteristic(uint8_t read, uint8_t write, uint8_t notify, uint8_t vlen, uint16_t len,
+                                   uint8_t *buf, simple_ble_service_t *service, simple_ble_char_t *p_char);
+uint32_t simple_ble_notify_char(simple_ble_char_t *p_char);
+void simple_ble_adv_only_name(void);
+void advertising_stop(void);
+void scanning_start(void);
+void power_manage(void);
+
+// Implemented by the app
+void ble_evt_adv_report(ble_evt_t const *p_ble_evt);
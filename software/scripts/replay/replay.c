@@ -0,0 +1,364 @@
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ble.h"
+#include "latency.h"
+#include "simple_ble.h"
+
+#include "sim.h"
+
+// Longest legacy advertising data
+#define ADV_DATA_MAX_LENGTH 31
+
+typedef struct
+{
+  uint64_t time_us;
+  uint8_t addr[BLE_GAP_ADDR_LEN]; // least significant byte first, as on air
+  int8_t rssi;
+  uint8_t length;
+  uint8_t data[ADV_DATA_MAX_LENGTH];
+} advert_t;
+
+static advert_t *adverts = NULL;
+static size_t advert_count = 0;
+static size_t next_advert = 0;
+static uint64_t end_us = 0;
+
+static bool quiet = false;
+static bool throughput = false;
+static uint32_t max_latency_us = 0;
+static FILE *timeline = NULL;
+
+static bool console_line_start = true;
+static uint64_t run_start_ns;
+static uint64_t advert_ns = 0;
+
+// color_scan's main(), renamed when it's built for the replay
+int color_scan_main(void);
+
+static uint64_t wall_ns(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+int sim_printf(char const *format, ...)
+{
+  if (quiet)
+  {
+    return 0;
+  }
+
+  // Every line starts with the simulated time
+  char text[512];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+
+  for (char const *c = text; *c; c++)
+  {
+    if (console_line_start)
+    {
+      fprintf(stderr, "[%10.3f] ", sim_now_us() / 1000.0);
+    }
+    fputc(*c, stderr);
+    console_line_start = *c == '\n';
+  }
+  return length;
+}
+
+static int hex_value(char c)
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f')
+  {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F')
+  {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// One advert per line: time_ms address rssi data, where the address is
+// written as usual (c0:98:e5:4e:cc:dd) and data is the advertising data in
+// hex. Blank lines and lines starting with # are skipped
+static bool parse_advert(char const *line, advert_t *advert)
+{
+  double time_ms;
+  unsigned int addr[BLE_GAP_ADDR_LEN];
+  int rssi;
+  char hex[2 * ADV_DATA_MAX_LENGTH + 2];
+
+  if (sscanf(line, "%lf %x:%x:%x:%x:%x:%x %d %63s", &time_ms, &addr[5], &addr[4], &addr[3], &addr[2], &addr[1],
+             &addr[0], &rssi, hex) != 9)
+  {
+    return false;
+  }
+
+  size_t digits = strlen(hex);
+  if (time_ms < 0 || digits % 2 || digits / 2 > ADV_DATA_MAX_LENGTH)
+  {
+    return false;
+  }
+
+  advert->time_us = (uint64_t)(time_ms * 1000);
+  for (int i = 0; i < BLE_GAP_ADDR_LEN; i++)
+  {
+    advert->addr[i] = addr[i];
+  }
+  advert->rssi = rssi;
+  advert->length = digits / 2;
+  for (size_t i = 0; i < advert->length; i++)
+  {
+    int high = hex_value(hex[2 * i]);
+    int low = hex_value(hex[2 * i + 1]);
+    if (high < 0 || low < 0)
+    {
+      return false;
+    }
+    advert->data[i] = high << 4 | low;
+  }
+  return true;
+}
+
+static bool load_trace(char const *path)
+{
+  FILE *file = strcmp(path, "-") ? fopen(path, "r") : stdin;
+  if (!file)
+  {
+    perror(path);
+    return false;
+  }
+
+  size_t capacity = 0;
+  char line[256];
+  unsigned int line_number = 0;
+  while (fgets(line, sizeof(line), file))
+  {
+    line_number++;
+    char const *start = line + strspn(line, " \t");
+    if (*start == '#' || *start == '\n' || *start == '\0')
+    {
+      continue;
+    }
+
+    if (advert_count == capacity)
+    {
+      capacity = capacity ? capacity * 2 : 1024;
+      adverts = realloc(adverts, capacity * sizeof(advert_t));
+    }
+    advert_t *advert = &adverts[advert_count];
+    if (!parse_advert(start, advert))
+    {
+      fprintf(stderr, "%s:%u: expected time_ms address rssi data\n", path, line_number);
+      return false;
+    }
+    if (advert_count && advert->time_us < adverts[advert_count - 1].time_us)
+    {
+      fprintf(stderr, "%s:%u: adverts must be in time order\n", path, line_number);
+      return false;
+    }
+    advert_count++;
+  }
+
+  if (file != stdin)
+  {
+    fclose(file);
+  }
+  return true;
+}
+
+static void deliver_advert(advert_t *advert)
+{
+  ble_evt_t event = {.header.evt_id = BLE_GAP_EVT_ADV_REPORT};
+  ble_gap_evt_adv_report_t *report = &event.evt.gap_evt.params.adv_report;
+  memcpy(report->peer_addr.addr, advert->addr, sizeof(advert->addr));
+  report->rssi = advert->rssi;
+  report->data.p_data = advert->data;
+  report->data.len = advert->length;
+
+  uint64_t start = wall_ns();
+  ble_evt_adv_report(&event);
+  advert_ns += wall_ns() - start;
+}
+
+static void finish(void)
+{
+  uint64_t run_ns = wall_ns() - run_start_ns;
+  latency_histogram_t const *total = &latency_histograms()[LATENCY_STAGE_TOTAL];
+
+  if (timeline)
+  {
+    fflush(timeline);
+  }
+  sim_flash_finish();
+
+  fprintf(stderr, "%zu adverts, %lu frames over %.3f s simulated\n", advert_count, (unsigned long)sim_strip_frames(),
+          sim_now_us() / 1000000.0);
+  fprintf(stderr, "Advert to light: %u changes, mean %u us, max %u us\n", total->count,
+          total->count ? total->total_us / total->count : 0, total->max_us);
+
+  if (throughput)
+  {
+    double run_s = run_ns / 1e9;
+    fprintf(stderr, "%.3f s on the host: %.0f adverts/s with timers and frames, %.0f adverts/s through "
+                    "ble_evt_adv_report (%.0f ns each)\n",
+            run_s, advert_count / run_s, advert_count / (advert_ns / 1e9),
+            advert_count ? (double)advert_ns / advert_count : 0.0);
+  }
+
+  if (max_latency_us && total->max_us > max_latency_us)
+  {
+    fprintf(stderr, "Advert to light latency of %u us is over the %u us limit\n", total->max_us, max_latency_us);
+    exit(1);
+  }
+  exit(0);
+}
+
+// The app sleeps here between events, so this is where simulated time moves:
+// on to the next playback end, flash operation, timer or advert, whichever
+// comes first
+void power_manage(void)
+{
+  uint64_t advert_us = next_advert < advert_count ? adverts[next_advert].time_us : end_us;
+  uint64_t timer_us = sim_timer_next_us();
+  uint64_t strip_us = sim_strip_next_us();
+  uint64_t flash_us = sim_flash_next_us();
+
+  // Interrupts due at the same time as an advert are handled first
+  if (strip_us <= timer_us && strip_us <= advert_us && strip_us <= flash_us)
+  {
+    sim_advance_to(strip_us);
+    sim_strip_fire();
+  }
+  else if (flash_us <= timer_us && flash_us <= advert_us)
+  {
+    sim_advance_to(flash_us);
+    sim_flash_fire();
+  }
+  else if (timer_us <= advert_us)
+  {
+    sim_advance_to(timer_us);
+    sim_timer_fire();
+  }
+  else if (next_advert < advert_count)
+  {
+    sim_advance_to(advert_us);
+    deliver_advert(&adverts[next_advert++]);
+  }
+  else
+  {
+    sim_advance_to(end_us);
+    finish();
+  }
+}
+
+static void usage(char const *name)
+{
+  fprintf(stderr,
+          "usage: %s [options] trace\n"
+          "\n"
+          "Replays an advert trace through color_scan on simulated time and writes the\n"
+          "frames the strip shows as CSV. The trace has one advert per line:\n"
+          "time_ms address rssi data, see README.md. - reads it from stdin\n"
+          "\n"
+          "  -o, --output FILE        write the timeline here instead of stdout\n"
+          "  -q, --quiet              leave out the app's console output\n"
+          "  --flash FILE             keep the app's flash in this file from run to run\n"
+          "  --tail MS                keep going this long after the last advert (3000)\n"
+          "  --throughput             measure how fast adverts are absorbed, no timeline\n"
+          "  --max-latency US         fail if an advert takes longer to reach the strip\n",
+          name);
+}
+
+int main(int argc, char **argv)
+{
+  enum
+  {
+    OPTION_TAIL = 256,
+    OPTION_THROUGHPUT,
+    OPTION_MAX_LATENCY,
+    OPTION_FLASH,
+  };
+  static struct option const OPTIONS[] = {
+      {"output", required_argument, NULL, 'o'},
+      {"quiet", no_argument, NULL, 'q'},
+      {"tail", required_argument, NULL, OPTION_TAIL},
+      {"throughput", no_argument, NULL, OPTION_THROUGHPUT},
+      {"max-latency", required_argument, NULL, OPTION_MAX_LATENCY},
+      {"flash", required_argument, NULL, OPTION_FLASH},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0},
+  };
+
+  char const *output_path = NULL;
+  uint64_t tail_ms = 3000;
+  int option;
+  while ((option = getopt_long(argc, argv, "o:qh", OPTIONS, NULL)) != -1)
+  {
+    switch (option)
+    {
+    case 'o':
+      output_path = optarg;
+      break;
+    case 'q':
+      quiet = true;
+      break;
+    case OPTION_TAIL:
+      tail_ms = strtoull(optarg, NULL, 10);
+      break;
+    case OPTION_THROUGHPUT:
+      throughput = true;
+      quiet = true;
+      break;
+    case OPTION_MAX_LATENCY:
+      max_latency_us = strtoul(optarg, NULL, 10);
+      break;
+    case OPTION_FLASH:
+      sim_flash_set_image(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return option == 'h' ? 0 : 2;
+    }
+  }
+  if (optind != argc - 1)
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (!load_trace(argv[optind]))
+  {
+    return 2;
+  }
+  end_us = (advert_count ? adverts[advert_count - 1].time_us : 0) + tail_ms * 1000;
+
+  if (!throughput)
+  {
+    timeline = output_path ? fopen(output_path, "w") : stdout;
+    if (!timeline)
+    {
+      perror(output_path);
+      return 2;
+    }
+    sim_strip_set_output(timeline);
+  }
+
+  // Runs until power_manage() runs out of trace
+  run_start_ns = wall_ns();
+  return color_scan_main();
+}
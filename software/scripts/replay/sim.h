@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Host replay of color_scan
+//
+// color_scan's own sources are built unchanged against stand-ins for the
+// SDK. Time is simulated: it only moves when the app goes to sleep in
+// power_manage(), which jumps to the next advert, timer or end of a PWM
+// playback or flash operation and delivers it, or when the app busy-waits. Code runs in no
+// time at all, so latencies measured here are the ones the app's structure
+// causes (timers, frame scheduling, playback), not CPU time.
+
+#define SIM_NO_EVENT UINT64_MAX
+
+// Simulated clock
+uint64_t sim_now_us(void);
+void sim_advance_to(uint64_t us);
+
+// app_timer, sim_timer.c
+uint64_t sim_timer_next_us(void);
+void sim_timer_fire(void);
+
+// PWM and strip power, sim_strip.c
+uint64_t sim_strip_next_us(void);
+void sim_strip_fire(void);
+void sim_strip_set_output(FILE *timeline);
+uint32_t sim_strip_frames(void);
+
+// nrf_fstorage and the SDK's CRC-16, sim_flash.c. The image file, if any,
+// is loaded when the app starts the store and saved by sim_flash_finish()
+void sim_flash_set_image(char const *path);
+uint64_t sim_flash_next_us(void);
+void sim_flash_fire(void);
+void sim_flash_finish(void);
+
+// Console output from the app, printf is redirected here
+int sim_printf(char const *format, ...) __attribute__((format(printf, 1, 2)));
@@ -0,0 +1,70 @@
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ambient.h"
+#include "app_error.h"
+#include "simple_ble.h"
+
+#include "sim.h"
+
+// simple_ble: nothing to set up, adverts come from the trace
+static simple_ble_app_t app = {.conn_handle = BLE_CONN_HANDLE_INVALID};
+
+simple_ble_app_t *simple_ble_init(simple_ble_config_t const *conf)
+{
+  return &app;
+}
+
+void simple_ble_add_service(simple_ble_service_t *service)
+{
+}
+
+void simple_ble_add_characteristic(uint8_t read, uint8_t write, uint8_t notify, uint8_t vlen, uint16_t len,
+                                   uint8_t *buf, simple_ble_service_t *service, simple_ble_char_t *p_char)
+{
+}
+
+uint32_t simple_ble_notify_char(simple_ble_char_t *p_char)
+{
+  return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gatts_value_set(uint16_t conn_handle, uint16_t handle, ble_gatts_value_t *p_value)
+{
+  return NRF_SUCCESS;
+}
+
+void simple_ble_adv_only_name(void)
+{
+}
+
+void advertising_stop(void)
+{
+}
+
+void scanning_start(void)
+{
+}
+
+// Ambient light: a steady, bright room
+void ambient_init(ambient_handler_t handler)
+{
+}
+
+int32_t ambient_level_mv(void)
+{
+  return AMBIENT_BRIGHT_MV;
+}
+
+uint32_t ambient_brightness(void)
+{
+  return AMBIENT_MAX_SCALE;
+}
+
+void sim_error(ret_code_t err_code, char const *file, int line)
+{
+  fprintf(stderr, "%.3f ms: error 0x%x at %s:%d\n", sim_now_us() / 1000.0, err_code, file, line);
+  exit(2);
+}
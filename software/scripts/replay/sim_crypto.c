@@ -0,0 +1,189 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mem_manager.h"
+#include "nrf_crypto.h"
+
+// AES-128 and CMAC (RFC 4493) in plain C, standing in for the CC310
+
+nrf_crypto_aes_info_t const g_nrf_crypto_aes_cmac_128_info = {0};
+
+static uint8_t sbox[256];
+
+static uint8_t xtime(uint8_t b)
+{
+  return (b << 1) ^ (b & 0x80 ? 0x1B : 0);
+}
+
+static uint8_t rotl8(uint8_t x, int s)
+{
+  return (x << s) | (x >> (8 - s));
+}
+
+static void build_sbox(void)
+{
+  // multiplicative inverse in GF(2^8) followed by the affine transform
+  uint8_t p = 1, q = 1;
+  do
+  {
+    p = p ^ xtime(p);
+    q ^= q << 1;
+    q ^= q << 2;
+    q ^= q << 4;
+    if (q & 0x80)
+    {
+      q ^= 0x09;
+    }
+    sbox[p] = q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4) ^ 0x63;
+  } while (p != 1);
+  sbox[0] = 0x63;
+}
+
+static void expand_key(uint8_t const *key, uint8_t round_keys[11][16])
+{
+  memcpy(round_keys[0], key, 16);
+  uint8_t rcon = 1;
+  for (int i = 4; i < 44; i++)
+  {
+    uint8_t const *prev = &round_keys[(i - 1) / 4][((i - 1) % 4) * 4];
+    uint8_t word[4] = {prev[0], prev[1], prev[2], prev[3]};
+    if (i % 4 == 0)
+    {
+      uint8_t first = word[0];
+      word[0] = sbox[word[1]] ^ rcon;
+      word[1] = sbox[word[2]];
+      word[2] = sbox[word[3]];
+      word[3] = sbox[first];
+      rcon = xtime(rcon);
+    }
+    uint8_t const *back = &round_keys[(i - 4) / 4][((i - 4) % 4) * 4];
+    for (int j = 0; j < 4; j++)
+    {
+      round_keys[i / 4][(i % 4) * 4 + j] = back[j] ^ word[j];
+    }
+  }
+}
+
+static void encrypt_block(uint8_t round_keys[11][16], uint8_t const *in, uint8_t *out)
+{
+  uint8_t state[16];
+  for (int i = 0; i < 16; i++)
+  {
+    state[i] = in[i] ^ round_keys[0][i];
+  }
+
+  for (int round = 1; round <= 10; round++)
+  {
+    // sub bytes and shift rows, the state is column major
+    uint8_t shifted[16];
+    for (int i = 0; i < 16; i++)
+    {
+      shifted[i] = sbox[state[(i + 4 * (i % 4)) % 16]];
+    }
+
+    if (round != 10)
+    {
+      for (int c = 0; c < 4; c++)
+      {
+        uint8_t *col = &shifted[c * 4];
+        uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+        uint8_t total = a0 ^ a1 ^ a2 ^ a3;
+        col[0] = a0 ^ total ^ xtime(a0 ^ a1);
+        col[1] = a1 ^ total ^ xtime(a1 ^ a2);
+        col[2] = a2 ^ total ^ xtime(a2 ^ a3);
+        col[3] = a3 ^ total ^ xtime(a3 ^ a0);
+      }
+    }
+
+    for (int i = 0; i < 16; i++)
+    {
+      state[i] = shifted[i] ^ round_keys[round][i];
+    }
+  }
+  memcpy(out, state, 16);
+}
+
+static void shift_subkey(uint8_t const *in, uint8_t *out)
+{
+  uint8_t carry = in[0] & 0x80;
+  for (int i = 0; i < 15; i++)
+  {
+    out[i] = (in[i] << 1) | (in[i + 1] >> 7);
+  }
+  out[15] = (in[15] << 1) ^ (carry ? 0x87 : 0);
+}
+
+static void aes_cmac(uint8_t const *key, uint8_t const *message, size_t length, uint8_t *mac)
+{
+  uint8_t round_keys[11][16];
+  expand_key(key, round_keys);
+
+  uint8_t zero[16] = {0}, l[16], k1[16], k2[16];
+  encrypt_block(round_keys, zero, l);
+  shift_subkey(l, k1);
+  shift_subkey(k1, k2);
+
+  size_t blocks = length ? (length + 15) / 16 : 1;
+  uint8_t x[16] = {0};
+  for (size_t b = 0; b < blocks; b++)
+  {
+    uint8_t block[16] = {0};
+    size_t offset = b * 16;
+    size_t take = length - offset < 16 ? length - offset : 16;
+    memcpy(block, &message[offset], take);
+
+    if (b == blocks - 1)
+    {
+      uint8_t const *subkey = k1;
+      if (take < 16)
+      {
+        block[take] = 0x80;
+        subkey = k2;
+      }
+      for (int i = 0; i < 16; i++)
+      {
+        block[i] ^= subkey[i];
+      }
+    }
+
+    for (int i = 0; i < 16; i++)
+    {
+      block[i] ^= x[i];
+    }
+    encrypt_block(round_keys, block, x);
+  }
+  memcpy(mac, x, 16);
+}
+
+ret_code_t nrf_crypto_init(void)
+{
+  build_sbox();
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_mem_init(void)
+{
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_aes_init(nrf_crypto_aes_context_t *p_context, nrf_crypto_aes_info_t const *p_info,
+                               nrf_crypto_operation_t operation)
+{
+  memset(p_context, 0, sizeof(*p_context));
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_aes_key_set(nrf_crypto_aes_context_t *p_context, uint8_t *p_key)
+{
+  memcpy(p_context->key, p_key, sizeof(p_context->key));
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_crypto_aes_finalize(nrf_crypto_aes_context_t *p_context, uint8_t *p_data_in, size_t data_size,
+                                   uint8_t *p_data_out, size_t *p_data_out_size)
+{
+  aes_cmac(p_context->key, p_data_in, data_size, p_data_out);
+  *p_data_out_size = 16;
+  return NRF_SUCCESS;
+}
@@ -0,0 +1,209 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc16.h"
+#include "nrf_fstorage.h"
+#include "nrf_fstorage_sd.h"
+
+#include "sim.h"
+
+// nRF52840 flash timing
+#define PAGE_SIZE 4096
+#define WRITE_US_PER_WORD 41
+#define ERASE_US_PER_PAGE 85000
+
+nrf_fstorage_api_t nrf_fstorage_sd = {.name = "sim"};
+
+static nrf_fstorage_t const *fstorage = NULL;
+static uint8_t *flash = NULL;
+static uint32_t flash_size = 0;
+static char const *image_path = NULL;
+
+// One operation at a time, completing at done_us
+static bool busy = false;
+static uint64_t done_us;
+static nrf_fstorage_evt_t pending;
+
+static uint32_t writes = 0;
+static uint32_t erases = 0;
+
+void sim_flash_set_image(char const *path)
+{
+  image_path = path;
+}
+
+ret_code_t nrf_fstorage_init(nrf_fstorage_t *p_fs, nrf_fstorage_api_t *p_api, void *p_param)
+{
+  fstorage = p_fs;
+  flash_size = p_fs->end_addr + 1 - p_fs->start_addr;
+  flash = malloc(flash_size);
+  memset(flash, 0xFF, flash_size);
+
+  // Whatever an earlier run left in flash, as after a reset
+  FILE *image = image_path ? fopen(image_path, "rb") : NULL;
+  if (image)
+  {
+    if (fread(flash, 1, flash_size, image) != flash_size)
+    {
+      fprintf(stderr, "%s: expected a %u byte flash image, starting erased\n", image_path, flash_size);
+      memset(flash, 0xFF, flash_size);
+    }
+    fclose(image);
+  }
+  return NRF_SUCCESS;
+}
+
+static bool in_range(uint32_t addr, uint32_t len)
+{
+  return addr >= fstorage->start_addr && len <= flash_size && addr - fstorage->start_addr <= flash_size - len;
+}
+
+ret_code_t nrf_fstorage_read(nrf_fstorage_t const *p_fs, uint32_t src, void *p_dest, uint32_t len)
+{
+  if (!in_range(src, len))
+  {
+    return NRF_ERROR_INVALID_ADDR;
+  }
+  memcpy(p_dest, &flash[src - p_fs->start_addr], len);
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_fstorage_write(nrf_fstorage_t const *p_fs, uint32_t dest, void const *p_src, uint32_t len,
+                              void *p_param)
+{
+  if (dest % 4 || !in_range(dest, len))
+  {
+    return NRF_ERROR_INVALID_ADDR;
+  }
+  if (len == 0 || len % 4)
+  {
+    return NRF_ERROR_INVALID_LENGTH;
+  }
+  if (busy)
+  {
+    return NRF_ERROR_NO_MEM;
+  }
+
+  busy = true;
+  done_us = sim_now_us() + len / 4 * WRITE_US_PER_WORD;
+  pending = (nrf_fstorage_evt_t){
+      .id = NRF_FSTORAGE_EVT_WRITE_RESULT,
+      .result = NRF_SUCCESS,
+      .addr = dest,
+      .p_src = p_src,
+      .len = len,
+      .p_param = p_param,
+  };
+  return NRF_SUCCESS;
+}
+
+ret_code_t nrf_fstorage_erase(nrf_fstorage_t const *p_fs, uint32_t page_addr, uint32_t len, void *p_param)
+{
+  if (page_addr % PAGE_SIZE || !in_range(page_addr, len * PAGE_SIZE))
+  {
+    return NRF_ERROR_INVALID_ADDR;
+  }
+  if (len == 0)
+  {
+    return NRF_ERROR_INVALID_LENGTH;
+  }
+  if (busy)
+  {
+    return NRF_ERROR_NO_MEM;
+  }
+
+  busy = true;
+  done_us = sim_now_us() + len * ERASE_US_PER_PAGE;
+  pending = (nrf_fstorage_evt_t){
+      .id = NRF_FSTORAGE_EVT_ERASE_RESULT,
+      .result = NRF_SUCCESS,
+      .addr = page_addr,
+      .len = len,
+      .p_param = p_param,
+  };
+  return NRF_SUCCESS;
+}
+
+bool nrf_fstorage_is_busy(nrf_fstorage_t const *p_fs)
+{
+  return busy;
+}
+
+uint64_t sim_flash_next_us(void)
+{
+  return busy ? done_us : SIM_NO_EVENT;
+}
+
+void sim_flash_fire(void)
+{
+  if (!busy)
+  {
+    return;
+  }
+
+  // The source is read when the write happens, as the SoftDevice does
+  uint8_t *target = &flash[pending.addr - fstorage->start_addr];
+  if (pending.id == NRF_FSTORAGE_EVT_WRITE_RESULT)
+  {
+    uint8_t const *source = pending.p_src;
+    for (uint32_t i = 0; i < pending.len; i++)
+    {
+      // Programming only clears bits, so a word written twice is a bug
+      if (target[i] != 0xFF && source[i] != 0xFF)
+      {
+        fprintf(stderr, "%.3f ms: flash at 0x%x written twice\n", sim_now_us() / 1000.0, pending.addr + i);
+        exit(2);
+      }
+      target[i] &= source[i];
+    }
+    writes++;
+  }
+  else
+  {
+    memset(target, 0xFF, pending.len * PAGE_SIZE);
+    erases++;
+  }
+
+  busy = false;
+  nrf_fstorage_evt_t event = pending;
+  fstorage->evt_handler(&event);
+}
+
+void sim_flash_finish(void)
+{
+  if (flash)
+  {
+    fprintf(stderr, "Flash: %u writes, %u page erases\n", writes, erases);
+  }
+  if (!flash || !image_path)
+  {
+    return;
+  }
+
+  FILE *image = fopen(image_path, "wb");
+  if (!image || fwrite(flash, 1, flash_size, image) != flash_size)
+  {
+    perror(image_path);
+  }
+  if (image)
+  {
+    fclose(image);
+  }
+}
+
+uint16_t crc16_compute(uint8_t const *p_data, uint32_t size, uint16_t const *p_crc)
+{
+  uint16_t crc = p_crc ? *p_crc : 0xFFFF;
+  for (uint32_t i = 0; i < size; i++)
+  {
+    crc = (uint8_t)(crc >> 8) | (crc << 8);
+    crc ^= p_data[i];
+    crc ^= (uint8_t)(crc & 0xFF) >> 4;
+    crc ^= (crc << 8) << 4;
+    crc ^= ((crc & 0xFF) << 4) << 1;
+  }
+  return crc;
+}
@@ -0,0 +1,147 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "nrf_delay.h"
+#include "nrf_gpio.h"
+#include "nrfx_pwm.h"
+
+#include "pwm_driver.h"
+#include "sim.h"
+
+static nrfx_pwm_handler_t handler = NULL;
+static uint32_t bit_ns = 0;
+
+static bool playing = false;
+static uint64_t playback_end_us;
+static nrf_pwm_sequence_t const *sequence;
+
+static bool strip_powered = false;
+static FILE *output = NULL;
+static uint32_t frames = 0;
+
+// Reads one channel of one pixel back out of the duty cycles, MSB first
+static uint8_t decode_channel(nrf_pwm_values_common_t const *out)
+{
+  uint8_t value = 0;
+  for (uint8_t bit = 0; bit < 8; bit++)
+  {
+    value = (value << 1) | (out[bit] == HIGH);
+  }
+  return value;
+}
+
+// The first pixel as the strip receives it, after brightness and budget
+static color_t decode_pixel(nrf_pwm_values_common_t const *out)
+{
+  color_t color = {.val = 0};
+  color.LED_CHANNEL_0 = decode_channel(out + 0 * LED_CHANNEL_BITS);
+  color.LED_CHANNEL_1 = decode_channel(out + 1 * LED_CHANNEL_BITS);
+  color.LED_CHANNEL_2 = decode_channel(out + 2 * LED_CHANNEL_BITS);
+#if LED_CHANNEL_COUNT == 4
+  color.LED_CHANNEL_3 = decode_channel(out + 3 * LED_CHANNEL_BITS);
+#endif
+  return color;
+}
+
+static void write_frame(color_t color)
+{
+  frames++;
+  if (output)
+  {
+    fprintf(output, "%.3f,%u,%u,%u,%u\n", sim_now_us() / 1000.0, color.green, color.red, color.blue,
+            strip_powered);
+  }
+}
+
+void sim_strip_set_output(FILE *timeline)
+{
+  output = timeline;
+  if (output)
+  {
+    fprintf(output, "time_ms,green,red,blue,powered\n");
+  }
+}
+
+uint32_t sim_strip_frames(void)
+{
+  return frames;
+}
+
+void nrf_gpio_cfg_output(uint32_t pin_number)
+{
+}
+
+void nrf_gpio_pin_set(uint32_t pin_number)
+{
+  if (pin_number == LED_STRIP_POWER_PIN)
+  {
+    strip_powered = true;
+  }
+}
+
+void nrf_gpio_pin_clear(uint32_t pin_number)
+{
+  // Turning the rail off is a frame of its own: the strip goes dark
+  if (pin_number == LED_STRIP_POWER_PIN && strip_powered)
+  {
+    strip_powered = false;
+    write_frame((color_t){.val = 0});
+  }
+}
+
+void nrf_delay_us(uint32_t us_time)
+{
+  sim_advance_to(sim_now_us() + us_time);
+}
+
+uint32_t nrfx_pwm_init(nrfx_pwm_t const *p_instance, nrfx_pwm_config_t const *p_config, nrfx_pwm_handler_t event_handler)
+{
+  static uint32_t const CLOCK_HZ[] = {16000000, 8000000, 4000000, 2000000, 1000000};
+
+  handler = event_handler;
+  bit_ns = (uint32_t)((uint64_t)p_config->top_value * 1000000000 / CLOCK_HZ[p_config->base_clock]);
+  return 0;
+}
+
+uint32_t nrfx_pwm_simple_playback(nrfx_pwm_t const *p_instance, nrf_pwm_sequence_t const *p_sequence,
+                                  uint16_t playback_count, uint32_t flags)
+{
+  sequence = p_sequence;
+  playing = true;
+  playback_end_us = sim_now_us() + ((uint64_t)p_sequence->length * playback_count * bit_ns + 999) / 1000;
+  return 0;
+}
+
+static void finish_playback(void)
+{
+  playing = false;
+  write_frame(decode_pixel(sequence->values.p_common));
+  if (handler)
+  {
+    handler(NRFX_PWM_EVT_STOPPED);
+  }
+}
+
+bool nrfx_pwm_stop(nrfx_pwm_t const *p_instance, bool wait_until_stopped)
+{
+  // Cut short, the frame still reaches the first pixels
+  if (playing)
+  {
+    finish_playback();
+  }
+  return true;
+}
+
+uint64_t sim_strip_next_us(void)
+{
+  return playing ? playback_end_us : SIM_NO_EVENT;
+}
+
+void sim_strip_fire(void)
+{
+  if (playing)
+  {
+    finish_playback();
+  }
+}
@@ -0,0 +1,131 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_timer.h"
+#include "nrf.h"
+
+#include "sim.h"
+
+#define CYCLES_PER_US 64
+
+DWT_Type sim_dwt;
+CoreDebug_Type sim_core_debug;
+uint32_t SystemCoreClock = CYCLES_PER_US * 1000000;
+
+static uint64_t now_us = 0;
+static app_timer_t *timers = NULL;
+
+static uint64_t ticks_at(uint64_t us)
+{
+  return us * APP_TIMER_CLOCK_FREQ / 1000000;
+}
+
+// First us at which the counter reads `ticks`
+static uint64_t us_at(uint64_t ticks)
+{
+  return (ticks * 1000000 + APP_TIMER_CLOCK_FREQ - 1) / APP_TIMER_CLOCK_FREQ;
+}
+
+uint64_t sim_now_us(void)
+{
+  return now_us;
+}
+
+void sim_advance_to(uint64_t us)
+{
+  if (us > now_us)
+  {
+    sim_dwt.CYCCNT += (uint32_t)((us - now_us) * CYCLES_PER_US);
+    now_us = us;
+  }
+}
+
+ret_code_t app_timer_init(void)
+{
+  return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_create(app_timer_id_t const *p_timer_id, app_timer_mode_t mode,
+                            app_timer_timeout_handler_t timeout_handler)
+{
+  app_timer_t *timer = *p_timer_id;
+  timer->handler = timeout_handler;
+  timer->mode = mode;
+  timer->active = false;
+  timer->next = timers;
+  timers = timer;
+  return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void *p_context)
+{
+  if (timeout_ticks < APP_TIMER_MIN_TIMEOUT_TICKS)
+  {
+    return 7; // NRF_ERROR_INVALID_PARAM
+  }
+
+  // Starting a running timer is ignored, as on the board
+  if (timer_id->active)
+  {
+    return NRF_SUCCESS;
+  }
+  timer_id->active = true;
+  timer_id->expiry_ticks = ticks_at(now_us) + timeout_ticks;
+  timer_id->period_ticks = timeout_ticks;
+  timer_id->context = p_context;
+  return NRF_SUCCESS;
+}
+
+ret_code_t app_timer_stop(app_timer_id_t timer_id)
+{
+  timer_id->active = false;
+  return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(void)
+{
+  return ticks_at(now_us) & 0xFFFFFF;
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from)
+{
+  return (ticks_to - ticks_from) & 0xFFFFFF;
+}
+
+static app_timer_t *next_timer(void)
+{
+  app_timer_t *next = NULL;
+  for (app_timer_t *timer = timers; timer; timer = timer->next)
+  {
+    if (timer->active && (!next || timer->expiry_ticks < next->expiry_ticks))
+    {
+      next = timer;
+    }
+  }
+  return next;
+}
+
+uint64_t sim_timer_next_us(void)
+{
+  app_timer_t *timer = next_timer();
+  return timer ? us_at(timer->expiry_ticks) : SIM_NO_EVENT;
+}
+
+void sim_timer_fire(void)
+{
+  app_timer_t *timer = next_timer();
+  if (!timer)
+  {
+    return;
+  }
+
+  if (timer->mode == APP_TIMER_MODE_REPEATED)
+  {
+    timer->expiry_ticks += timer->period_ticks;
+  }
+  else
+  {
+    timer->active = false;
+  }
+  timer->handler(timer->context);
+}
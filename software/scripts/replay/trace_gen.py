@@ -0,0 +1,205 @@
+#! /usr/bin/env python3
+
+# Synthetic advert traces for color_scan_replay
+#
+# Tags wander around a room with the scanner in the middle, advertising
+# signed tag payloads the way color_adv does: a burst of fast adverts after
+# each state change, backing off to the idle interval. RSSI follows a
+# log-distance path loss with Gaussian noise, and some adverts are lost.
+#
+# The first two tags are the ones color_scan knows (0xAABB and 0xCCDD, with
+# their keys), any more are strangers with their own keys that the scanner
+# should ignore.
+
+import argparse
+import math
+import os
+import random
+import re
+import struct
+import sys
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'tag_auth'))
+import tag_auth  # noqa: E402
+
+APP_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'apps', 'color_scan')
+
+
+def read_known_tags():
+    """The tags and keys color_scan is built with, as the replay Makefile
+    picks them: its own tag_keys.h, or else the example keys."""
+    path = os.path.join(APP_DIR, 'tag_keys.h')
+    if not os.path.exists(path):
+        path += '.example'
+    with open(path) as f:
+        text = f.read()
+    # Each key is a brace list after a comment with the tag's id
+    return [(int(tag_id, 16), bytes(int(b, 16) for b in re.findall(r'0x([0-9A-Fa-f]{2})\b', key)))
+            for tag_id, key in re.findall(r'//\s*0x([0-9A-Fa-f]{4})\s*\{([^}]*)\}', text)]
+
+
+KNOWN_TAGS = read_known_tags()
+
+# color_adv's color options, as (green, red, blue)
+PALETTE = [
+    (0x00, 0x8F, 0x00),
+    (0x8F, 0x00, 0x00),
+    (0x00, 0x00, 0x8F),
+    (0x8F, 0x8F, 0x00),
+    (0x8F, 0x00, 0x8F),
+    (0x00, 0x8F, 0x8F),
+    (0x8F, 0x8F, 0x8F),
+]
+
+# Timing of color_adv's adv_scheduler
+BURST_INTERVAL_MS = 30
+ADVERTS_PER_STEP = 8
+IDLE_INTERVAL_MS = 1000
+# Random delay the controller adds to every advertising event
+MAX_ADV_DELAY_MS = 10
+
+COMPANY_ID = 0x02E0
+AD_FLAGS = bytes([0x02, 0x01, 0x06])
+
+
+class Tag:
+    def __init__(self, rng, args, tag_id, key):
+        self.rng = rng
+        self.args = args
+        self.id = tag_id
+        self.key = key
+        # c0:98:e5:4e:xx:xx, least significant byte first
+        self.addr = struct.pack('<H', tag_id) + bytes([0x4E, 0xE5, 0x98, 0xC0])
+        self.clock_offset_ms = rng.uniform(0, 100000)
+        self.x, self.y = self.random_point()
+        self.target = self.random_point()
+        self.pause_s = 0.0
+        self.sequence = rng.randrange(256)
+        self.counter = 1
+        self.next_change_s = 0.0
+        self.next_advert_s = rng.uniform(0, IDLE_INTERVAL_MS / 1000)
+        self.interval_ms = IDLE_INTERVAL_MS
+        self.adverts_at_interval = 0
+        self.state = None
+
+    def random_point(self):
+        half = self.args.room / 2
+        return self.rng.uniform(-half, half), self.rng.uniform(-half, half)
+
+    def move(self, dt):
+        """Random waypoint: walk to a point, wait a while, pick another"""
+        if self.pause_s > 0:
+            self.pause_s -= dt
+            return
+        dx, dy = self.target[0] - self.x, self.target[1] - self.y
+        distance = math.hypot(dx, dy)
+        step = self.args.speed * dt
+        if distance <= step:
+            self.x, self.y = self.target
+            self.target = self.random_point()
+            self.pause_s = self.rng.expovariate(1 / self.args.pause)
+        else:
+            self.x += dx / distance * step
+            self.y += dy / distance * step
+
+    def change_state(self, now_s):
+        green, red, blue = self.rng.choice(PALETTE)
+        effect = self.rng.choice([0, 1, 2]) if self.args.effects else 0
+        self.sequence = (self.sequence + 1) % 256
+        self.counter += 1
+        self.state = (green, red, blue, effect)
+        self.interval_ms = BURST_INTERVAL_MS
+        self.adverts_at_interval = 0
+        self.next_change_s = now_s + self.rng.expovariate(1 / self.args.change_interval)
+
+    def advert(self, now_s):
+        """Advertising data as sent at now_s, and schedules the next advert"""
+        # the time is signed, so every advert is signed again
+        time_ms = None if self.args.untimed else int(now_s * 1000 + self.clock_offset_ms) & 0xFFFFFFFF
+        green, red, blue, effect = self.state
+        payload = tag_auth.encode_payload(self.key, self.addr, self.sequence, green, red, blue, effect=effect,
+                                          tx_power=0, counter=self.counter, time_ms=time_ms)
+        manufacturer = struct.pack('<BBH', 3 + len(payload), 0xFF, COMPANY_ID) + payload
+
+        self.adverts_at_interval += 1
+        if self.adverts_at_interval == ADVERTS_PER_STEP and self.interval_ms < IDLE_INTERVAL_MS:
+            self.interval_ms = min(self.interval_ms * 2, IDLE_INTERVAL_MS)
+            self.adverts_at_interval = 0
+        self.next_advert_s = now_s + (self.interval_ms + self.rng.uniform(0, MAX_ADV_DELAY_MS)) / 1000
+        return AD_FLAGS + manufacturer
+
+    def rssi(self):
+        distance = max(math.hypot(self.x, self.y), 0.1)
+        level = self.args.rssi_1m - 10 * self.args.path_loss * math.log10(distance)
+        return int(round(level + self.rng.gauss(0, self.args.noise)))
+
+
+def address_string(addr):
+    return ':'.join('{:02x}'.format(b) for b in reversed(addr))
+
+
+def generate(args, out):
+    rng = random.Random(args.seed)
+    tags = []
+    for i in range(args.tags):
+        if i < len(KNOWN_TAGS):
+            tag_id, key = KNOWN_TAGS[i]
+        else:
+            tag_id = 0x1000 + i
+            key = bytes(rng.randrange(256) for _ in range(16))
+        tags.append(Tag(rng, args, tag_id, key))
+
+    out.write('# trace_gen.py --tags {} --duration {} --seed {}\n'.format(args.tags, args.duration, args.seed))
+    out.write('# time_ms address rssi data\n')
+
+    step_s = 0.01
+    now_s = 0.0
+    adverts = 0
+    while now_s < args.duration:
+        for tag in tags:
+            tag.move(step_s)
+        # every advert due within this step, in time order
+        due = sorted((tag.next_advert_s, i) for i, tag in enumerate(tags) if tag.next_advert_s < now_s + step_s)
+        for at_s, i in due:
+            tag = tags[i]
+            if at_s >= tag.next_change_s:
+                tag.change_state(at_s)
+            data = tag.advert(at_s)
+            rssi = tag.rssi()
+            if rssi < args.sensitivity or rng.random() < args.loss:
+                continue
+            out.write('{:.3f} {} {} {}\n'.format(at_s * 1000, address_string(tag.addr), rssi, data.hex()))
+            adverts += 1
+        now_s += step_s
+    return adverts
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate an advert trace for color_scan_replay')
+    parser.add_argument('--tags', type=int, default=2, help='tags in the room, the first two known (2)')
+    parser.add_argument('--duration', type=float, default=60, help='seconds of trace (60)')
+    parser.add_argument('--seed', type=int, default=1, help='random seed, the same seed gives the same trace (1)')
+    parser.add_argument('--room', type=float, default=8, help='side of the square room in m (8)')
+    parser.add_argument('--speed', type=float, default=0.7, help='walking speed in m/s (0.7)')
+    parser.add_argument('--pause', type=float, default=5, help='mean wait at each waypoint in s (5)')
+    parser.add_argument('--change-interval', type=float, default=20,
+                        help='mean time between state changes of a tag in s (20)')
+    parser.add_argument('--effects', action='store_true', help='pick blink and breathe effects too')
+    parser.add_argument('--untimed', action='store_true',
+                        help='leave the time out, so an idle tag repeats the same advert')
+    parser.add_argument('--rssi-1m', type=float, default=-40, help='RSSI at 1 m in dBm (-40)')
+    parser.add_argument('--path-loss', type=float, default=2.0, help='path loss exponent (2.0)')
+    parser.add_argument('--noise', type=float, default=4, help='RSSI noise, standard deviation in dB (4)')
+    parser.add_argument('--loss', type=float, default=0.1, help='chance an advert is missed (0.1)')
+    parser.add_argument('--sensitivity', type=int, default=-95, help='weakest advert heard in dBm (-95)')
+    parser.add_argument('-o', '--output', help='trace file to write, stdout if left out')
+    args = parser.parse_args()
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    adverts = generate(args, out)
+    print('{} adverts'.format(adverts), file=sys.stderr)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,184 @@
+#! /usr/bin/env python3
+
+# Host reference for signed tag payloads (apps/color_adv, apps/color_scan)
+#
+# Plain Python AES-128 and CMAC, so vectors can be checked without any
+# packages. Slow, but quick enough for vectors and synthetic traces.
+
+import argparse
+import struct
+import sys
+
+FLAG_TX_POWER = 1 << 0
+FLAG_AUTH = 1 << 1
+FLAG_TIME = 1 << 2
+TIME_LENGTH = 4
+PAYLOAD_VERSION = 2
+MAC_LENGTH = 4
+
+SBOX = [0] * 256
+
+
+def _build_sbox():
+    # multiplicative inverse in GF(2^8) followed by the affine transform
+    p = q = 1
+    while True:
+        p = p ^ ((p << 1) & 0xFF) ^ (0x1B if p & 0x80 else 0)
+        q ^= q << 1
+        q ^= q << 2
+        q ^= q << 4
+        q &= 0xFF
+        if q & 0x80:
+            q ^= 0x09
+        rot = lambda x, s: ((x << s) | (x >> (8 - s))) & 0xFF
+        SBOX[p] = q ^ rot(q, 1) ^ rot(q, 2) ^ rot(q, 3) ^ rot(q, 4) ^ 0x63
+        if p == 1:
+            break
+    SBOX[0] = 0x63
+
+
+_build_sbox()
+
+
+def _xtime(b):
+    return ((b << 1) ^ 0x1B) & 0xFF if b & 0x80 else b << 1
+
+
+def _expand_key(key):
+    words = [list(key[i:i + 4]) for i in range(0, 16, 4)]
+    rcon = 1
+    for i in range(4, 44):
+        word = list(words[i - 1])
+        if i % 4 == 0:
+            word = [SBOX[b] for b in word[1:] + word[:1]]
+            word[0] ^= rcon
+            rcon = _xtime(rcon)
+        words.append([a ^ b for a, b in zip(words[i - 4], word)])
+    return [sum(words[r * 4:r * 4 + 4], []) for r in range(11)]
+
+
+def aes128_encrypt(key, block):
+    round_keys = _expand_key(key)
+    state = [a ^ b for a, b in zip(block, round_keys[0])]
+    for r in range(1, 11):
+        state = [SBOX[b] for b in state]
+        # shift rows, state is column major
+        state = [state[(i + 4 * (i % 4)) % 16] for i in range(16)]
+        if r != 10:
+            mixed = []
+            for c in range(4):
+                col = state[c * 4:c * 4 + 4]
+                total = col[0] ^ col[1] ^ col[2] ^ col[3]
+                mixed += [col[i] ^ total ^ _xtime(col[i] ^ col[(i + 1) % 4]) for i in range(4)]
+            state = mixed
+        state = [a ^ b for a, b in zip(state, round_keys[r])]
+    return bytes(state)
+
+
+def _shift_subkey(block):
+    value = int.from_bytes(block, 'big') << 1
+    if value >> 128:
+        value = (value ^ 0x87) & ((1 << 128) - 1)
+    return value.to_bytes(16, 'big')
+
+
+def aes_cmac(key, message):
+    k1 = _shift_subkey(aes128_encrypt(key, bytes(16)))
+    k2 = _shift_subkey(k1)
+
+    blocks = [message[i:i + 16] for i in range(0, len(message), 16)] or [b'']
+    last = blocks.pop()
+    if len(last) == 16:
+        last = bytes(a ^ b for a, b in zip(last, k1))
+    else:
+        padded = last + b'\x80' + bytes(15 - len(last))
+        last = bytes(a ^ b for a, b in zip(padded, k2))
+
+    x = bytes(16)
+    for block in blocks + [last]:
+        x = aes128_encrypt(key, bytes(a ^ b for a, b in zip(x, block)))
+    return x
+
+
+def encode_payload(key, addr, sequence, green, red, blue, brightness=255, effect=0, tx_power=None, counter=1,
+                   time_ms=None):
+    """Signed payload as tag_payload_encode() and tag_auth_sign() build it.
+    addr is the 6 byte BLE address in over-the-air (little endian) order"""
+    flags = FLAG_AUTH | (FLAG_TX_POWER if tx_power is not None else 0) | (FLAG_TIME if time_ms is not None else 0)
+    payload = bytes([PAYLOAD_VERSION, flags, sequence, green, red, blue, brightness, effect])
+    if tx_power is not None:
+        payload += struct.pack('<b', tx_power)
+    payload += struct.pack('<I', counter)
+    # the time follows the MAC, and is signed with the rest
+    time = struct.pack('<I', time_ms) if time_ms is not None else b''
+    return payload + aes_cmac(key, addr + payload + time)[:MAC_LENGTH] + time
+
+
+def verify_payload(key, addr, payload):
+    if len(payload) < 8 + 4 + MAC_LENGTH or not payload[1] & FLAG_AUTH:
+        return False
+    time = b''
+    if payload[1] & FLAG_TIME:
+        payload, time = payload[:-TIME_LENGTH], payload[-TIME_LENGTH:]
+    return aes_cmac(key, addr + payload[:-MAC_LENGTH] + time)[:MAC_LENGTH] == payload[-MAC_LENGTH:]
+
+
+# RFC 4493 section 4
+RFC4493_KEY = bytes.fromhex('2b7e151628aed2a6abf7158809cf4f3c')
+RFC4493_MESSAGE = bytes.fromhex('6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51'
+                                '30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710')
+RFC4493_VECTORS = [
+    (0, 'bb1d6929e95937287fa37d129b756746'),
+    (16, '070a16b46b4d4144f79bdd9dd04a287c'),
+    (40, 'dfa66747de9ae63030ca32611497c827'),
+    (64, '51f0bebf7e3b9d92fc49741779363cfe'),
+]
+
+# Key of the 0xCCDD tag in apps/color_scan/tag_keys.h.example
+EXAMPLE_KEY = bytes.fromhex('6925899df4e20d53b91bb77e1a838e54')
+EXAMPLE_ADDR = bytes.fromhex('ddcc4ee598c0')  # c0:98:e5:4e:cc:dd
+
+
+def self_test():
+    ok = True
+    for length, expected in RFC4493_VECTORS:
+        mac = aes_cmac(RFC4493_KEY, RFC4493_MESSAGE[:length]).hex()
+        print('RFC 4493 {:2} bytes: {} {}'.format(length, mac, 'ok' if mac == expected else 'FAIL'))
+        ok &= mac == expected
+
+    # colors as set_color_options() in color_adv defines RED and CYAN
+    for sequence, (green, red, blue), counter in [(0, (0x00, 0x8F, 0x00), 1), (1, (0x8F, 0x00, 0x8F), 2)]:
+        payload = encode_payload(EXAMPLE_KEY, EXAMPLE_ADDR, sequence, green, red, blue, tx_power=0, counter=counter)
+        print('Tag 0xCCDD seq {} counter {}: {}'.format(sequence, counter, payload.hex()))
+        ok &= verify_payload(EXAMPLE_KEY, EXAMPLE_ADDR, payload)
+
+        # with the clock, which is signed too, so a changed time breaks the MAC
+        payload = encode_payload(EXAMPLE_KEY, EXAMPLE_ADDR, sequence, green, red, blue, tx_power=0, counter=counter,
+                                 time_ms=1000)
+        print('Tag 0xCCDD seq {} counter {} at 1000 ms: {}'.format(sequence, counter, payload.hex()))
+        ok &= verify_payload(EXAMPLE_KEY, EXAMPLE_ADDR, payload)
+        ok &= not verify_payload(EXAMPLE_KEY, EXAMPLE_ADDR, payload[:-TIME_LENGTH] + struct.pack('<I', 2000))
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Host reference for signed tag payloads')
+    sub = parser.add_subparsers(dest='command')
+    sub.add_parser('test', help='check RFC 4493 vectors and print tag vectors')
+    verify = sub.add_parser('verify', help='check the MAC of a payload captured from a tag')
+    verify.add_argument('key', help='16 byte key as hex')
+    verify.add_argument('addr', help='address as printed, e.g. c0:98:e5:4e:cc:dd')
+    verify.add_argument('payload', help='manufacturer data after the company id, as hex')
+    args = parser.parse_args()
+
+    if args.command == 'verify':
+        addr = bytes.fromhex(args.addr.replace(':', ''))[::-1]
+        valid = verify_payload(bytes.fromhex(args.key), addr, bytes.fromhex(args.payload))
+        print('valid' if valid else 'INVALID')
+        return 0 if valid else 1
+
+    return 0 if self_test() else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,71 @@
+#! /usr/bin/env python3
+
+# Extracts deferred log format strings from an app's ELF file
+#
+# LOG() in apps/telemetry/deferred_log.h keeps every format string in a
+# symbol named log_fmt.*, and the board only sends the string's address.
+# This writes a JSON dictionary from those addresses to the strings, for
+# telemetry_decode.py --log-strings. apps/telemetry/LogStrings.mk runs it
+# after every link, since the addresses move. Reads the ELF itself, so no
+# packages are needed.
+
+import argparse
+import json
+import struct
+import sys
+
+SHT_SYMTAB = 2
+
+
+def sections(elf):
+    if elf[:4] != b'\x7fELF' or elf[4] != 1 or elf[5] != 1:
+        raise ValueError('not a 32 bit little endian ELF file')
+    shoff, = struct.unpack_from('<I', elf, 0x20)
+    shentsize, shnum = struct.unpack_from('<HH', elf, 0x2E)
+    result = []
+    for i in range(shnum):
+        name, kind, flags, addr, offset, size, link, info, align, entsize = \
+            struct.unpack_from('<IIIIIIIIII', elf, shoff + i * shentsize)
+        result.append({'type': kind, 'addr': addr, 'offset': offset, 'size': size, 'link': link})
+    return result
+
+
+def c_string(data, start):
+    end = data.index(b'\0', start)
+    return data[start:end].decode('utf-8', errors='replace')
+
+
+def log_strings(elf):
+    secs = sections(elf)
+    strings = {}
+    for symtab in (s for s in secs if s['type'] == SHT_SYMTAB):
+        strtab = secs[symtab['link']]
+        for offset in range(symtab['offset'], symtab['offset'] + symtab['size'], 16):
+            name, value, size, info, other, shndx = struct.unpack_from('<IIIBBH', elf, offset)
+            symbol = c_string(elf, strtab['offset'] + name)
+            if symbol != 'log_fmt' and not symbol.startswith('log_fmt.'):
+                continue
+            if shndx == 0 or shndx >= len(secs):
+                continue
+            section = secs[shndx]
+            strings['0x{:08x}'.format(value)] = c_string(elf, section['offset'] + value - section['addr'])
+    return strings
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Extract deferred log format strings from an ELF file')
+    parser.add_argument('elf', help="the app's .elf from its build directory")
+    parser.add_argument('-o', '--output', help='JSON file to write, stdout if left out')
+    args = parser.parse_args()
+
+    with open(args.elf, 'rb') as f:
+        strings = log_strings(f.read())
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    json.dump(strings, out, indent=2, sort_keys=True)
+    out.write('\n')
+    print('{} format strings'.format(len(strings)), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
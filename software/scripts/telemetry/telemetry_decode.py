@@ -0,0 +1,178 @@
+#! /usr/bin/env python3
+
+# Decoder for the binary telemetry stream (apps/telemetry/telemetry.h)
+#
+# Reads a capture of the telemetry RTT channel, for example from
+#   JLinkRTTLogger -Device NRF52840_XXAA -If SWD -Speed 4000 -RTTChannel 1 telemetry.bin
+# and writes one CSV row or JSON object per record. Timestamps are unwrapped
+# into seconds since the first record, and gaps in the sequence numbers are
+# reported as dropped records.
+#
+# Deferred log entries (apps/telemetry/deferred_log.h) arrive as a log record
+# and its argument records. With --log-strings, a dictionary written by
+# log_strings.py, they are joined into one row with the formatted text.
+
+import argparse
+import csv
+import json
+import re
+import struct
+import sys
+
+RECORD = struct.Struct('<IBBHi')
+CLOCK_HZ = 64000000
+
+# Keep in step with telemetry_id_t
+IDS = {
+    0: 'mark',
+    1: 'sample',
+    2: 'ble_event',
+    3: 'color_options',
+    4: 'log',
+    5: 'log_arg',
+}
+
+CONVERSION = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(?:hh|h|ll|l|z|j|t)?([diouxXcsp%])')
+
+
+def format_log(fmt, args):
+    """printf for 32 bit integer arguments, as the board would print them"""
+    args = list(args)
+
+    def take():
+        return args.pop(0) if args else 0
+
+    def convert(match):
+        flags, width, precision, kind = match.groups()
+        if kind == '%':
+            return '%'
+        if width == '*':
+            width = str(struct.unpack('<i', struct.pack('<I', take() & 0xFFFFFFFF))[0])
+        if precision == '*':
+            precision = str(take())
+        spec = '%' + flags + (width or '') + ('.' + precision if precision else '')
+        value = take() & 0xFFFFFFFF
+        if kind in 'di':
+            return (spec + 'd') % struct.unpack('<i', struct.pack('<I', value))[0]
+        if kind == 'o' and '#' in flags:
+            # C's # only makes sure the first digit is 0, where Python adds 0o
+            digits = ('%' + ('.' + precision if precision else '') + 'o') % value
+            spec = spec.replace('#', '')
+            if not digits.startswith('0'):
+                spec = '%' + flags.replace('#', '') + (width or '') + '.' + str(len(digits) + 1)
+        elif kind in 'xX' and '#' in flags and value == 0:
+            # C leaves the 0x off a zero
+            spec = spec.replace('#', '')
+        if kind in 'ouxX':
+            return (spec + kind.replace('u', 'd')) % value
+        if kind == 'c':
+            return (spec + 'c') % chr(value & 0xFF)
+        # strings and pointers only exist on the board
+        return (spec + 's') % '0x{:08x}'.format(value)
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def records(stream):
+    last_timestamp = None
+    last_sequence = None
+    wraps = 0
+    start = None
+
+    while True:
+        data = stream.read(RECORD.size)
+        if len(data) < RECORD.size:
+            return
+        timestamp, record_id, sequence, arg, value = RECORD.unpack(data)
+
+        # The cycle counter wraps every 67 s; records come often enough to
+        # see every wrap
+        if last_timestamp is not None and timestamp < last_timestamp:
+            wraps += 1
+        last_timestamp = timestamp
+        cycles = (wraps << 32) + timestamp
+        if start is None:
+            start = cycles
+
+        dropped = 0
+        if last_sequence is not None:
+            dropped = (sequence - last_sequence - 1) & 0xFF
+        last_sequence = sequence
+
+        yield {
+            'time_s': (cycles - start) / CLOCK_HZ,
+            'id': IDS.get(record_id, record_id),
+            'arg': arg,
+            'value': value,
+            'dropped_before': dropped,
+        }
+
+
+def join_logs(stream, strings):
+    """Folds each log record and its arguments into one record with text"""
+    pending = None
+    for record in stream:
+        if record['id'] == 'log_arg' and pending is not None:
+            pending['args'].append(record['value'])
+            pending['dropped_before'] += record['dropped_before']
+            if len(pending['args']) == pending['arg']:
+                address = '0x{:08x}'.format(pending['value'] & 0xFFFFFFFF)
+                fmt = strings.get(address, '<unknown format {}>'.format(address))
+                pending['text'] = format_log(fmt, pending.pop('args')).rstrip('\r\n')
+                yield pending
+                pending = None
+            continue
+        if pending is not None:
+            # arguments lost to a full buffer
+            pending.pop('args')
+            pending['text'] = '<incomplete log entry>'
+            yield pending
+            pending = None
+        if record['id'] == 'log':
+            pending = dict(record, args=[])
+            continue
+        yield record
+
+    if pending is not None:
+        pending.pop('args')
+        pending['text'] = '<incomplete log entry>'
+        yield pending
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Decode a telemetry capture into CSV or JSON lines')
+    parser.add_argument('capture', nargs='?', help='capture file, stdin if left out')
+    parser.add_argument('--json', action='store_true', help='one JSON object per line instead of CSV')
+    parser.add_argument('--id', action='append', help='only records with this id (repeatable)')
+    parser.add_argument('--log-strings', help='format strings from log_strings.py, to format log entries')
+    args = parser.parse_args()
+
+    stream = open(args.capture, 'rb') if args.capture else sys.stdin.buffer
+    fields = ['time_s', 'id', 'arg', 'value', 'dropped_before', 'text']
+    writer = None if args.json else csv.DictWriter(sys.stdout, fieldnames=fields, restval='')
+    if writer:
+        writer.writeheader()
+
+    count = 0
+    dropped = 0
+    decoded = records(stream)
+    if args.log_strings:
+        with open(args.log_strings) as f:
+            decoded = join_logs(decoded, json.load(f))
+
+    for record in decoded:
+        count += 1
+        dropped += record['dropped_before']
+        if args.id and str(record['id']) not in args.id:
+            continue
+        if writer:
+            record['time_s'] = '{:.6f}'.format(record['time_s'])
+            writer.writerow(record)
+        else:
+            print(json.dumps(record))
+
+    print('{} records, {} dropped'.format(count, dropped), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()